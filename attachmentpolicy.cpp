@@ -0,0 +1,75 @@
+#include "attachmentpolicy.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+static bool containsExtension(const QStringList& extensions, const QString& fileName)
+{
+    return extensions.contains(QFileInfo(fileName).suffix(), Qt::CaseInsensitive);
+}
+
+AttachmentPolicy::Decision AttachmentPolicy::decide(const QString& fileName, qint64 fileSize, const QHostAddress& sender) const
+{
+    if(maxFileSize > 0 && fileSize > maxFileSize)
+        return Decision::Reject;
+    if(containsExtension(blockedExtensions, fileName))
+        return Decision::Reject;
+
+    if(!spoolDirectory.isEmpty())
+    {
+        const bool sizeAllowed = autoAcceptMaxSize <= 0 || fileSize <= autoAcceptMaxSize;
+        const bool extensionAllowed = autoAcceptExtensions.isEmpty() || containsExtension(autoAcceptExtensions, fileName);
+
+        bool senderAllowed = autoAcceptSenders.isEmpty();
+        for(const QPair<QHostAddress, int>& subnet : autoAcceptSenders)
+        {
+            if(sender.isInSubnet(subnet))
+            {
+                senderAllowed = true;
+                break;
+            }
+        }
+
+        if(sizeAllowed && extensionAllowed && senderAllowed)
+            return Decision::Accept;
+    }
+
+    return fallback;
+}
+
+QString AttachmentPolicy::spoolPath(const QString& fileName) const
+{
+    // 같은 이름의 파일이 있을 때의 번호 붙이기는 SpoolFile::commit이 writer thread에서 옮기면서 처리함
+    return QDir(spoolDirectory).filePath(fileName);
+}
+
+QStringList AttachmentPolicy::parseExtensions(const QString& text)
+{
+    QStringList extensions;
+    foreach (QString extension, text.split(',', Qt::SkipEmptyParts))
+    {
+        extension = extension.trimmed();
+        if(extension.startsWith('.'))
+            extension.remove(0, 1);
+        if(!extension.isEmpty())
+            extensions.append(extension);
+    }
+    return extensions;
+}
+
+bool AttachmentPolicy::parseSenders(const QString& text, QList<QPair<QHostAddress, int>>* senders)
+{
+    foreach (QString entry, text.split(',', Qt::SkipEmptyParts))
+    {
+        entry = entry.trimmed();
+
+        // prefix 길이가 없으면 주소 하나만 허용
+        QPair<QHostAddress, int> subnet = entry.contains('/') ? QHostAddress::parseSubnet(entry) : qMakePair(QHostAddress(entry), -1);
+        if(subnet.first.isNull())
+            return false;
+        if(subnet.second < 0)
+            subnet.second = subnet.first.protocol() == QAbstractSocket::IPv6Protocol ? 128 : 32;
+        senders->append(subnet);
+    }
+    return true;
+}
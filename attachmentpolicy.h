@@ -0,0 +1,43 @@
+#ifndef ATTACHMENTPOLICY_H
+#define ATTACHMENTPOLICY_H
+
+#include <QHostAddress>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+// 수신되는 첨부파일을 사람에게 묻지 않고 처리하기 위한 규칙
+//
+//  1. maxFileSize를 넘거나 blockedExtensions에 해당하면 거부
+//  2. spoolDirectory가 있고 autoAccept 조건(크기, 확장자, 보낸 주소)을 모두 만족하면
+//     spoolDirectory에 자동 저장
+//  3. 나머지는 fallback(기본값 Ask : 화면에 수신 여부를 물음)
+//
+// 목록이 비어 있는 조건은 모든 값을 허용, 크기 0은 제한 없음
+class AttachmentPolicy
+{
+public:
+    enum class Decision { Accept, Reject, Ask };
+
+    qint64 maxFileSize = 0;
+    QStringList blockedExtensions;
+
+    QString spoolDirectory;
+    qint64 autoAcceptMaxSize = 0;
+    QStringList autoAcceptExtensions;
+    QList<QPair<QHostAddress, int>> autoAcceptSenders;      // subnet(주소, prefix 길이)
+
+    Decision fallback = Decision::Ask;
+
+    Decision decide(const QString& fileName, qint64 fileSize, const QHostAddress& sender) const;
+
+    // spoolDirectory 안의 저장 경로(같은 이름이 있으면 SpoolFile::commit이 번호를 붙여 저장)
+    QString spoolPath(const QString& fileName) const;
+
+    // "jpg,png" 형식의 확장자 목록, "10.0.0.0/8,::1" 형식의 subnet 목록 변환
+    static QStringList parseExtensions(const QString& text);
+    static bool parseSenders(const QString& text, QList<QPair<QHostAddress, int>>* senders);
+};
+
+#endif // ATTACHMENTPOLICY_H
@@ -0,0 +1,294 @@
+#include "attachmentreceiver.h"
+#include "blobcache.h"
+#include "spoolfile.h"
+
+#include <QDir>
+#include <QTemporaryFile>
+
+#include <algorithm>
+
+AttachmentReceiver::AttachmentReceiver(QObject* parent) : QObject(parent)
+{
+}
+
+AttachmentReceiver::~AttachmentReceiver()
+{
+    // 완료되지 못한 수신 파일은 정리하되, 이어받기 가능한 임시 파일은 남겨둠
+    // (이미 요청한 기록은 writer thread에서 마저 끝나지만 결과는 전달받지 않음)
+    foreach (quint32 transferId, m_incoming.keys())
+        drop(transferId, true);
+
+    foreach (const QWeakPointer<SpoolFile>& released, m_released)
+    {
+        if(QSharedPointer<SpoolFile> spool = released.toStrongRef())
+            spool->detach();
+    }
+}
+
+void AttachmentReceiver::release(const QSharedPointer<SpoolFile>& spool)
+{
+    // 작업이 모두 끝나 해제된 spool은 정리
+    if(m_released.size() >= 64)
+    {
+        m_released.erase(std::remove_if(m_released.begin(), m_released.end(), [](const QWeakPointer<SpoolFile>& released) {
+            return released.isNull();
+        }), m_released.end());
+    }
+    m_released.append(spool);
+}
+
+qint64 AttachmentReceiver::begin(quint32 transferId, const QString& fileName, qint64 fileSize, const QByteArray& resumeKey, const QByteArray& contentHash)
+{
+    // 같은 transferId가 남아있으면 이전 수신은 버림
+    if(m_incoming.contains(transferId))
+        drop(transferId);
+
+    if(m_incoming.size() >= MaxIncomingTransfers)
+    {
+        emit signal_failed(transferId, QString("Too many attachments in progress (%1), %2 was rejected").arg(MaxIncomingTransfers).arg(fileName));
+        return -1;
+    }
+
+    IncomingFile incoming;
+    incoming.fileName = fileName;
+    incoming.fileSize = fileSize;
+    incoming.keyed = !resumeKey.isEmpty();
+
+    // 같은 내용을 받은 적이 있으면 본문은 받지 않고 저장할 때 캐시에서 복사(임시 파일을 만들지 않음)
+    if(!contentHash.isEmpty() && BlobCache::instance()->lookup(contentHash, fileSize))
+    {
+        incoming.spool = QSharedPointer<SpoolFile>::create(nullptr, nullptr, this);
+        incoming.spool->copyFromCache(contentHash);
+        incoming.cached = true;
+        incoming.received = fileSize;
+        m_incoming.insert(transferId, incoming);
+        return incoming.received;
+    }
+
+    // 이어받기 key가 있으면 이전에 받던 임시 파일을 이어서 사용
+    QLockFile* lock = nullptr;
+    QFile* file = resumeKey.isEmpty() ? nullptr : openResumable(resumeKey, &lock);
+
+    // 수신 여부가 정해지기 전까지 임시 파일에 기록
+    if(!file)
+    {
+        QTemporaryFile* temporaryFile = new QTemporaryFile(QDir::tempPath() + "/qtcp_XXXXXX.part");
+        temporaryFile->setAutoRemove(false);
+        if(!temporaryFile->open())
+        {
+            emit signal_failed(transferId, QString("Unable to create a temporary file for %1: %2").arg(fileName, temporaryFile->errorString()));
+            delete temporaryFile;
+            return -1;
+        }
+        file = temporaryFile;
+    }
+
+    // 이미 받은 부분 뒤에 이어서 기록(전체 크기보다 크면 잘라냄)
+    const qint64 received = qBound<qint64>(0, file->size(), qMax<qint64>(0, fileSize));
+    if((file->size() != received && !file->resize(received)) || !file->seek(received))
+    {
+        emit signal_failed(transferId, QString("Unable to prepare the temporary file for %1: %2").arg(fileName, file->errorString()));
+        file->close();
+        file->remove();
+        delete file;
+        delete lock;
+        return -1;
+    }
+
+    // 이후 디스크 작업은 writer thread pool에서 실행
+    incoming.spool = QSharedPointer<SpoolFile>::create(file, lock, this);
+    incoming.resumable = lock != nullptr;
+    incoming.received = received;
+    if(!contentHash.isEmpty())
+        incoming.spool->cacheAs(contentHash);
+
+    m_incoming.insert(transferId, incoming);
+    return incoming.received;
+}
+
+// key로 정해지는 임시 파일을 열어 반환, 다른 곳에서 사용 중이면 nullptr
+QFile* AttachmentReceiver::openResumable(const QByteArray& resumeKey, QLockFile** lock)
+{
+    const QString path = QDir::tempPath() + "/qtcp_" + QString::fromLatin1(resumeKey.toHex()) + ".part";
+
+    // 비정상 종료로 남은 lock은 QLockFile이 stale lock으로 처리
+    QLockFile* fileLock = new QLockFile(path + ".lock");
+    if(!fileLock->tryLock(0))
+    {
+        delete fileLock;
+        return nullptr;
+    }
+
+    QFile* file = new QFile(path);
+    if(!file->open(QIODevice::ReadWrite))
+    {
+        delete file;
+        delete fileLock;
+        return nullptr;
+    }
+
+    *lock = fileLock;
+    return file;
+}
+
+bool AttachmentReceiver::write(quint32 transferId, const QByteArray& chunk)
+{
+    auto it = m_incoming.find(transferId);
+    if(it == m_incoming.end())
+        return false;
+
+    // reject된 전송, 캐시에서 복사하는 전송은 chunk를 버림
+    if(it->state == State::Rejected || it->cached)
+        return true;
+
+    // start frame에 알린 크기를 넘는 데이터는 기록하지 않음
+    if(it->received + chunk.size() > it->fileSize)
+    {
+        emit signal_failed(transferId, QString("Received more data than the announced %1 bytes").arg(it->fileSize));
+        drop(transferId);
+        return false;
+    }
+
+    QSharedPointer<SpoolFile> spool = it->spool;
+    it->spool->write(chunk, [this, transferId, spool](const QString& reason) {
+        fail(transferId, spool, reason);
+    });
+    it->received += chunk.size();
+    return true;
+}
+
+void AttachmentReceiver::fail(quint32 transferId, const QSharedPointer<SpoolFile>& spool, const QString& reason)
+{
+    auto failed = m_incoming.find(transferId);
+    if(failed == m_incoming.end() || failed->spool != spool)
+        return;
+    emit signal_failed(transferId, reason);
+    drop(transferId);
+}
+
+// spool의 앞선 작업이 끝날 때마다 기록 대기량을 다시 확인
+void AttachmentReceiver::watchDrain(const QSharedPointer<SpoolFile>& spool)
+{
+    spool->notify([this, spool]() {
+        if(pendingBytes() >= MaxPendingBytes / 2 && spool->pendingBytes() > 0)
+        {
+            watchDrain(spool);
+            return;
+        }
+        m_backedUp = false;
+        emit signal_drained();
+    });
+}
+
+qint64 AttachmentReceiver::pendingBytes() const
+{
+    qint64 pending = 0;
+    for(auto it = m_incoming.begin(); it != m_incoming.end(); ++it)
+        pending += it->spool->pendingBytes();
+    return pending;
+}
+
+bool AttachmentReceiver::isBackedUp()
+{
+    if(pendingBytes() < MaxPendingBytes)
+        return false;
+
+    // 기록이 가장 많이 밀린 파일의 작업이 진행될 때마다 다시 확인하여 절반 아래로 내려가면 알림
+    if(!m_backedUp)
+    {
+        m_backedUp = true;
+
+        QSharedPointer<SpoolFile> slowest;
+        for(auto it = m_incoming.begin(); it != m_incoming.end(); ++it)
+        {
+            if(!slowest || it->spool->pendingBytes() > slowest->pendingBytes())
+                slowest = it->spool;
+        }
+
+        watchDrain(slowest);
+    }
+    return true;
+}
+
+void AttachmentReceiver::finish(quint32 transferId, qint64 checksum)
+{
+    auto it = m_incoming.find(transferId);
+    if(it == m_incoming.end())
+        return;
+
+    // 중간에 chunk가 빠졌으면 저장하지 않음
+    if(it->state != State::Rejected && it->received != it->fileSize)
+    {
+        emit signal_failed(transferId, QString("Received %1 of the announced %2 bytes").arg(it->received).arg(it->fileSize));
+        drop(transferId);
+        return;
+    }
+
+    it->complete = true;
+    it->checksum = checksum;
+
+    if(it->state == State::Accepted)
+        commit(transferId);
+    else if(it->state == State::Rejected)
+        drop(transferId);
+}
+
+void AttachmentReceiver::accept(quint32 transferId, const QString& filePath)
+{
+    auto it = m_incoming.find(transferId);
+    if(it == m_incoming.end())
+        return;
+
+    it->state = State::Accepted;
+    it->filePath = filePath;
+
+    // end frame이 이미 도착했다면 바로 저장
+    if(it->complete)
+        commit(transferId);
+}
+
+qint64 AttachmentReceiver::reject(quint32 transferId)
+{
+    auto it = m_incoming.find(transferId);
+    if(it == m_incoming.end())
+        return -1;
+
+    // 임시 파일은 바로 삭제하고, end frame이 올 때까지 chunk만 무시
+    it->state = State::Rejected;
+    it->spool->discard(false);
+
+    if(it->complete)
+    {
+        drop(transferId);
+        return -1;
+    }
+
+    // 송신 측이 남은 본문을 건너뛸 수 있도록 끝 offset을 알려줌
+    return it->keyed ? it->fileSize : -1;
+}
+
+void AttachmentReceiver::commit(quint32 transferId)
+{
+    IncomingFile incoming = m_incoming.take(transferId);
+    release(incoming.spool);
+
+    // 앞선 기록이 모두 끝난 뒤 writer thread에서 CRC32C를 확인하고 저장 경로로 이동
+    incoming.spool->commit(incoming.filePath, incoming.checksum, [this, transferId](bool stored, const QString& result) {
+        if(stored)
+            emit signal_stored(transferId, result);
+        else
+            emit signal_failed(transferId, result);
+    });
+}
+
+void AttachmentReceiver::drop(quint32 transferId, bool keepPartial)
+{
+    IncomingFile incoming = m_incoming.take(transferId);
+    if(!incoming.spool)
+        return;
+    release(incoming.spool);
+
+    // reject 때 이미 삭제를 요청했음
+    if(incoming.state != State::Rejected)
+        incoming.spool->discard(keepPartial && incoming.resumable);
+}
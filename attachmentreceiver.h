@@ -0,0 +1,102 @@
+#ifndef ATTACHMENTRECEIVER_H
+#define ATTACHMENTRECEIVER_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QLockFile>
+#include <QSharedPointer>
+#include <QVector>
+
+class SpoolFile;
+
+// chunk 단위로 수신되는 첨부파일을 곧바로 디스크에 기록하는 클래스
+// 수신 여부가 결정되기 전에도 chunk는 임시 파일(.part)에 기록되고,
+// accept 되면 사용자가 지정한 경로로 옮기고 reject 되면 삭제함
+// 연결(socket)마다 하나씩 socket의 자식 객체로 생성
+//
+// 이어받기 key가 있는 전송은 key로 정해지는 임시 파일(qtcp_<key>.part)에 기록하고,
+// 연결이 끊어져도 지우지 않아 같은 파일을 다시 보내면 받은 곳부터 이어서 받음
+// (다른 연결/프로세스가 같은 key를 받는 중이면 lock 파일로 감지하여 처음부터 받음)
+//
+// 내용 hash가 있는 전송은 같은 내용이 BlobCache에 있으면 본문을 받지 않고 캐시에서 복사하며,
+// 없으면 받은 내용을 저장한 뒤 캐시에 넣음
+//
+// start frame에 적힌 크기와 실제로 받은 크기가 다르거나, end frame의 CRC32C가 기록한 내용과 다르면
+// 저장하지 않고 signal_failed로 알림
+//
+// 실제 디스크 기록은 SpoolFile이 writer thread pool에서 실행하고,
+// 기록 대기량이 MaxPendingBytes를 넘으면 isBackedUp()으로 알려 호출 측이 소켓 읽기를 멈추게 함
+class AttachmentReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    // 디스크 기록 대기량 한도(넘으면 소켓 읽기를 멈추고 절반 아래로 내려가면 재개)
+    static constexpr qint64 MaxPendingBytes = 8 * 1024 * 1024;
+    // 연결 하나에서 동시에 받을 수 있는 첨부파일 수(전송마다 임시 파일을 열므로 descriptor와 디스크 보호)
+    static constexpr int MaxIncomingTransfers = 16;
+
+    explicit AttachmentReceiver(QObject* parent = nullptr);
+    ~AttachmentReceiver();
+
+    // start frame 수신 : 임시 파일을 만들거나 이전에 받던 임시 파일을 열고
+    // 이미 받은 바이트 수(이어받을 offset) 반환, 실패하면 signal_failed로 이유를 알리고 -1
+    // 받는 중인 전송이 MaxIncomingTransfers개이면 더 받지 않음
+    // 캐시에 같은 내용이 있으면 임시 파일 없이 fileSize를 반환(송신 측은 본문 없이 end frame만 보냄)
+    qint64 begin(quint32 transferId, const QString& fileName, qint64 fileSize, const QByteArray& resumeKey = QByteArray(), const QByteArray& contentHash = QByteArray());
+    // chunk frame 수신 : writer thread에 기록 요청(알린 크기를 넘으면 전송을 버림)
+    bool write(quint32 transferId, const QByteArray& chunk);
+    // end frame 수신 : 수신 완료 표시, 이미 accept 되었다면 저장 경로로 이동
+    // checksum은 송신 측이 알린 파일 전체의 CRC32C(없으면 -1)
+    void finish(quint32 transferId, qint64 checksum = -1);
+
+    // 사용자(또는 정책)의 수신 여부 결정
+    void accept(quint32 transferId, const QString& filePath);
+    // 이어받기 key가 있는 전송을 end frame 전에 reject하면 알린 파일 크기를 반환(아니면 -1)
+    // 호출 측은 이 값을 AttachmentResume으로 보내 송신 측이 남은 본문 없이 end frame을 보내게 함
+    qint64 reject(quint32 transferId);
+
+    // 디스크 기록이 밀려 있으면 true, 이후 기록 대기량이 줄어들면 signal_drained 발생
+    bool isBackedUp();
+
+signals:
+    void signal_stored(quint32 transferId, const QString& filePath);
+    void signal_failed(quint32 transferId, const QString& reason);
+    void signal_drained();
+
+private:
+    enum class State { Pending, Accepted, Rejected };
+
+    struct IncomingFile
+    {
+        QSharedPointer<SpoolFile> spool;
+        QString fileName;
+        qint64 fileSize = 0;
+        qint64 received = 0;
+        qint64 checksum = -1;
+        QString filePath;
+        State state = State::Pending;
+        bool complete = false;
+        bool resumable = false;
+        bool keyed = false;         // 이어받기 key가 있어 송신 측이 AttachmentResume에 응답함
+        bool cached = false;        // 캐시에서 복사하므로 chunk는 무시
+    };
+
+    void commit(quint32 transferId);
+    // writer thread에서 기록에 실패한 전송은 버림(그 사이 같은 transferId로 새 전송이 시작되었으면 무시)
+    void fail(quint32 transferId, const QSharedPointer<SpoolFile>& spool, const QString& reason);
+    // keepPartial이면 이어받기 가능한 임시 파일은 남겨둠(연결이 끊어진 경우)
+    void drop(quint32 transferId, bool keepPartial = false);
+    QFile* openResumable(const QByteArray& resumeKey, QLockFile** lock);
+    qint64 pendingBytes() const;
+    void watchDrain(const QSharedPointer<SpoolFile>& spool);
+    // 수신 목록에서 빠졌지만 writer thread 작업이 남아있을 수 있는 spool 보관(소멸 시 detach)
+    void release(const QSharedPointer<SpoolFile>& spool);
+
+    QHash<quint32, IncomingFile> m_incoming;
+    QVector<QWeakPointer<SpoolFile>> m_released;
+    // isBackedUp()이 true를 반환한 뒤 signal_drained를 기다리는 중
+    bool m_backedUp = false;
+};
+
+#endif // ATTACHMENTRECEIVER_H
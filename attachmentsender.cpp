@@ -0,0 +1,469 @@
+#include "attachmentsender.h"
+#include "crc32c.h"
+#include "outboundqueue.h"
+#include "streamsocket.h"
+
+#include <QAtomicInteger>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#endif
+
+// 프로세스 내에서 전송마다 고유한 transferId 발급
+static QAtomicInteger<quint32> s_nextTransferId(1);
+// sendfile 경로 사용 여부
+static QAtomicInt s_zeroCopyEnabled(1);
+// 이어받기 key -> 내용 hash와 CRC32C(같은 파일을 다시 보낼 때 다시 읽지 않음)
+struct FileDigest
+{
+    QByteArray contentHash;
+    quint32 checksum = 0;
+};
+static QMutex s_contentHashMutex;
+static QHash<QByteArray, FileDigest> s_contentHashes;
+
+quint32 AttachmentSender::nextTransferId()
+{
+    return s_nextTransferId.fetchAndAddRelaxed(1);
+}
+
+AttachmentSender* AttachmentSender::find(QIODevice* socket, quint32 transferId)
+{
+    foreach (AttachmentSender* attachmentSender, socket->findChildren<AttachmentSender*>(QString(), Qt::FindDirectChildrenOnly))
+    {
+        if(attachmentSender->transferId() == transferId && !attachmentSender->m_finished)
+            return attachmentSender;
+    }
+    return nullptr;
+}
+
+void AttachmentSender::setZeroCopyEnabled(bool enabled)
+{
+    s_zeroCopyEnabled.storeRelaxed(enabled ? 1 : 0);
+}
+
+bool AttachmentSender::isZeroCopyEnabled()
+{
+#ifdef Q_OS_LINUX
+    return s_zeroCopyEnabled.loadRelaxed() != 0;
+#else
+    return false;
+#endif
+}
+
+AttachmentSender::AttachmentSender(QIODevice* socket, const QString& filePath, QObject* parent)
+    : QObject(parent), m_socket(socket), m_file(filePath), m_transferId(nextTransferId())
+{
+}
+
+bool AttachmentSender::start()
+{
+    // chunk는 소켓의 송신 대기열을 거쳐 전송
+    m_queue = OutboundQueue::of(m_socket);
+    if(!m_queue || !m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    // 일반 파일과 실제 소켓일 때만 sendfile 경로 사용
+    m_zeroCopy = isZeroCopyEnabled() && m_file.handle() >= 0 && StreamSocket::descriptor(m_socket) >= 0;
+    if(m_zeroCopy)
+    {
+        // 소켓 버퍼가 가득 차면 쓰기 가능해질 때까지 대기(대기 중일 때만 활성화)
+        m_writeNotifier = new QSocketNotifier(StreamSocket::descriptor(m_socket), QSocketNotifier::Write, this);
+        m_writeNotifier->setEnabled(false);
+        connect(m_writeNotifier, &QSocketNotifier::activated, this, [this]() {
+            m_writeNotifier->setEnabled(false);
+            slot_sendNextChunks();
+        });
+    }
+
+    // 소켓 송신 버퍼가 비워지거나 일시 정지가 풀릴 때마다 다음 chunk 전송
+    connect(m_socket, &QIODevice::bytesWritten, this, &AttachmentSender::slot_sendNextChunks);
+    connect(m_queue, &OutboundQueue::signal_resumed, this, &AttachmentSender::slot_sendNextChunks);
+    // 같은 소켓의 다른 송신기가 sendfile로 쓰던 frame을 끝내면 이어서 보냄
+    // (자신이 hold를 풀 때도 발생하므로 chunk마다 재귀 호출되지 않도록 event loop를 거쳐 실행)
+    connect(m_queue, &OutboundQueue::signal_released, this, &AttachmentSender::slot_sendNextChunks, Qt::QueuedConnection);
+    // 전송 도중 연결이 끊어지면 중단
+    StreamSocket::connectDisconnected(m_socket, this, &AttachmentSender::slot_abort);
+
+    // chunk는 수신 측이 AttachmentResume으로 offset을 알려준 뒤에 보냄
+    m_waitingForOffset = true;
+
+    FileDigest digest;
+    {
+        QMutexLocker locker(&s_contentHashMutex);
+        digest = s_contentHashes.value(resumeKey());
+    }
+    if(!digest.contentHash.isEmpty())
+    {
+        m_fileChecksum = digest.checksum;
+        m_hasFileChecksum = true;
+        sendStart(digest.contentHash);
+        return true;
+    }
+
+    // 큰 파일은 미리 전체를 읽으면 start frame이 그만큼 늦어지므로 hash 없이 바로 보냄
+    if(m_file.size() > MaxPrehashBytes)
+    {
+        m_hashWhileSending = true;
+        sendStart(QByteArray());
+        return true;
+    }
+
+    // 내용 hash와 CRC32C는 나누어 구한 뒤 start frame을 보냄
+    m_contentHash = new QCryptographicHash(QCryptographicHash::Sha256);
+    m_fileChecksum = 0;
+    QTimer::singleShot(0, this, &AttachmentSender::slot_hashNextBlock);
+    return true;
+}
+
+AttachmentSender::~AttachmentSender()
+{
+    delete m_contentHash;
+}
+
+void AttachmentSender::slot_hashNextBlock()
+{
+    if(m_finished || !m_contentHash)
+        return;
+
+    const QByteArray block = m_file.read(HashBlockSize);
+    if(!block.isEmpty())
+    {
+        m_contentHash->addData(block);
+        m_fileChecksum = Crc32c::extend(m_fileChecksum, block);
+        QTimer::singleShot(0, this, &AttachmentSender::slot_hashNextBlock);
+        return;
+    }
+
+    // 읽는 도중 실패하면 hash와 CRC32C 없이 보냄(수신 측은 캐시를 쓰지 않고 전체를 받음)
+    const QByteArray contentHash = finishContentHash();
+    if(!m_file.seek(0))
+    {
+        StreamSocket::abort(m_socket);
+        return;
+    }
+    sendStart(contentHash);
+}
+
+QByteArray AttachmentSender::finishContentHash()
+{
+    QByteArray contentHash;
+    if(m_file.atEnd() && m_file.pos() == m_file.size())
+    {
+        contentHash = m_contentHash->result();
+        m_hasFileChecksum = true;
+
+        FileDigest digest;
+        digest.contentHash = contentHash;
+        digest.checksum = m_fileChecksum;
+
+        QMutexLocker locker(&s_contentHashMutex);
+        if(s_contentHashes.size() >= MaxRememberedHashes)
+            s_contentHashes.clear();
+        s_contentHashes.insert(resumeKey(), digest);
+    }
+    delete m_contentHash;
+    m_contentHash = nullptr;
+    return contentHash;
+}
+
+void AttachmentSender::sendStart(const QByteArray& contentHash)
+{
+    // start frame : 파일 이름과 전체 크기, 이어받기 key, 내용 hash 전달
+    QFileInfo fileInfo(m_file.fileName());
+    writeFrame(FrameProtocol::FrameType::AttachmentStart, fileInfo.fileName().toUtf8(), FrameProtocol::encodeAttachmentStart(m_file.size(), resumeKey(), contentHash));
+
+    // 수신 측이 AttachmentResume을 보내지 않으면(이전 버전, 응답 유실) 파일을 연 채 기다리지 않고 처음부터 보냄
+    // (수신 측이 다른 offset을 기대했다면 크기나 CRC32C가 맞지 않아 저장되지 않음)
+    QTimer::singleShot(ResumeTimeout, this, [this]() {
+        if(m_waitingForOffset)
+            resume(0);
+    });
+}
+
+void AttachmentSender::resume(qint64 offset)
+{
+    if(m_finished)
+        return;
+
+    // 보내는 도중에 받은 AttachmentResume은 거절 표시(파일 크기)일 때만 처리
+    // 쓰던 chunk frame은 마저 보낸 뒤 end frame을 보냄
+    if(!m_waitingForOffset)
+    {
+        if(offset == m_file.size())
+        {
+            m_skipRest = true;
+            slot_sendNextChunks();
+        }
+        return;
+    }
+
+    // 수신 측이 이상한 offset을 보내면 처음부터 보냄
+    if(offset < 0 || offset > m_file.size())
+        offset = 0;
+
+    m_waitingForOffset = false;
+    m_fileOffset = offset;
+
+    // 수신 측의 Hello는 AttachmentResume보다 먼저 도착하므로 여기서 압축 여부를 정함
+    m_compress = m_queue->acceptsCompression();
+    m_chunkChecksums = m_queue->acceptsChecksums();
+
+    // hash 없이 시작한 파일을 처음부터 보내면 읽는 김에 hash와 CRC32C를 구함
+    // (end frame에 CRC32C를 담고 다음 전송은 캐시와 sendfile 경로를 쓸 수 있게 됨)
+    if(m_hashWhileSending && offset == 0)
+    {
+        m_contentHash = new QCryptographicHash(QCryptographicHash::Sha256);
+        m_fileChecksum = 0;
+    }
+
+    // 압축하거나 hash를 구하려면 chunk를 읽어야 하므로 sendfile 경로는 쓰지 않음
+    if((m_compress || m_contentHash) && m_zeroCopy)
+    {
+        m_zeroCopy = false;
+        delete m_writeNotifier;
+        m_writeNotifier = nullptr;
+    }
+
+    if(!m_file.seek(offset))
+    {
+        StreamSocket::abort(m_socket);
+        return;
+    }
+
+    slot_sendNextChunks();
+}
+
+// 같은 파일(경로, 크기, 수정 시각이 같음)이면 연결이 바뀌어도 같은 key
+QByteArray AttachmentSender::resumeKey() const
+{
+    QFileInfo fileInfo(m_file.fileName());
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fileInfo.absoluteFilePath().toUtf8());
+    hash.addData(FrameProtocol::encodeFileSize(fileInfo.size()));
+    hash.addData(FrameProtocol::encodeFileSize(fileInfo.lastModified().toMSecsSinceEpoch()));
+    return hash.result();
+}
+
+void AttachmentSender::slot_sendNextChunks()
+{
+    if(m_finished || m_waitingForOffset)
+        return;
+
+    if(m_zeroCopy)
+        sendZeroCopyChunks();
+    else
+        sendCopiedChunks();
+}
+
+void AttachmentSender::sendCopiedChunks()
+{
+    // 송신 대기열이 MaxPendingBytes를 넘지 않고 일시 정지 상태가 아닐 때만 chunk를 채움
+    while(!m_finished && m_queue->pendingBytes() < MaxPendingBytes && !m_queue->isPaused())
+    {
+        if(m_skipRest)
+        {
+            finish();
+            return;
+        }
+
+        QByteArray chunk = m_file.read(ChunkSize);
+        if(chunk.isEmpty())
+        {
+            // 파일 끝에 도달하면 end frame 전송 후 종료
+            if(m_contentHash)
+                finishContentHash();
+            finish();
+            return;
+        }
+        if(m_contentHash)
+        {
+            m_contentHash->addData(chunk);
+            m_fileChecksum = Crc32c::extend(m_fileChecksum, chunk);
+        }
+        writeFrame(FrameProtocol::FrameType::AttachmentChunk, QByteArray(), chunk);
+    }
+}
+
+void AttachmentSender::sendZeroCopyChunks()
+{
+    // 이전 frame을 쓰는 도중이었다면 나머지부터 보냄
+    if(m_queue->isHeldBy(this))
+    {
+        if(!writeCurrentFrame())
+            return;
+        m_queue->release(this);
+    }
+
+    // 소켓에 직접 쓰려면 대기열과 소켓 버퍼가 모두 비어 있어야 순서가 유지됨
+    // 같은 소켓의 다른 송신기가 frame을 쓰는 중(hold)이면 그 frame이 끝날 때까지 기다림
+    // (남은 frame이 있으면 bytesWritten에서, hold가 풀리면 signal_released에서 다시 호출됨)
+    while(!m_finished && m_zeroCopy && !m_queue->isHeld() && m_queue->pendingBytes() == 0 && !m_queue->isPaused())
+    {
+        const qint64 remaining = m_skipRest ? 0 : m_file.size() - m_fileOffset;
+        if(remaining <= 0)
+        {
+            finish();
+            return;
+        }
+
+        m_bodyRemaining = qMin(remaining, ZeroCopyChunkSize);
+        m_frameHeader = FrameProtocol::encodeHeader(FrameProtocol::FrameType::AttachmentChunk, m_transferId, static_cast<quint32>(m_bodyRemaining));
+
+        // frame을 모두 쓸 때까지 다른 frame이 소켓에 들어가지 않도록 함
+        m_queue->hold(this);
+        if(!writeCurrentFrame())
+            return;
+        m_queue->release(this);
+    }
+
+    // sendfile을 쓸 수 없게 되었으면 복사 경로로 이어서 보냄
+    if(!m_finished && !m_zeroCopy)
+        sendCopiedChunks();
+}
+
+bool AttachmentSender::writeCurrentFrame()
+{
+#ifdef Q_OS_LINUX
+    const int socketFd = static_cast<int>(StreamSocket::descriptor(m_socket));
+
+    // header : 본문과 한 segment로 나가도록 MSG_MORE 지정
+    while(!m_frameHeader.isEmpty())
+    {
+        const ssize_t written = ::send(socketFd, m_frameHeader.constData(), static_cast<size_t>(m_frameHeader.size()), MSG_NOSIGNAL | MSG_MORE);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                m_writeNotifier->setEnabled(true);
+                return false;
+            }
+            StreamSocket::abort(m_socket);
+            return false;
+        }
+        m_frameHeader.remove(0, static_cast<int>(written));
+    }
+
+    // 본문 : 커널이 page cache에서 소켓으로 바로 복사
+    while(m_bodyRemaining > 0)
+    {
+        off_t offset = static_cast<off_t>(m_fileOffset);
+        const ssize_t written = ::sendfile(socketFd, m_file.handle(), &offset, static_cast<size_t>(m_bodyRemaining));
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                m_writeNotifier->setEnabled(true);
+                return false;
+            }
+            if(errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)
+            {
+                fallBackToCopy();
+                return true;
+            }
+            StreamSocket::abort(m_socket);
+            return false;
+        }
+        if(written == 0)
+        {
+            // 전송 도중 파일이 줄어듦 : 선언한 길이를 채울 수 없으므로 연결 종료
+            StreamSocket::abort(m_socket);
+            return false;
+        }
+        m_fileOffset += written;
+        m_bodyRemaining -= written;
+    }
+    return true;
+#else
+    fallBackToCopy();
+    return true;
+#endif
+}
+
+void AttachmentSender::fallBackToCopy()
+{
+    m_zeroCopy = false;
+
+    // 현재 frame의 남은 header와 본문은 소켓 버퍼에 그대로 이어 붙임
+    // (대기열은 hold 상태이고 소켓 버퍼는 비어 있으므로 frame 순서가 유지됨)
+    if(!m_frameHeader.isEmpty())
+        m_socket->write(m_frameHeader);
+    m_frameHeader.clear();
+
+    if(m_bodyRemaining > 0)
+    {
+        if(!m_file.seek(m_fileOffset))
+        {
+            StreamSocket::abort(m_socket);
+            return;
+        }
+        m_socket->write(m_file.read(m_bodyRemaining));
+        m_fileOffset += m_bodyRemaining;
+        m_bodyRemaining = 0;
+    }
+
+    // 이후 chunk는 파일 위치부터 읽어 대기열로 보냄
+    m_file.seek(m_fileOffset);
+}
+
+void AttachmentSender::finish()
+{
+    // 파일 끝에 도달하면 end frame 전송 후 종료(수신 측은 CRC32C가 맞을 때만 저장)
+    writeFrame(FrameProtocol::FrameType::AttachmentEnd, QByteArray(), m_hasFileChecksum ? FrameProtocol::encodeFileChecksum(m_fileChecksum) : QByteArray());
+    m_finished = true;
+    m_file.close();
+    emit signal_finished(m_transferId);
+    deleteLater();
+}
+
+void AttachmentSender::slot_abort()
+{
+    if(m_finished)
+        return;
+
+    m_finished = true;
+    if(m_writeNotifier)
+        m_writeNotifier->setEnabled(false);
+    if(m_queue)
+        m_queue->release(this);
+    m_file.close();
+    emit signal_aborted(m_transferId);
+    deleteLater();
+}
+
+void AttachmentSender::writeFrame(FrameProtocol::FrameType type, const QByteArray& name, const QByteArray& payload)
+{
+    // transferId를 streamId로 사용, chunk는 수신 측이 지원하면 CRC32C를 붙임(압축하기 전 내용 기준)
+    const bool checksum = m_chunkChecksums && type == FrameProtocol::FrameType::AttachmentChunk;
+    QByteArray frame = FrameProtocol::encodeFrame(type, m_transferId, name, payload, checksum ? FrameProtocol::FlagChecksum : 0);
+
+    if(m_compress && type == FrameProtocol::FrameType::AttachmentChunk)
+    {
+        const QByteArray compressed = FrameProtocol::compressFrame(frame);
+        if(compressed.size() < frame.size())
+        {
+            m_incompressibleChunks = 0;
+            frame = compressed;
+        }
+        else if(++m_incompressibleChunks >= MaxIncompressibleChunks)
+        {
+            // 압축되지 않는 파일에 CPU를 계속 쓰지 않음
+            m_compress = false;
+        }
+    }
+
+    m_queue->enqueue(frame);
+}
@@ -0,0 +1,140 @@
+#ifndef ATTACHMENTSENDER_H
+#define ATTACHMENTSENDER_H
+
+#include <QObject>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QIODevice>
+
+#include "frameprotocol.h"
+
+class OutboundQueue;
+
+// 첨부파일을 고정 크기 chunk로 나누어 전송하는 클래스
+// start frame -> data chunk -> end frame 순서로 전송하며,
+// socket의 bytesWritten 신호를 받을 때마다 다음 chunk를 소켓의 OutboundQueue에 채워 넣기 때문에
+// 파일 크기와 관계없이 메모리 사용량이 일정하게 유지됨
+// 대기열이 Pause policy로 멈추면 signal_resumed까지 chunk를 읽지 않음
+//
+// start frame에는 파일 경로/크기/수정 시각으로 만든 이어받기 key를 담고,
+// 수신 측이 AttachmentResume으로 이미 받은 바이트 수를 알려주면 그 위치부터 chunk를 보냄
+// 따라서 연결이 끊어진 뒤 같은 파일을 다시 보내면 못 받은 부분만 전송됨
+// ResumeTimeout 안에 응답이 없으면(이어받기를 모르는 이전 버전 수신 측 등) 처음부터 보냄
+//
+// Linux에서는 chunk header만 소켓에 직접 쓰고 본문은 sendfile(2)로 커널이 파일에서 바로 보냄
+// 그동안 OutboundQueue를 hold하여 다른 frame이 섞이지 않게 하고,
+// sendfile을 쓸 수 없으면(파일 시스템/소켓 미지원) 파일을 읽어 대기열로 보내는 방식으로 돌아감
+//
+// 수신 측이 Hello로 압축 지원을 알렸으면 sendfile 대신 복사 경로로 chunk를 압축하여 보냄
+// 앞쪽 chunk가 연속으로 줄지 않으면(이미 압축된 파일 등) 이후 chunk는 압축을 시도하지 않음
+//
+// start frame 전에 파일 내용의 SHA-256을 구해 함께 보내고, 수신 측이 같은 내용을 캐시에 갖고 있으면
+// 파일 크기를 offset으로 알려오므로 본문 없이 end frame만 보냄
+// hash는 event loop를 막지 않도록 HashBlockSize씩 나누어 구하고, 같은 이어받기 key의 결과는 재사용함
+// MaxPrehashBytes보다 큰 파일은 전체를 미리 읽지 않고 hash 없이 start frame을 보내며,
+// 처음부터 보내게 되면 복사 경로로 읽으면서 hash를 구해 다음 전송 때 재사용함
+//
+// 같은 과정에서 파일 전체의 CRC32C도 구해 end frame에 담아 수신 측이 저장 전에 확인하게 하고,
+// 수신 측이 지원하면 복사 경로의 chunk마다 CRC32C를 붙임(sendfile 경로는 본문을 읽지 않으므로 파일 전체로만 확인)
+class AttachmentSender : public QObject
+{
+    Q_OBJECT
+public:
+    // 한 번에 읽어서 보내는 chunk 크기
+    static constexpr qint64 ChunkSize = 64 * 1024;
+    // sendfile 경로의 chunk 크기
+    // 본문을 복사하지 않으므로 header 수를 줄이도록 크게 잡되, 메시지가 chunk 하나 이상 기다리지 않도록 제한
+    static constexpr qint64 ZeroCopyChunkSize = 256 * 1024;
+    // socket 송신 대기열에 쌓아둘 최대 크기(이 이상이면 bytesWritten까지 대기)
+    static constexpr qint64 MaxPendingBytes = 4 * ChunkSize;
+    // 연속으로 이 수만큼 chunk가 압축되지 않으면 이 전송은 압축을 그만둠
+    static constexpr int MaxIncompressibleChunks = 4;
+    // event loop 한 번에 hash할 크기
+    static constexpr qint64 HashBlockSize = 1024 * 1024;
+    // 이보다 큰 파일은 start frame 전에 hash를 구하지 않음
+    static constexpr qint64 MaxPrehashBytes = 64 * 1024 * 1024;
+    // 기억해 둘 내용 hash 수(넘으면 모두 비움)
+    static constexpr int MaxRememberedHashes = 4096;
+    // start frame을 보낸 뒤 AttachmentResume을 기다리는 시간(ms)
+    static constexpr int ResumeTimeout = 30000;
+
+    explicit AttachmentSender(QIODevice* socket, const QString& filePath, QObject* parent = nullptr);
+    ~AttachmentSender() override;
+
+    // 파일을 열고 (작은 파일이면) 내용 hash를 구한 뒤 start frame 전송, 파일을 열지 못하면 false
+    bool start();
+
+    quint32 transferId() const { return m_transferId; }
+
+    // 수신 측이 알려준 offset부터 chunk 전송 시작(AttachmentResume 수신 시 호출)
+    // 전송 도중 파일 크기를 offset으로 받으면(수신 측이 거절함) 남은 본문을 건너뛰고 end frame을 보냄
+    void resume(qint64 offset);
+
+    // 프로세스 내에서 전송마다 고유한 transferId 발급
+    static quint32 nextTransferId();
+
+    // socket에 붙어있는 전송 중 transferId에 해당하는 sender를 찾음
+    static AttachmentSender* find(QIODevice* socket, quint32 transferId);
+
+    // sendfile 경로 사용 여부(기본값 true, 복사 경로와 비교할 때 끔)
+    static void setZeroCopyEnabled(bool enabled);
+    static bool isZeroCopyEnabled();
+
+signals:
+    void signal_finished(quint32 transferId);
+    void signal_aborted(quint32 transferId);
+
+private slots:
+    void slot_sendNextChunks();
+    void slot_abort();
+    void slot_hashNextBlock();
+
+private:
+    void writeFrame(FrameProtocol::FrameType type, const QByteArray& name = QByteArray(), const QByteArray& payload = QByteArray());
+    void finish();
+    QByteArray resumeKey() const;
+    // 내용 hash와 CRC32C를 다 구했으면 start frame 전송
+    void sendStart(const QByteArray& contentHash);
+    // 파일 끝까지 읽었으면 구한 hash와 CRC32C를 이어받기 key로 기억해 두고 hash 반환
+    QByteArray finishContentHash();
+
+    // 복사 경로 : 파일을 읽어 chunk frame을 대기열에 넣음
+    void sendCopiedChunks();
+    // zero-copy 경로 : header는 send(2), 본문은 sendfile(2)로 소켓에 직접 씀
+    void sendZeroCopyChunks();
+    // 현재 frame의 남은 부분을 소켓에 씀, 소켓 버퍼가 가득 차서 멈췄으면 false
+    bool writeCurrentFrame();
+    // sendfile을 쓸 수 없을 때 현재 frame의 남은 본문을 읽어 소켓 버퍼로 넘기고 복사 경로로 전환
+    void fallBackToCopy();
+
+    QIODevice* m_socket;
+    OutboundQueue* m_queue = nullptr;
+    QFile m_file;
+    quint32 m_transferId;
+    bool m_finished = false;
+    // 수신 측의 AttachmentResume을 기다리는 중
+    bool m_waitingForOffset = false;
+    // 수신 측이 전송 도중 거절하여 남은 본문을 보내지 않음
+    bool m_skipRest = false;
+    // chunk 압축 여부(수신 측이 지원할 때), 연속으로 압축되지 않은 chunk 수
+    bool m_compress = false;
+    int m_incompressibleChunks = 0;
+    // start frame 전에, 또는 보내면서 구하는 파일 내용 hash
+    QCryptographicHash* m_contentHash = nullptr;
+    // start frame에 hash를 담지 못함(처음부터 보내면 보내면서 구함)
+    bool m_hashWhileSending = false;
+    // 파일 전체의 CRC32C(끝까지 읽었을 때만 end frame에 담음), chunk마다 CRC32C를 붙일지 여부
+    quint32 m_fileChecksum = 0;
+    bool m_hasFileChecksum = false;
+    bool m_chunkChecksums = false;
+
+    // zero-copy 경로 상태
+    bool m_zeroCopy = false;
+    QSocketNotifier* m_writeNotifier = nullptr;
+    QByteArray m_frameHeader;       // 현재 frame에서 아직 보내지 못한 header
+    qint64 m_bodyRemaining = 0;     // 현재 frame에서 아직 보내지 못한 본문 크기
+    qint64 m_fileOffset = 0;        // 다음에 보낼 파일 위치
+};
+
+#endif // ATTACHMENTSENDER_H
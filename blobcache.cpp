@@ -0,0 +1,192 @@
+#include "blobcache.h"
+#include "frameprotocol.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+
+Q_GLOBAL_STATIC(BlobCache, s_blobCache)
+
+// blob 복사 단위
+static constexpr qint64 CopyBlockSize = 1024 * 1024;
+
+BlobCache* BlobCache::instance()
+{
+    return s_blobCache();
+}
+
+bool BlobCache::open(const QString& directory, qint64 maxBytes)
+{
+    QDir dir(directory);
+    if(!dir.mkpath("."))
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    m_directory = dir.absolutePath();
+    m_maxBytes = qMax<qint64>(0, maxBytes);
+    m_entries.clear();
+    m_recent.clear();
+    m_statistics = Statistics();
+
+    // 오래 쓰지 않은 blob부터 넣어 가장 최근 blob이 앞에 오도록 함
+    QFileInfoList blobs = dir.entryInfoList(QStringList() << "*.blob", QDir::Files);
+    std::sort(blobs.begin(), blobs.end(), [](const QFileInfo& left, const QFileInfo& right) {
+        return left.lastModified() < right.lastModified();
+    });
+
+    foreach (const QFileInfo& blob, blobs)
+    {
+        const QByteArray hash = QByteArray::fromHex(blob.completeBaseName().toLatin1());
+        if(hash.size() != FrameProtocol::ContentHashSize)
+            continue;
+
+        Entry entry;
+        entry.size = blob.size();
+        entry.position = m_recent.insert(m_recent.begin(), hash);
+        m_entries.insert(hash, entry);
+        m_statistics.bytes += entry.size;
+    }
+
+    evict();
+    return true;
+}
+
+bool BlobCache::isEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return !m_directory.isEmpty();
+}
+
+QString BlobCache::blobPath(const QByteArray& hash) const
+{
+    return m_directory + "/" + QString::fromLatin1(hash.toHex()) + ".blob";
+}
+
+void BlobCache::touch(Entry& entry)
+{
+    m_recent.splice(m_recent.begin(), m_recent, entry.position);
+}
+
+bool BlobCache::lookup(const QByteArray& hash, qint64 size)
+{
+    QMutexLocker locker(&m_mutex);
+    if(m_directory.isEmpty())
+        return false;
+
+    auto it = m_entries.find(hash);
+    if(it == m_entries.end() || it->size != size)
+    {
+        m_statistics.misses++;
+        return false;
+    }
+
+    touch(it.value());
+    m_statistics.hits++;
+    m_statistics.hitBytes += static_cast<quint64>(size);
+    return true;
+}
+
+QFile* BlobCache::openBlob(const QByteArray& hash)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_entries.find(hash);
+    if(it == m_entries.end())
+        return nullptr;
+
+    // lock을 잡은 채로 열어 그 사이 evict로 지워지지 않게 함
+    QFile* blob = new QFile(blobPath(hash));
+    if(!blob->open(QIODevice::ReadOnly))
+    {
+        delete blob;
+        return nullptr;
+    }
+
+    // 다시 실행해도 LRU 순서가 이어지도록 수정 시각 갱신
+    touch(it.value());
+    blob->setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    return blob;
+}
+
+bool BlobCache::store(const QByteArray& hash, const QString& filePath)
+{
+    QString path;
+    qint64 maxBytes = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        if(m_directory.isEmpty() || hash.size() != FrameProtocol::ContentHashSize)
+            return false;
+
+        auto it = m_entries.find(hash);
+        if(it != m_entries.end())
+        {
+            touch(it.value());
+            return true;
+        }
+        path = blobPath(hash);
+        maxBytes = m_maxBytes;
+    }
+
+    // 복사는 lock 밖에서 임시 파일에 하고, 끝나면 blob 이름으로 바꿈
+    QFile source(filePath);
+    if(!source.open(QIODevice::ReadOnly) || source.size() > maxBytes)
+        return false;
+
+    QSaveFile blob(path);
+    if(!blob.open(QIODevice::WriteOnly))
+        return false;
+
+    qint64 size = 0;
+    while(!source.atEnd())
+    {
+        const QByteArray block = source.read(CopyBlockSize);
+        if(block.isEmpty() || blob.write(block) != block.size())
+        {
+            blob.cancelWriting();
+            return false;
+        }
+        size += block.size();
+    }
+
+    if(!blob.commit())
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    if(m_entries.contains(hash))
+        return true;
+
+    Entry entry;
+    entry.size = size;
+    entry.position = m_recent.insert(m_recent.begin(), hash);
+    m_entries.insert(hash, entry);
+    m_statistics.bytes += size;
+    m_statistics.stored++;
+
+    evict();
+    return true;
+}
+
+void BlobCache::evict()
+{
+    while(m_statistics.bytes > m_maxBytes && !m_recent.empty())
+    {
+        const QByteArray hash = m_recent.back();
+        m_recent.pop_back();
+
+        const Entry entry = m_entries.take(hash);
+        m_statistics.bytes -= entry.size;
+        m_statistics.evicted++;
+        QFile::remove(blobPath(hash));
+    }
+}
+
+BlobCache::Statistics BlobCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.blobs = m_entries.size();
+    return statistics;
+}
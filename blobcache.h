@@ -0,0 +1,70 @@
+#ifndef BLOBCACHE_H
+#define BLOBCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include <list>
+
+// 첨부파일 내용 hash(SHA-256)로 찾는 디스크 blob 캐시(프로세스 전체에서 하나)
+// 수신을 마친 첨부파일을 <hash>.blob으로 복사해 두고, 같은 내용의 첨부파일이 다시 오면
+// 송신 측에 전체 크기를 offset으로 알려 본문 전송을 건너뛰고 캐시에서 저장 경로로 복사함
+// 전체 크기가 maxBytes를 넘으면 가장 오래 쓰지 않은 blob부터 지움(LRU)
+// LRU 순서는 blob 파일의 수정 시각에도 남겨 다시 실행해도 이어짐
+// 모든 함수는 어느 thread에서나 호출할 수 있음(실제 복사는 SpoolFile writer thread에서 호출)
+class BlobCache
+{
+public:
+    static constexpr qint64 DefaultMaxBytes = 256 * 1024 * 1024;
+
+    struct Statistics
+    {
+        quint64 hits = 0;           // 캐시에 있어 전송을 건너뛴 첨부파일 수
+        quint64 hitBytes = 0;       // 전송을 건너뛴 바이트
+        quint64 misses = 0;
+        quint64 stored = 0;
+        quint64 evicted = 0;
+        qint64 bytes = 0;           // 현재 캐시 크기
+        int blobs = 0;
+    };
+
+    static BlobCache* instance();
+
+    // directory의 blob으로 캐시를 구성(열지 않으면 캐시를 사용하지 않음)
+    bool open(const QString& directory, qint64 maxBytes = DefaultMaxBytes);
+    bool isEnabled() const;
+
+    // 같은 내용의 blob이 있으면 true, hit/miss로 집계하고 최근 사용으로 표시
+    bool lookup(const QByteArray& hash, qint64 size);
+    // blob을 읽기용으로 열어 반환(없으면 nullptr), 호출 측이 해제
+    // 연 뒤에 캐시에서 지워져도 끝까지 읽을 수 있음
+    QFile* openBlob(const QByteArray& hash);
+    // filePath의 내용을 hash의 blob으로 복사, 한도를 넘으면 오래 쓰지 않은 blob부터 지움
+    bool store(const QByteArray& hash, const QString& filePath);
+
+    Statistics statistics() const;
+
+private:
+    struct Entry
+    {
+        qint64 size = 0;
+        std::list<QByteArray>::iterator position;
+    };
+
+    QString blobPath(const QByteArray& hash) const;
+    // 최근 사용으로 표시(lock을 잡은 상태에서 호출)
+    void touch(Entry& entry);
+    void evict();
+
+    mutable QMutex m_mutex;
+    QString m_directory;
+    qint64 m_maxBytes = 0;
+    QHash<QByteArray, Entry> m_entries;
+    std::list<QByteArray> m_recent;     // 앞쪽이 최근에 쓴 blob
+    Statistics m_statistics;
+};
+
+#endif // BLOBCACHE_H
@@ -0,0 +1,59 @@
+#include "broadcastsender.h"
+#include "attachmentsender.h"
+#include "chattcpserver.h"
+#include "crc32c.h"
+#include "frameprotocol.h"
+
+#include <QFileInfo>
+
+BroadcastSender::BroadcastSender(ChatTcpServer* server, const QString& filePath, QObject* parent)
+    : QObject(parent), m_server(server), m_file(filePath), m_transferId(AttachmentSender::nextTransferId())
+{
+}
+
+bool BroadcastSender::start()
+{
+    if(!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    // 수신자마다 평균 AttachmentSender::MaxPendingBytes 만큼만 대기열에 쌓이도록 제한
+    const qint64 recipients = qMax(1, m_server->connectionIds().size());
+
+    // budget은 worker thread에서 마지막으로 해제될 수 있으므로 deleteLater로 삭제
+    m_budget = QSharedPointer<BroadcastBudget>(new BroadcastBudget(AttachmentSender::MaxPendingBytes * recipients), &QObject::deleteLater);
+    connect(m_budget.data(), &BroadcastBudget::signal_drained, this, &BroadcastSender::slot_sendNextChunks);
+
+    // start frame : 파일 이름과 전체 크기만 전달
+    QFileInfo fileInfo(m_file.fileName());
+    m_server->broadcastFrame(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentStart, m_transferId, fileInfo.fileName().toUtf8(), FrameProtocol::encodeFileSize(m_file.size())), OutboundQueue::Delivery::Reliable, m_budget);
+
+    slot_sendNextChunks();
+    return true;
+}
+
+void BroadcastSender::slot_sendNextChunks()
+{
+    if(m_finished)
+        return;
+
+    // 모든 수신자의 대기열이 budget 아래일 동안만 다음 chunk를 읽음
+    while(!m_budget->isFull())
+    {
+        QByteArray chunk = m_file.read(AttachmentSender::ChunkSize);
+        if(chunk.isEmpty())
+        {
+            // 파일 끝에 도달하면 end frame 전송 후 종료
+            m_server->broadcastFrame(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentEnd, m_transferId, QByteArray(), FrameProtocol::encodeFileChecksum(m_fileChecksum)), OutboundQueue::Delivery::Reliable, m_budget);
+            m_finished = true;
+            m_file.close();
+            emit signal_finished(m_transferId);
+            deleteLater();
+            return;
+        }
+
+        m_fileChecksum = Crc32c::extend(m_fileChecksum, chunk);
+
+        // chunk frame은 한 번만 인코딩하여 모든 worker에 같은 버퍼를 전달
+        m_server->broadcastFrame(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentChunk, m_transferId, QByteArray(), chunk), OutboundQueue::Delivery::Reliable, m_budget);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef BROADCASTSENDER_H
+#define BROADCASTSENDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QSharedPointer>
+
+#include "outboundqueue.h"
+
+class ChatTcpServer;
+
+// 첨부파일 하나를 연결된 모든 클라이언트에게 보내는 클래스
+// 파일은 한 번만 열어 chunk마다 한 번만 읽고 인코딩하며,
+// 인코딩된 frame은 암시적 공유 QByteArray로 모든 소켓의 송신 대기열에 들어감
+// 따라서 수신자가 늘어도 디스크 읽기/인코딩 비용은 늘지 않음
+// 수신자마다 지원 기능이 다르므로 chunk에는 CRC32C를 붙이지 않고, 읽으면서 구한 파일 전체의 CRC32C만 end frame에 담음
+class BroadcastSender : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BroadcastSender(ChatTcpServer* server, const QString& filePath, QObject* parent = nullptr);
+
+    // 파일을 열고 start frame 전송, 실패하면 false
+    bool start();
+
+signals:
+    void signal_finished(quint32 transferId);
+
+private slots:
+    void slot_sendNextChunks();
+
+private:
+    ChatTcpServer* m_server;
+    QFile m_file;
+    quint32 m_transferId;
+    QSharedPointer<BroadcastBudget> m_budget;
+    bool m_finished = false;
+    quint32 m_fileChecksum = 0;
+};
+
+#endif // BROADCASTSENDER_H
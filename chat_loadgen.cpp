@@ -0,0 +1,1234 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QBuffer>
+#include <QtEndian>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "crc32c.h"
+#include "frameprotocol.h"
+#include "streamsocket.h"
+
+// 서버 부하 측정 도구
+// 여러 thread에 나누어 가상의 클라이언트를 접속시키고, 메시지/첨부파일을 섞어서 보내면서
+// 매 송신 뒤에 Ping을 붙여 Pong이 돌아오기까지의 왕복 지연을 측정함
+// --rooms를 주면 클라이언트를 room에 나누어 넣고 메시지를 room으로 publish하여 fan-out 비용을 측정함
+// --checksum-bench를 주면 서버 없이 CRC32C 처리량만 측정하여 첨부파일 무결성 확인 비용을 전송 속도와 비교할 수 있음
+// --decode-bench를 주면 서버 없이 frame 해석 비용(frame당 ns, 할당 횟수)을 측정하고
+// --fuzz-decode를 주면 임의로 변형한 byte stream으로 frame 해석기를 검사함(해석 결과가 어긋나거나 비정상 종료하면 실패)
+// --local을 주면 TCP 대신 서버의 local 소켓으로 접속하여 같은 host에서 두 전송 방식을 비교할 수 있음
+// --broadcast-bench를 주면 수신자 수를 바꿔가며 접속만 하고, 서버가 --broadcast-rate/--broadcast-file로 보내는
+// broadcast를 받으면서 서버 CPU/RSS를 재어 전달한 frame당 비용이 수신자 수와 관계없이 일정한지 확인함
+// --attachment-bench를 주면 서버가 접속마다 보내는 첨부파일(--send-file)을 받기만 하면서 처리량과 GiB당 서버 CPU를 재어
+// 서버의 sendfile 경로와 복사 경로(--no-sendfile)를 비교할 수 있음
+// 결과는 JSON으로 출력하여 빌드 간 성능 비교에 사용
+
+// frame 해석 중의 할당 횟수를 세기 위해 malloc 계열을 가로챔(QByteArray는 operator new가 아닌 malloc을 사용)
+// 할당자는 glibc 것을 그대로 쓰고 호출 횟수만 thread별로 셈
+#if defined(__GLIBC__)
+static thread_local quint64 t_allocations = 0;
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    ++t_allocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    ++t_allocations;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size)
+{
+    ++t_allocations;
+    return __libc_realloc(pointer, size);
+}
+
+static quint64 allocationCount() { return t_allocations; }
+static bool isAllocationCountAvailable() { return true; }
+#else
+static quint64 allocationCount() { return 0; }
+static bool isAllocationCountAvailable() { return false; }
+#endif
+
+namespace
+{
+
+// 모든 thread가 공유하는 단조 증가 시계(ns)
+QElapsedTimer g_clock;
+
+// 지연 시간(us) 히스토그램
+// 2의 거듭제곱 구간마다 SubBuckets / 2개로 나누어 상대 오차를 약 3% 이내로 유지
+class LatencyHistogram
+{
+public:
+    static constexpr int SubBucketBits = 6;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+    static constexpr int Magnitudes = 40;
+
+    LatencyHistogram() : m_counts(SubBuckets * Magnitudes, 0) {}
+
+    void record(quint64 value)
+    {
+        m_counts[indexOf(value)]++;
+        m_total++;
+        m_max = qMax(m_max, value);
+        m_sum += value;
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for(size_t i = 0; i < m_counts.size(); ++i)
+            m_counts[i] += other.m_counts[i];
+        m_total += other.m_total;
+        m_max = qMax(m_max, other.m_max);
+        m_sum += other.m_sum;
+    }
+
+    quint64 percentile(double p) const
+    {
+        if(m_total == 0)
+            return 0;
+
+        const quint64 target = qMax<quint64>(1, static_cast<quint64>(std::ceil(p / 100.0 * m_total)));
+        quint64 seen = 0;
+        for(size_t i = 0; i < m_counts.size(); ++i)
+        {
+            seen += m_counts[i];
+            if(seen >= target)
+                return qMin(upperBoundOf(static_cast<int>(i)), m_max);
+        }
+        return m_max;
+    }
+
+    quint64 count() const { return m_total; }
+    quint64 max() const { return m_max; }
+    double mean() const { return m_total ? double(m_sum) / m_total : 0.0; }
+
+private:
+    static int indexOf(quint64 value)
+    {
+        if(value < SubBuckets)
+            return static_cast<int>(value);
+
+        // 최상위 비트 위치로 구간을 정하고 그 아래 SubBucketBits 비트로 세부 구간을 정함
+        int magnitude = 63 - __builtin_clzll(value) - SubBucketBits + 1;
+        magnitude = qMin(magnitude, Magnitudes - 1);
+        const int sub = static_cast<int>((value >> magnitude) & (SubBuckets - 1));
+        return magnitude * SubBuckets + sub;
+    }
+
+    static quint64 upperBoundOf(int index)
+    {
+        const int magnitude = index / SubBuckets;
+        const quint64 sub = index % SubBuckets;
+        return ((sub + 1) << magnitude) - 1;
+    }
+
+    std::vector<quint64> m_counts;
+    quint64 m_total = 0;
+    quint64 m_max = 0;
+    quint64 m_sum = 0;
+};
+
+struct LoadOptions
+{
+    QHostAddress host = QHostAddress::LocalHost;
+    quint16 port = 8080;
+    int clients = 1000;
+    int threads = 0;
+    int durationSeconds = 30;
+    int rampSeconds = 5;
+    double messagesPerSecond = 1.0;
+    int messageSize = 64;
+    double attachmentRatio = 0.0;
+    int attachmentSize = 256 * 1024;
+    int rooms = 0;
+    // 비어 있지 않으면 host/port 대신 이 이름의 local 소켓으로 접속
+    QString localName;
+    // 첨부파일을 끝까지 받으면 다시 접속하여 서버가 다시 보내게 함(--attachment-bench)
+    bool redownload = false;
+};
+
+struct LoadResult
+{
+    quint64 connected = 0;
+    quint64 connectFailures = 0;
+    quint64 disconnects = 0;
+    quint64 messagesSent = 0;
+    quint64 attachmentsSent = 0;
+    quint64 bytesSent = 0;
+    quint64 pongsReceived = 0;
+    quint64 roomMessagesReceived = 0;
+    quint64 messagesReceived = 0;
+    quint64 attachmentChunksReceived = 0;
+    quint64 attachmentsReceived = 0;
+    quint64 bytesReceived = 0;
+    quint64 sendsSkipped = 0;
+    LatencyHistogram latency;
+
+    void merge(const LoadResult& other)
+    {
+        connected += other.connected;
+        connectFailures += other.connectFailures;
+        disconnects += other.disconnects;
+        messagesSent += other.messagesSent;
+        attachmentsSent += other.attachmentsSent;
+        bytesSent += other.bytesSent;
+        pongsReceived += other.pongsReceived;
+        roomMessagesReceived += other.roomMessagesReceived;
+        messagesReceived += other.messagesReceived;
+        attachmentChunksReceived += other.attachmentChunksReceived;
+        attachmentsReceived += other.attachmentsReceived;
+        bytesReceived += other.bytesReceived;
+        sendsSkipped += other.sendsSkipped;
+        latency.merge(other.latency);
+    }
+};
+
+// 한 thread에서 여러 가상 클라이언트를 담당
+class LoadWorker : public QObject
+{
+public:
+    // 송신 버퍼가 이 이상 쌓인 클라이언트는 이번 송신을 건너뜀(도구 자체의 메모리 보호)
+    static constexpr qint64 MaxPendingBytes = 1024 * 1024;
+    static constexpr int TickMs = 5;
+
+    LoadWorker(const LoadOptions& options, int clientCount) : m_options(options), m_clientCount(clientCount) {}
+
+    void start()
+    {
+        m_messagePayload = QByteArray(m_options.messageSize, 'x');
+        m_attachmentChunk.resize(64 * 1024);
+        for(int i = 0; i < m_attachmentChunk.size(); ++i)
+            m_attachmentChunk[i] = static_cast<char>(QRandomGenerator::global()->generate());
+
+        m_timer = new QTimer(this);
+        connect(m_timer, &QTimer::timeout, this, [this]() { tick(); });
+        m_timer->start(TickMs);
+        m_startNs = g_clock.nsecsElapsed();
+    }
+
+    // 측정 종료 : 모든 소켓을 닫고 결과를 반환(worker thread에서 호출)
+    LoadResult finish()
+    {
+        m_timer->stop();
+        foreach (QIODevice* socket, m_sockets)
+        {
+            socket->disconnect(this);
+            StreamSocket::abort(socket);
+        }
+        qDeleteAll(m_sockets);
+        m_sockets.clear();
+        return m_result;
+    }
+
+    // 측정 도중의 결과(worker thread에서 호출)
+    LoadResult snapshot() const { return m_result; }
+
+private:
+    struct Client
+    {
+        qint64 nextSendNs = 0;
+    };
+
+    void tick()
+    {
+        const qint64 now = g_clock.nsecsElapsed();
+
+        // ramp 시간 동안 접속 수를 균등하게 늘림
+        const qint64 rampNs = qint64(m_options.rampSeconds) * 1000000000LL;
+        const int target = rampNs > 0 ? qMin<qint64>(m_clientCount, (now - m_startNs) * m_clientCount / rampNs + 1) : m_clientCount;
+        while(m_sockets.size() < target)
+            openClient();
+
+        if(m_options.messagesPerSecond <= 0)
+            return;
+
+        const qint64 intervalNs = static_cast<qint64>(1e9 / m_options.messagesPerSecond);
+        for(int i = 0; i < m_sockets.size(); ++i)
+        {
+            QIODevice* socket = m_sockets[i];
+            Client& client = m_clients[i];
+            if(!StreamSocket::isConnected(socket) || now < client.nextSendNs)
+                continue;
+
+            // 처음 송신 시각을 흩어 모든 클라이언트가 같은 tick에 몰리지 않도록 함
+            if(client.nextSendNs == 0)
+            {
+                client.nextSendNs = now + static_cast<qint64>(QRandomGenerator::global()->bounded(double(intervalNs)));
+                continue;
+            }
+            client.nextSendNs += intervalNs;
+
+            if(socket->bytesToWrite() > MaxPendingBytes)
+            {
+                m_result.sendsSkipped++;
+                continue;
+            }
+
+            if(m_options.attachmentRatio > 0 && QRandomGenerator::global()->generateDouble() < m_options.attachmentRatio)
+                sendAttachment(socket);
+            else
+                sendMessage(socket, i);
+
+            sendPing(socket);
+        }
+    }
+
+    void openClient()
+    {
+        QTcpSocket* tcpSocket = nullptr;
+        QLocalSocket* localSocket = nullptr;
+        QIODevice* socket;
+        if(m_options.localName.isEmpty())
+            socket = tcpSocket = new QTcpSocket(this);
+        else
+            socket = localSocket = new QLocalSocket(this);
+        const int index = m_sockets.size();
+        m_sockets.append(socket);
+        m_clients.append(Client());
+
+        auto onConnected = [this, socket, index]() {
+            m_result.connected++;
+            // 클라이언트를 room에 고르게 나누어 넣음
+            if(m_options.rooms > 0)
+            {
+                const QByteArray frame = FrameProtocol::encodeFrame(FrameProtocol::FrameType::Join, 0, roomOf(index), QByteArray());
+                socket->write(frame);
+                m_result.bytesSent += frame.size();
+            }
+        };
+        if(tcpSocket)
+            connect(tcpSocket, &QTcpSocket::connected, this, onConnected);
+        else
+            connect(localSocket, &QLocalSocket::connected, this, onConnected);
+        StreamSocket::connectDisconnected(socket, this, [this]() { m_result.disconnects++; });
+        StreamSocket::connectErrorOccurred(socket, this, [this, socket]() {
+            if(!StreamSocket::isConnected(socket))
+                m_result.connectFailures++;
+        });
+        connect(socket, &QIODevice::readyRead, this, [this, index]() { readSocket(index); });
+
+        connectSocket(socket);
+    }
+
+    void connectSocket(QIODevice* socket)
+    {
+        if(QTcpSocket* tcpSocket = qobject_cast<QTcpSocket*>(socket))
+            tcpSocket->connectToHost(m_options.host, m_options.port);
+        else
+            static_cast<QLocalSocket*>(socket)->connectToServer(m_options.localName);
+    }
+
+    QByteArray roomOf(int index) const
+    {
+        return QByteArray("loadgen-") + QByteArray::number(index % m_options.rooms);
+    }
+
+    void sendMessage(QIODevice* socket, int index)
+    {
+        const QByteArray frame = m_options.rooms > 0
+                ? FrameProtocol::encodeFrame(FrameProtocol::FrameType::Publish, 0, roomOf(index), FrameProtocol::encodeRoomMessage(QByteArray(), m_messagePayload))
+                : FrameProtocol::encodeFrame(FrameProtocol::FrameType::Message, 0, QByteArray(), m_messagePayload);
+        socket->write(frame);
+        m_result.messagesSent++;
+        m_result.bytesSent += frame.size();
+    }
+
+    void sendAttachment(QIODevice* socket)
+    {
+        const quint32 transferId = ++m_nextTransferId;
+        qint64 written = socket->write(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentStart, transferId, "loadgen.bin", FrameProtocol::encodeFileSize(m_options.attachmentSize)));
+
+        for(qint64 offset = 0; offset < m_options.attachmentSize; offset += m_attachmentChunk.size())
+        {
+            const int length = static_cast<int>(qMin<qint64>(m_attachmentChunk.size(), m_options.attachmentSize - offset));
+            written += socket->write(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentChunk, transferId, QByteArray(), m_attachmentChunk.left(length)));
+        }
+
+        written += socket->write(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentEnd, transferId, QByteArray(), QByteArray()));
+        m_result.attachmentsSent++;
+        m_result.bytesSent += written;
+    }
+
+    // 보낸 시각(ns)을 payload에 담아 Ping 전송
+    void sendPing(QIODevice* socket)
+    {
+        QByteArray payload(sizeof(qint64), Qt::Uninitialized);
+        qToBigEndian<qint64>(g_clock.nsecsElapsed(), payload.data());
+        const QByteArray frame = FrameProtocol::encodeFrame(FrameProtocol::FrameType::Ping, 0, QByteArray(), payload);
+        socket->write(frame);
+        m_result.bytesSent += frame.size();
+    }
+
+    void readSocket(int index)
+    {
+        QIODevice* socket = m_sockets[index];
+        FrameProtocol::Frame frame;
+        while(FrameProtocol::readFrame(socket, &frame) == FrameProtocol::DecodeResult::Ok)
+        {
+            m_result.bytesReceived += FrameProtocol::HeaderSize + frame.name.size() + frame.payload.size();
+            if(frame.header.type == FrameProtocol::FrameType::Publish)
+                m_result.roomMessagesReceived++;
+            if(frame.header.type == FrameProtocol::FrameType::Message)
+                m_result.messagesReceived++;
+            if(frame.header.type == FrameProtocol::FrameType::AttachmentChunk)
+                m_result.attachmentChunksReceived++;
+            // 이어받기 key가 있는 전송은 offset을 알려야 본문이 옴(받은 것을 남기지 않으므로 항상 처음부터)
+            if(frame.header.type == FrameProtocol::FrameType::AttachmentStart && !FrameProtocol::decodeResumeKey(frame.payload).isEmpty())
+            {
+                const QByteArray resume = FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentResume, frame.header.streamId, QByteArray(), FrameProtocol::encodeFileSize(0));
+                socket->write(resume);
+                m_result.bytesSent += resume.size();
+                continue;
+            }
+            if(frame.header.type == FrameProtocol::FrameType::AttachmentEnd)
+            {
+                m_result.attachmentsReceived++;
+                // 다시 접속하면 서버가 같은 파일을 다시 보냄
+                if(m_options.redownload)
+                {
+                    StreamSocket::abort(socket);
+                    connectSocket(socket);
+                    return;
+                }
+                continue;
+            }
+            // 서버의 생존 확인 Ping에 응답하지 않으면 느린 전송률에서 연결이 끊어짐
+            if(frame.header.type == FrameProtocol::FrameType::Ping)
+            {
+                const QByteArray pong = FrameProtocol::encodeFrame(FrameProtocol::FrameType::Pong, frame.header.streamId, QByteArray(), frame.payload);
+                socket->write(pong);
+                m_result.bytesSent += pong.size();
+                continue;
+            }
+            if(frame.header.type != FrameProtocol::FrameType::Pong || frame.payload.size() != sizeof(qint64))
+                continue;
+
+            const qint64 sentNs = qFromBigEndian<qint64>(frame.payload.constData());
+            m_result.latency.record(static_cast<quint64>((g_clock.nsecsElapsed() - sentNs) / 1000));
+            m_result.pongsReceived++;
+        }
+    }
+
+    const LoadOptions m_options;
+    const int m_clientCount;
+    QTimer* m_timer = nullptr;
+    QList<QIODevice*> m_sockets;
+    QList<Client> m_clients;
+    QByteArray m_messagePayload;
+    QByteArray m_attachmentChunk;
+    quint32 m_nextTransferId = 0;
+    qint64 m_startNs = 0;
+    LoadResult m_result;
+};
+
+// /proc/<pid>/status의 VmRSS(KiB)
+qint64 readRssKiB(qint64 pid)
+{
+    QFile status(QString("/proc/%1/status").arg(pid));
+    if(!status.open(QIODevice::ReadOnly))
+        return -1;
+
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    foreach (const QByteArray& line, lines)
+    {
+        if(line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return -1;
+}
+
+// /proc/<pid>/stat의 utime + stime(ms)
+qint64 readCpuMsecs(qint64 pid)
+{
+#ifdef Q_OS_UNIX
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if(!stat.open(QIODevice::ReadOnly))
+        return -1;
+
+    // 두 번째 field(실행 파일 이름)에 공백이 있을 수 있으므로 마지막 ')' 뒤부터 나눔 : state가 3번째, utime/stime이 14/15번째 field
+    const QByteArray line = stat.readAll();
+    const QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    if(fields.size() < 13 || ticksPerSecond <= 0)
+        return -1;
+    return (fields.at(11).toLongLong() + fields.at(12).toLongLong()) * 1000 / ticksPerSecond;
+#else
+    Q_UNUSED(pid);
+    return -1;
+#endif
+}
+
+// 가상 클라이언트를 나누어 맡은 worker thread들
+struct WorkerPool
+{
+    QList<QThread*> threads;
+    QList<LoadWorker*> workers;
+};
+
+// 클라이언트를 thread마다 균등하게 나누어 접속 시작
+WorkerPool startWorkers(const LoadOptions& options)
+{
+    WorkerPool pool;
+    for(int i = 0; i < options.threads; ++i)
+    {
+        const int clientCount = options.clients / options.threads + (i < options.clients % options.threads ? 1 : 0);
+        QThread* thread = new QThread();
+        LoadWorker* worker = new LoadWorker(options, clientCount);
+        worker->moveToThread(thread);
+        thread->start();
+        QMetaObject::invokeMethod(worker, [worker]() { worker->start(); }, Qt::QueuedConnection);
+        pool.threads.append(thread);
+        pool.workers.append(worker);
+    }
+    return pool;
+}
+
+// 접속을 유지한 채 지금까지의 결과를 모음
+LoadResult snapshotWorkers(const WorkerPool& pool)
+{
+    LoadResult total;
+    foreach (LoadWorker* worker, pool.workers)
+    {
+        LoadResult result;
+        QMetaObject::invokeMethod(worker, [worker, &result]() { result = worker->snapshot(); }, Qt::BlockingQueuedConnection);
+        total.merge(result);
+    }
+    return total;
+}
+
+// 모든 소켓을 닫고 thread를 정리한 뒤 결과를 모음
+LoadResult stopWorkers(WorkerPool* pool)
+{
+    LoadResult total;
+    for(int i = 0; i < pool->workers.size(); ++i)
+    {
+        LoadWorker* worker = pool->workers[i];
+        LoadResult result;
+        QMetaObject::invokeMethod(worker, [worker, &result]() { result = worker->finish(); }, Qt::BlockingQueuedConnection);
+        total.merge(result);
+
+        pool->threads[i]->quit();
+        pool->threads[i]->wait();
+        delete worker;
+        delete pool->threads[i];
+    }
+    pool->workers.clear();
+    pool->threads.clear();
+    return total;
+}
+
+// event를 처리하면서 msecs 동안 기다림
+void waitMsecs(int msecs)
+{
+    QEventLoop loop;
+    QTimer::singleShot(msecs, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+// 측정 구간 하나의 클라이언트 결과와 서버 자원 사용량
+struct Measurement
+{
+    LoadResult before;
+    LoadResult after;
+    double seconds = 0;
+    qint64 serverCpuMsecs = -1;
+    qint64 serverPeakRssKiB = -1;
+
+    quint64 framesReceived() const
+    {
+        return (after.messagesReceived - before.messagesReceived) + (after.attachmentChunksReceived - before.attachmentChunksReceived);
+    }
+    quint64 bytesReceived() const { return after.bytesReceived - before.bytesReceived; }
+};
+
+// seconds 동안 클라이언트가 받은 양과 서버 CPU 시간, 최대 RSS(1초마다)를 잼
+Measurement measure(const WorkerPool& pool, int seconds, qint64 serverPid)
+{
+    Measurement measurement;
+    auto sampleRss = [&measurement, serverPid]() {
+        measurement.serverPeakRssKiB = qMax(measurement.serverPeakRssKiB, readRssKiB(serverPid));
+    };
+
+    measurement.before = snapshotWorkers(pool);
+    const qint64 cpuBefore = readCpuMsecs(serverPid);
+    QElapsedTimer timer;
+    timer.start();
+
+    QTimer rssTimer;
+    QObject::connect(&rssTimer, &QTimer::timeout, sampleRss);
+    rssTimer.start(1000);
+    waitMsecs(seconds * 1000);
+    rssTimer.stop();
+    sampleRss();
+
+    const qint64 cpuAfter = readCpuMsecs(serverPid);
+    measurement.seconds = timer.nsecsElapsed() / 1e9;
+    measurement.after = snapshotWorkers(pool);
+    if(cpuBefore >= 0 && cpuAfter >= 0)
+        measurement.serverCpuMsecs = cpuAfter - cpuBefore;
+    return measurement;
+}
+
+// 수신자 수마다 서버가 broadcast를 전달하는 비용 측정
+// 서버는 --broadcast-rate 또는 --broadcast-file로 broadcast를 계속 보내고 있어야 함
+// frame을 한 번만 인코딩해 모든 소켓이 공유하면 전달한 frame당 CPU와 수신자당 RSS는 수신자 수와 관계없이 거의 일정함
+QJsonObject broadcastBenchmark(LoadOptions options, const QList<int>& recipientCounts, qint64 serverPid)
+{
+    // 접속이 끝나고 서버가 안정된 뒤 측정, 단계 사이에는 서버가 연결을 정리할 시간을 둠
+    const int SettleMsecs = 2000;
+    const int threads = options.threads;
+
+    // 클라이언트는 받기만 함
+    options.messagesPerSecond = 0;
+
+    QJsonArray results;
+    foreach (int recipients, recipientCounts)
+    {
+        options.clients = recipients;
+        options.threads = qMin(threads, recipients);
+        WorkerPool pool = startWorkers(options);
+        waitMsecs(options.rampSeconds * 1000 + SettleMsecs);
+
+        const Measurement measurement = measure(pool, options.durationSeconds, serverPid);
+        const LoadResult total = stopWorkers(&pool);
+        const quint64 frames = measurement.framesReceived();
+
+        QJsonObject result;
+        result["recipients"] = recipients;
+        result["connected"] = static_cast<qint64>(total.connected);
+        result["disconnects"] = static_cast<qint64>(total.disconnects);
+        result["elapsed_s"] = measurement.seconds;
+        result["delivered_frames_per_s"] = frames / measurement.seconds;
+        result["delivered_bytes_per_s"] = measurement.bytesReceived() / measurement.seconds;
+        result["broadcasts_per_s"] = frames / measurement.seconds / recipients;
+        result["server_cpu_ms"] = measurement.serverCpuMsecs;
+        if(measurement.serverCpuMsecs >= 0)
+        {
+            result["server_cpu_percent"] = measurement.serverCpuMsecs / (measurement.seconds * 10.0);
+            if(frames > 0)
+                result["server_cpu_ns_per_delivered_frame"] = measurement.serverCpuMsecs * 1e6 / frames;
+        }
+        result["server_peak_rss_kib"] = measurement.serverPeakRssKiB;
+        if(measurement.serverPeakRssKiB >= 0)
+            result["server_rss_kib_per_recipient"] = double(measurement.serverPeakRssKiB) / recipients;
+        results.append(result);
+
+        waitMsecs(SettleMsecs);
+    }
+
+    QJsonObject config;
+    config["host"] = options.host.toString();
+    config["port"] = options.port;
+    config["local"] = options.localName;
+    config["threads"] = threads;
+    config["duration_s"] = options.durationSeconds;
+    config["ramp_s"] = options.rampSeconds;
+    config["server_pid"] = serverPid;
+
+    QJsonObject report;
+    report["config"] = config;
+    report["results"] = results;
+    return report;
+}
+
+// 서버가 접속한 클라이언트마다 보내는 첨부파일(--send-file)을 받는 처리량과 서버 CPU 측정
+// 클라이언트는 파일을 끝까지 받으면 다시 접속하여 측정 시간 동안 계속 받음
+// 같은 서버를 --no-sendfile 유무로 각각 띄워 실행하면 server_cpu_ms_per_gib로 두 경로를 비교할 수 있음
+// (AttachmentSender::MaxPrehashBytes보다 큰 파일은 처음 한 번은 hash를 구하며 복사 경로로 보내므로 ramp 동안 한 번 받은 뒤 잼)
+QJsonObject attachmentBenchmark(LoadOptions options, qint64 serverPid)
+{
+    const int SettleMsecs = 2000;
+
+    options.messagesPerSecond = 0;
+    options.redownload = true;
+    WorkerPool pool = startWorkers(options);
+    waitMsecs(options.rampSeconds * 1000 + SettleMsecs);
+
+    const Measurement measurement = measure(pool, options.durationSeconds, serverPid);
+    const LoadResult total = stopWorkers(&pool);
+    const double gib = measurement.bytesReceived() / double(1024 * 1024 * 1024);
+
+    QJsonObject config;
+    config["host"] = options.host.toString();
+    config["port"] = options.port;
+    config["local"] = options.localName;
+    config["clients"] = options.clients;
+    config["threads"] = options.threads;
+    config["duration_s"] = options.durationSeconds;
+    config["ramp_s"] = options.rampSeconds;
+    config["server_pid"] = serverPid;
+
+    QJsonObject report;
+    report["config"] = config;
+    report["elapsed_s"] = measurement.seconds;
+    report["connected"] = static_cast<qint64>(total.connected);
+    report["attachments_received"] = static_cast<qint64>(measurement.after.attachmentsReceived - measurement.before.attachmentsReceived);
+    report["bytes_received"] = static_cast<qint64>(measurement.bytesReceived());
+    report["mib_per_s"] = measurement.bytesReceived() / measurement.seconds / (1024 * 1024);
+    report["server_cpu_ms"] = measurement.serverCpuMsecs;
+    if(measurement.serverCpuMsecs >= 0)
+    {
+        report["server_cpu_percent"] = measurement.serverCpuMsecs / (measurement.seconds * 10.0);
+        if(gib > 0)
+            report["server_cpu_ms_per_gib"] = measurement.serverCpuMsecs / gib;
+    }
+    report["server_peak_rss_kib"] = measurement.serverPeakRssKiB;
+    return report;
+}
+
+QJsonObject latencyToJson(const LatencyHistogram& histogram)
+{
+    QJsonObject json;
+    json["count"] = static_cast<qint64>(histogram.count());
+    json["mean_us"] = histogram.mean();
+    json["p50_us"] = static_cast<qint64>(histogram.percentile(50.0));
+    json["p90_us"] = static_cast<qint64>(histogram.percentile(90.0));
+    json["p99_us"] = static_cast<qint64>(histogram.percentile(99.0));
+    json["p999_us"] = static_cast<qint64>(histogram.percentile(99.9));
+    json["max_us"] = static_cast<qint64>(histogram.max());
+    return json;
+}
+
+// chunk 크기마다 CRC32C 처리량(GB/s) 측정 : 사용 중인 구현과 CPU 명령을 쓰지 않는 구현 비교
+QJsonObject checksumBenchmark(qint64 totalBytes)
+{
+    const QList<int> chunkSizes = {1024, 64 * 1024, 1024 * 1024};
+
+    QByteArray buffer(chunkSizes.last(), Qt::Uninitialized);
+    for(int i = 0; i < buffer.size(); ++i)
+        buffer[i] = static_cast<char>(QRandomGenerator::global()->generate());
+
+    auto measure = [&buffer, totalBytes](int chunkSize, quint32 (*extend)(quint32, const char*, qint64)) {
+        const qint64 rounds = qMax<qint64>(1, totalBytes / chunkSize);
+        quint32 crc = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for(qint64 i = 0; i < rounds; ++i)
+            crc = extend(crc, buffer.constData(), chunkSize);
+        const qint64 nsecs = qMax<qint64>(1, timer.nsecsElapsed());
+        // 결과를 쓰지 않으면 계산이 최적화로 사라질 수 있음
+        static volatile quint32 sink;
+        sink = crc;
+        return double(rounds * chunkSize) / nsecs;
+    };
+
+    QJsonArray results;
+    foreach (int chunkSize, chunkSizes)
+    {
+        QJsonObject result;
+        result["chunk_size"] = chunkSize;
+        result["gbps"] = measure(chunkSize, &Crc32c::extend);
+        result["portable_gbps"] = measure(chunkSize, &Crc32c::extendPortable);
+        results.append(result);
+    }
+
+    QJsonObject report;
+    report["implementation"] = QString::fromLatin1(Crc32c::implementation());
+    report["bytes_per_run"] = totalBytes;
+    report["results"] = results;
+    return report;
+}
+
+// 해석 비용을 재거나 fuzzing의 재료로 쓰는 대표적인 frame
+struct SampleFrame
+{
+    const char* name;
+    QByteArray bytes;
+};
+
+QList<SampleFrame> sampleFrames()
+{
+    using namespace FrameProtocol;
+
+    QByteArray resumeKey(ResumeKeySize, 'k');
+    QByteArray contentHash(ContentHashSize, 'h');
+    QByteArray chunk(64 * 1024, Qt::Uninitialized);
+    for(int i = 0; i < chunk.size(); ++i)
+        chunk[i] = static_cast<char>(QRandomGenerator::global()->generate());
+    const QByteArray text = QByteArray("hello from a typical chat client, ").repeated(2);
+
+    // 압축 기준과 관계없이 압축된 frame을 만들기 위해 잠시 기준을 낮춤
+    const int threshold = compressionThreshold();
+    const bool compression = isCompressionEnabled();
+    setCompressionEnabled(true);
+    setCompressionThreshold(1);
+    const QByteArray compressed = compressFrame(encodeFrame(FrameType::Message, 0, QByteArray(), text.repeated(64)));
+    setCompressionThreshold(threshold);
+    setCompressionEnabled(compression);
+
+    return {
+        {"message", encodeFrame(FrameType::Message, 0, QByteArray(), text)},
+        {"room_message", encodeFrame(FrameType::Publish, 0, "general", encodeRoomMessage("id:42", text))},
+        {"ping", encodeFrame(FrameType::Ping, 0, QByteArray(), QByteArray(sizeof(qint64), '\0'))},
+        {"attachment_start", encodeFrame(FrameType::AttachmentStart, 7, "quarterly report.pdf", encodeAttachmentStart(12345678, resumeKey, contentHash))},
+        {"attachment_chunk", encodeFrame(FrameType::AttachmentChunk, 7, QByteArray(), chunk, FlagChecksum)},
+        {"attachment_end", encodeFrame(FrameType::AttachmentEnd, 7, QByteArray(), encodeFileChecksum(0x12345678))},
+        {"compressed_message", compressed},
+    };
+}
+
+// frame 종류마다 해석 비용 측정 : 소켓과 같은 QIODevice 경로(readFrame)와 메모리 버퍼 경로(decodeFrame)
+QJsonObject decodeBenchmark(qint64 frameCount)
+{
+    // 큰 frame도 cache에 머물도록 stream 하나에 담는 양을 제한하고 같은 stream을 반복해서 해석
+    const qint64 MaxStreamBytes = 4 * 1024 * 1024;
+
+    QJsonArray results;
+    foreach (const SampleFrame& sample, sampleFrames())
+    {
+        const int framesPerStream = static_cast<int>(qBound<qint64>(1, MaxStreamBytes / sample.bytes.size(), frameCount));
+        const QByteArray stream = sample.bytes.repeated(framesPerStream);
+        const qint64 rounds = qMax<qint64>(1, frameCount / framesPerStream);
+        const qint64 frames = rounds * framesPerStream;
+
+        FrameProtocol::Frame frame;
+        qint64 decoded = 0;
+
+        QBuffer device;
+        device.setData(stream);
+        device.open(QIODevice::ReadOnly);
+        QElapsedTimer timer;
+        timer.start();
+        quint64 allocations = allocationCount();
+        for(qint64 round = 0; round < rounds; ++round)
+        {
+            device.seek(0);
+            while(FrameProtocol::readFrame(&device, &frame) == FrameProtocol::DecodeResult::Ok)
+                ++decoded;
+        }
+        const qint64 readNsecs = timer.nsecsElapsed();
+        const quint64 readAllocations = allocationCount() - allocations;
+
+        timer.start();
+        allocations = allocationCount();
+        for(qint64 round = 0; round < rounds; ++round)
+        {
+            const char* data = stream.constData();
+            qint64 remaining = stream.size();
+            qint64 frameSize = 0;
+            while(FrameProtocol::decodeFrame(data, remaining, &frame, &frameSize) == FrameProtocol::DecodeResult::Ok)
+            {
+                data += frameSize;
+                remaining -= frameSize;
+                ++decoded;
+            }
+        }
+        const qint64 decodeNsecs = timer.nsecsElapsed();
+        const quint64 decodeAllocations = allocationCount() - allocations;
+
+        if(decoded != 2 * frames)
+            qWarning("Decoded %lld of %lld %s frames", decoded, 2 * frames, sample.name);
+
+        QJsonObject result;
+        result["frame"] = QString::fromLatin1(sample.name);
+        result["frame_bytes"] = sample.bytes.size();
+        result["frames"] = frames;
+        result["read_ns_per_frame"] = double(readNsecs) / frames;
+        result["decode_ns_per_frame"] = double(decodeNsecs) / frames;
+        result["decode_mbps"] = double(frames * sample.bytes.size()) * 1000.0 / qMax<qint64>(1, decodeNsecs);
+        if(isAllocationCountAvailable())
+        {
+            result["read_allocations_per_frame"] = double(readAllocations) / frames;
+            result["decode_allocations_per_frame"] = double(decodeAllocations) / frames;
+        }
+        results.append(result);
+    }
+
+    QJsonObject report;
+    report["results"] = results;
+    return report;
+}
+
+// fuzzing 결과
+struct FuzzResult
+{
+    qint64 okFrames = 0;
+    qint64 invalid = 0;
+    qint64 needMoreData = 0;
+    qint64 failures = 0;
+};
+
+// input 하나를 두 해석 경로로 끝까지 해석하며 결과가 같은지, 불완전한 입력을 완전한 frame으로 보지 않는지 확인
+// 실패하면 false를 반환하고 입력을 hex로 출력하여 재현에 사용
+bool fuzzOne(const QByteArray& input, FuzzResult* result)
+{
+    QBuffer device;
+    device.setData(input);
+    device.open(QIODevice::ReadOnly);
+
+    const char* data = input.constData();
+    qint64 remaining = input.size();
+    FrameProtocol::Frame fromDevice;
+    FrameProtocol::Frame fromMemory;
+    auto fail = [&input](const char* reason) {
+        qCritical("Decoder check failed (%s) for input %s", reason, input.toHex().constData());
+        return false;
+    };
+
+    while(true)
+    {
+        qint64 frameSize = -1;
+        const FrameProtocol::DecodeResult memoryResult = FrameProtocol::decodeFrame(data, remaining, &fromMemory, &frameSize);
+        const qint64 before = device.bytesAvailable();
+        const FrameProtocol::DecodeResult deviceResult = FrameProtocol::readFrame(&device, &fromDevice);
+        if(memoryResult != deviceResult)
+            return fail("decodeFrame and readFrame disagree");
+
+        if(memoryResult == FrameProtocol::DecodeResult::NeedMoreData)
+        {
+            ++result->needMoreData;
+            if(device.bytesAvailable() != before)
+                return fail("readFrame consumed an incomplete frame");
+            return true;
+        }
+        if(memoryResult == FrameProtocol::DecodeResult::Invalid)
+        {
+            ++result->invalid;
+            return true;
+        }
+
+        ++result->okFrames;
+        if(frameSize < FrameProtocol::HeaderSize || frameSize > remaining || before - device.bytesAvailable() != frameSize)
+            return fail("frame size out of range");
+        if(fromMemory.header.type != fromDevice.header.type || fromMemory.name != fromDevice.name || fromMemory.payload != fromDevice.payload)
+            return fail("decoded frames differ");
+        if(fromMemory.header.flags & (FrameProtocol::FlagCompressed | FrameProtocol::FlagChecksum))
+            return fail("transport flags left on a decoded frame");
+
+        // 한 바이트라도 모자라면 완전한 frame으로 보지 않아야 함
+        FrameProtocol::Frame partial;
+        qint64 partialSize = 0;
+        if(FrameProtocol::decodeFrame(data, frameSize - 1, &partial, &partialSize) == FrameProtocol::DecodeResult::Ok)
+            return fail("truncated frame decoded");
+
+        // payload 해석 함수도 임의의 payload를 받을 수 있어야 함
+        QByteArray sender;
+        QByteArray text;
+        quint32 sinceSequence = 0;
+        quint32 limit = 0;
+        FrameProtocol::decodeFileSize(fromMemory.payload);
+        FrameProtocol::decodeResumeKey(fromMemory.payload);
+        FrameProtocol::decodeContentHash(fromMemory.payload);
+        FrameProtocol::decodeFileChecksum(fromMemory.payload);
+        FrameProtocol::decodeHello(fromMemory.payload);
+        FrameProtocol::decodeHistoryRequest(fromMemory.payload, &sinceSequence, &limit);
+        if(FrameProtocol::decodeRoomMessage(fromMemory.payload, &sender, &text) && sender.size() + text.size() + 2 != fromMemory.payload.size())
+            return fail("room message fields do not add up");
+
+        data += frameSize;
+        remaining -= frameSize;
+    }
+}
+
+// 정상 frame을 이어 붙인 stream을 무작위로 변형하여 해석기에 넣음(seed가 같으면 같은 입력)
+QJsonObject fuzzDecode(qint64 iterations, quint32 seed)
+{
+    QRandomGenerator random(seed);
+    QList<SampleFrame> samples = sampleFrames();
+    // 큰 chunk는 변형해도 대부분 checksum에서 걸러지므로 작은 chunk를 함께 사용
+    samples.append({"small_chunk", FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentChunk, 1, QByteArray(), "0123456789", FrameProtocol::FlagChecksum)});
+    samples.append({"history_request", FrameProtocol::encodeFrame(FrameProtocol::FrameType::HistoryRequest, 0, QByteArray(), FrameProtocol::encodeHistoryRequest(1, 100))});
+
+    FuzzResult result;
+    QElapsedTimer timer;
+    timer.start();
+    for(qint64 i = 0; i < iterations; ++i)
+    {
+        QByteArray input;
+        const int frames = random.bounded(1, 5);
+        for(int f = 0; f < frames; ++f)
+            input += samples.at(random.bounded(samples.size())).bytes;
+
+        switch(random.bounded(4))
+        {
+        // 몇 바이트를 임의의 값으로 바꿈(header 부분을 더 자주)
+        case 0:
+        {
+            const int flips = random.bounded(1, 9);
+            for(int f = 0; f < flips; ++f)
+            {
+                const int position = random.bounded(2) ? random.bounded(qMin(input.size(), int(FrameProtocol::HeaderSize))) : random.bounded(input.size());
+                input[position] = static_cast<char>(random.generate());
+            }
+            break;
+        }
+        // 중간에서 자름
+        case 1:
+            input.truncate(random.bounded(input.size()));
+            break;
+        // 임의의 바이트를 끼워 넣음
+        case 2:
+        {
+            QByteArray garbage(random.bounded(1, 32), Qt::Uninitialized);
+            for(int g = 0; g < garbage.size(); ++g)
+                garbage[g] = static_cast<char>(random.generate());
+            input.insert(random.bounded(input.size() + 1), garbage);
+            break;
+        }
+        // 정상 header 뒤에 임의의 데이터(길이 field도 임의)
+        default:
+        {
+            QByteArray garbage(random.bounded(0, 256), Qt::Uninitialized);
+            for(int g = 0; g < garbage.size(); ++g)
+                garbage[g] = static_cast<char>(random.generate());
+            input = FrameProtocol::encodeHeader(static_cast<FrameProtocol::FrameType>(random.bounded(1, 13)), random.generate(),
+                                                random.bounded(2) ? static_cast<quint32>(garbage.size()) : random.generate(),
+                                                static_cast<quint8>(random.bounded(4))) + garbage;
+            break;
+        }
+        }
+
+        if(!fuzzOne(input, &result))
+            ++result.failures;
+    }
+
+    QJsonObject report;
+    report["seed"] = static_cast<qint64>(seed);
+    report["iterations"] = iterations;
+    report["ok_frames"] = result.okFrames;
+    report["invalid"] = result.invalid;
+    report["need_more_data"] = result.needMoreData;
+    report["failures"] = result.failures;
+    report["elapsed_ms"] = timer.elapsed();
+    return report;
+}
+
+// JSON 결과를 path(비어 있으면 stdout)에 기록
+bool writeReport(const QJsonObject& report, const QString& path)
+{
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    QFile output;
+    if(path.isEmpty())
+        output.open(stdout, QIODevice::WriteOnly);
+    else
+        output.setFileName(path);
+
+    if((!output.isOpen() && !output.open(QIODevice::WriteOnly)) || output.write(json) != json.size())
+    {
+        qCritical("Unable to write report: %s", qPrintable(output.errorString()));
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qtcp-loadgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Load generator and latency benchmark for QTCPServer");
+    parser.addHelpOption();
+    QCommandLineOption hostOption("host", "Server address.", "address", "127.0.0.1");
+    QCommandLineOption portOption("port", "Server port.", "port", "8080");
+    QCommandLineOption clientsOption("clients", "Number of simulated clients.", "count", "1000");
+    QCommandLineOption threadsOption("threads", "Number of client threads (0 = one per core).", "count", "0");
+    QCommandLineOption durationOption("duration", "Measurement duration in seconds.", "seconds", "30");
+    QCommandLineOption rampOption("ramp", "Seconds over which clients connect.", "seconds", "5");
+    QCommandLineOption rateOption("rate", "Sends per second per client.", "rate", "1");
+    QCommandLineOption messageSizeOption("message-size", "Message payload size in bytes.", "bytes", "64");
+    QCommandLineOption attachmentRatioOption("attachment-ratio", "Fraction of sends that are attachments (0..1).", "ratio", "0");
+    QCommandLineOption attachmentSizeOption("attachment-size", "Attachment size in bytes.", "bytes", "262144");
+    QCommandLineOption roomsOption("rooms", "Spread clients over this many rooms and publish messages to them (0 = plain messages).", "count", "0");
+    QCommandLineOption localOption("local", "Connect to the server's local socket with this name instead of host/port.", "name");
+    QCommandLineOption serverPidOption("server-pid", "Server process id for RSS and CPU sampling.", "pid");
+    QCommandLineOption attachmentBenchOption("attachment-bench", "Only connect --clients receiving clients that keep downloading the attachment the server sends on connect, and measure throughput and server CPU per GiB (needs --server-pid and a server started with --send-file).");
+    QCommandLineOption broadcastBenchOption("broadcast-bench", "Only connect receiving clients, for each of these comma-separated recipient counts in turn, and measure server CPU/RSS per delivered broadcast frame (needs --server-pid and a server started with --broadcast-rate or --broadcast-file).", "counts");
+    QCommandLineOption checksumBenchOption("checksum-bench", "Only measure CRC32C throughput over this many MiB per chunk size and exit.", "mib");
+    QCommandLineOption decodeBenchOption("decode-bench", "Only measure frame decoding cost over this many frames per frame type and exit.", "frames");
+    QCommandLineOption fuzzDecodeOption("fuzz-decode", "Only feed this many randomly mutated byte streams to the frame decoder and exit.", "iterations");
+    QCommandLineOption seedOption("seed", "Random seed for --fuzz-decode (0 = random).", "seed", "0");
+    QCommandLineOption outputOption("output", "Write the JSON report to this file instead of stdout.", "file");
+    parser.addOptions({hostOption, portOption, clientsOption, threadsOption, durationOption, rampOption, rateOption,
+                       messageSizeOption, attachmentRatioOption, attachmentSizeOption, roomsOption, localOption, serverPidOption, checksumBenchOption,
+                       decodeBenchOption, fuzzDecodeOption, seedOption, outputOption, broadcastBenchOption, attachmentBenchOption});
+    parser.process(app);
+
+    if(parser.isSet(checksumBenchOption))
+    {
+        const qint64 totalBytes = qMax<qint64>(1, parser.value(checksumBenchOption).toLongLong()) * 1024 * 1024;
+        return writeReport(checksumBenchmark(totalBytes), parser.value(outputOption)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(parser.isSet(decodeBenchOption))
+    {
+        const qint64 frames = qMax<qint64>(1, parser.value(decodeBenchOption).toLongLong());
+        return writeReport(decodeBenchmark(frames), parser.value(outputOption)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(parser.isSet(fuzzDecodeOption))
+    {
+        quint32 seed = parser.value(seedOption).toUInt();
+        if(seed == 0)
+            seed = QRandomGenerator::global()->generate() | 1;
+        const QJsonObject report = fuzzDecode(qMax<qint64>(1, parser.value(fuzzDecodeOption).toLongLong()), seed);
+        if(!writeReport(report, parser.value(outputOption)))
+            return EXIT_FAILURE;
+        return report["failures"].toInt() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    LoadOptions options;
+    options.host = QHostAddress(parser.value(hostOption));
+    options.port = parser.value(portOption).toUShort();
+    options.clients = qMax(1, parser.value(clientsOption).toInt());
+    options.threads = parser.value(threadsOption).toInt();
+    options.durationSeconds = qMax(1, parser.value(durationOption).toInt());
+    options.rampSeconds = qMax(0, parser.value(rampOption).toInt());
+    options.messagesPerSecond = parser.value(rateOption).toDouble();
+    options.messageSize = qMax(0, parser.value(messageSizeOption).toInt());
+    options.attachmentRatio = qBound(0.0, parser.value(attachmentRatioOption).toDouble(), 1.0);
+    options.attachmentSize = qMax(0, parser.value(attachmentSizeOption).toInt());
+    options.rooms = qMax(0, parser.value(roomsOption).toInt());
+    options.localName = parser.value(localOption);
+    const qint64 serverPid = parser.isSet(serverPidOption) ? parser.value(serverPidOption).toLongLong() : -1;
+
+    if(options.threads <= 0)
+        options.threads = qMax(1, QThread::idealThreadCount());
+
+    g_clock.start();
+
+    if(parser.isSet(broadcastBenchOption))
+    {
+        QList<int> recipientCounts;
+        foreach (const QString& count, parser.value(broadcastBenchOption).split(',', Qt::SkipEmptyParts))
+        {
+            const int recipients = count.trimmed().toInt();
+            if(recipients <= 0)
+            {
+                qCritical("Invalid recipient count: %s", qPrintable(count));
+                return EXIT_FAILURE;
+            }
+            recipientCounts.append(recipients);
+        }
+        if(recipientCounts.isEmpty() || serverPid <= 0)
+        {
+            qCritical("--broadcast-bench needs recipient counts and --server-pid");
+            return EXIT_FAILURE;
+        }
+        return writeReport(broadcastBenchmark(options, recipientCounts, serverPid), parser.value(outputOption)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    options.threads = qMin(options.threads, options.clients);
+
+    if(parser.isSet(attachmentBenchOption))
+    {
+        if(serverPid <= 0)
+        {
+            qCritical("--attachment-bench needs --server-pid");
+            return EXIT_FAILURE;
+        }
+        return writeReport(attachmentBenchmark(options, serverPid), parser.value(outputOption)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    WorkerPool pool = startWorkers(options);
+
+    // 측정하는 동안 1초마다 서버 RSS 기록
+    QJsonArray rssSamples;
+    qint64 peakRss = -1;
+    QTimer rssTimer;
+    if(serverPid > 0)
+    {
+        QObject::connect(&rssTimer, &QTimer::timeout, [&]() {
+            const qint64 rss = readRssKiB(serverPid);
+            if(rss >= 0)
+            {
+                rssSamples.append(rss);
+                peakRss = qMax(peakRss, rss);
+            }
+        });
+        rssTimer.start(1000);
+    }
+
+    QTimer::singleShot(options.durationSeconds * 1000, &app, [&]() {
+        rssTimer.stop();
+        const double elapsedSeconds = g_clock.nsecsElapsed() / 1e9;
+
+        const LoadResult total = stopWorkers(&pool);
+
+        QJsonObject config;
+        config["host"] = options.host.toString();
+        config["port"] = options.port;
+        config["local"] = options.localName;
+        config["clients"] = options.clients;
+        config["threads"] = options.threads;
+        config["duration_s"] = options.durationSeconds;
+        config["ramp_s"] = options.rampSeconds;
+        config["rate_per_client"] = options.messagesPerSecond;
+        config["message_size"] = options.messageSize;
+        config["attachment_ratio"] = options.attachmentRatio;
+        config["attachment_size"] = options.attachmentSize;
+        config["rooms"] = options.rooms;
+
+        QJsonObject throughput;
+        throughput["messages_per_s"] = total.messagesSent / elapsedSeconds;
+        throughput["attachments_per_s"] = total.attachmentsSent / elapsedSeconds;
+        throughput["bytes_per_s"] = total.bytesSent / elapsedSeconds;
+        throughput["pongs_per_s"] = total.pongsReceived / elapsedSeconds;
+        throughput["room_messages_received_per_s"] = total.roomMessagesReceived / elapsedSeconds;
+
+        QJsonObject counters;
+        counters["connected"] = static_cast<qint64>(total.connected);
+        counters["connect_failures"] = static_cast<qint64>(total.connectFailures);
+        counters["disconnects"] = static_cast<qint64>(total.disconnects);
+        counters["messages_sent"] = static_cast<qint64>(total.messagesSent);
+        counters["attachments_sent"] = static_cast<qint64>(total.attachmentsSent);
+        counters["bytes_sent"] = static_cast<qint64>(total.bytesSent);
+        counters["pongs_received"] = static_cast<qint64>(total.pongsReceived);
+        counters["room_messages_received"] = static_cast<qint64>(total.roomMessagesReceived);
+        counters["messages_received"] = static_cast<qint64>(total.messagesReceived);
+        counters["bytes_received"] = static_cast<qint64>(total.bytesReceived);
+        counters["sends_skipped"] = static_cast<qint64>(total.sendsSkipped);
+
+        QJsonObject report;
+        report["config"] = config;
+        report["elapsed_s"] = elapsedSeconds;
+        report["throughput"] = throughput;
+        report["counters"] = counters;
+        report["rtt"] = latencyToJson(total.latency);
+        if(serverPid > 0)
+        {
+            QJsonObject rss;
+            rss["peak_kib"] = peakRss;
+            rss["samples_kib"] = rssSamples;
+            report["server_rss"] = rss;
+        }
+
+        if(!writeReport(report, parser.value(outputOption)))
+        {
+            app.exit(EXIT_FAILURE);
+            return;
+        }
+        app.quit();
+    });
+
+    return app.exec();
+}
@@ -0,0 +1,173 @@
+#include "chatservercore.h"
+#include "chattcpserver.h"
+#include "frameprotocol.h"
+#include "messagehistory.h"
+
+ChatServerCore::ChatServerCore(int workerCount, QObject* parent)
+    : QObject(parent), m_server(new ChatTcpServer(workerCount, this))
+{
+    connect(m_server, &ChatTcpServer::signal_clientConnected, this, [this](ConnectionId connectionId) {
+        emit signal_newMessage(QString("INFO :: Client id:%1 has just entered the room").arg(connectionId));
+        emit signal_clientConnected(connectionId);
+    });
+    connect(m_server, &ChatTcpServer::signal_clientDisconnected, this, [this](ConnectionId connectionId) {
+        emit signal_newMessage("INFO :: A client has just left the room");
+        emit signal_clientDisconnected(connectionId);
+    });
+    connect(m_server, &ChatTcpServer::signal_attachmentOffered, this, &ChatServerCore::slot_attachmentOffered);
+    connect(m_server, &ChatTcpServer::signal_newMessage, this, &ChatServerCore::signal_newMessage);
+    connect(m_server, &ChatTcpServer::signal_error, this, &ChatServerCore::signal_error);
+}
+
+ChatServerCore::~ChatServerCore()
+{
+    // worker thread와 모든 연결 소켓 해제
+    delete m_server;
+}
+
+bool ChatServerCore::listen(const QHostAddress& address, quint16 port)
+{
+    if(!m_server->listen(address, port))
+        return false;
+
+    emit signal_newMessage(QString("INFO :: Server is listening on %1:%2").arg(address.toString()).arg(m_server->serverPort()));
+    return true;
+}
+
+void ChatServerCore::close()
+{
+    m_server->close();
+    m_server->closeLocal();
+}
+
+QString ChatServerCore::errorString() const
+{
+    return m_server->errorString();
+}
+
+bool ChatServerCore::listenLocal(const QString& name)
+{
+    if(!m_server->listenLocal(name))
+        return false;
+
+    emit signal_newMessage(QString("INFO :: Server is listening on local socket %1").arg(name));
+    return true;
+}
+
+QString ChatServerCore::localErrorString() const
+{
+    return m_server->localErrorString();
+}
+
+QList<ConnectionId> ChatServerCore::connectionIds() const
+{
+    return m_server->connectionIds();
+}
+
+bool ChatServerCore::isConnected(ConnectionId connectionId) const
+{
+    return m_server->isConnected(connectionId);
+}
+
+bool ChatServerCore::sendMessage(ConnectionId connectionId, const QString& message)
+{
+    if(!m_server->isConnected(connectionId))
+        return false;
+
+    m_server->sendFrame(connectionId, FrameProtocol::encodeFrame(FrameProtocol::FrameType::Message, 0, QByteArray(), message.toUtf8()));
+    return true;
+}
+
+void ChatServerCore::broadcastMessage(const QString& message)
+{
+    // frame을 한 번만 인코딩하여 모든 연결에 전송
+    // 느린 수신자에게는 DropNonCritical policy에 따라 버려질 수 있음
+    // 기록을 켰으면 sequence를 붙인 frame을 그대로 보냄(디스크 기록은 MessageHistory의 writer thread가 함)
+    const QByteArray frame = m_history ? m_history->append(QByteArray(), message.toUtf8())
+                                       : FrameProtocol::encodeFrame(FrameProtocol::FrameType::Message, 0, QByteArray(), message.toUtf8());
+    m_server->broadcastFrame(frame, OutboundQueue::Delivery::Droppable);
+}
+
+void ChatServerCore::publishMessage(const QString& room, const QString& message)
+{
+    // 서버가 보내는 메시지는 보낸 쪽을 비워 둠
+    const QByteArray name = room.toUtf8();
+    m_server->publishFrame(name, FrameProtocol::encodeFrame(FrameProtocol::FrameType::Publish, 0, name, FrameProtocol::encodeRoomMessage(QByteArray(), message.toUtf8())));
+}
+
+QHash<QByteArray, int> ChatServerCore::roomMemberCounts() const
+{
+    return m_server->roomMemberCounts();
+}
+
+bool ChatServerCore::sendAttachment(ConnectionId connectionId, const QString& filePath)
+{
+    if(!m_server->isConnected(connectionId))
+        return false;
+
+    m_server->sendAttachment(connectionId, filePath);
+    return true;
+}
+
+bool ChatServerCore::broadcastAttachment(const QString& filePath)
+{
+    return m_server->broadcastAttachment(filePath);
+}
+
+void ChatServerCore::acceptAttachment(ConnectionId connectionId, quint32 transferId, const QString& filePath)
+{
+    m_server->acceptAttachment(connectionId, transferId, filePath);
+}
+
+void ChatServerCore::rejectAttachment(ConnectionId connectionId, quint32 transferId)
+{
+    m_server->rejectAttachment(connectionId, transferId);
+    emit signal_newMessage(QString("INFO :: Attachment from id:%1 discarded").arg(connectionId));
+}
+
+bool ChatServerCore::enableHistory(const QString& directory, int maxSegments)
+{
+    QSharedPointer<MessageHistory> history(new MessageHistory(directory, maxSegments));
+    if(!history->open())
+    {
+        emit signal_error(QString("Unable to open message history: %1.").arg(history->errorString()));
+        return false;
+    }
+
+    m_history = history;
+    m_server->setHistory(history);
+    emit signal_newMessage(QString("INFO :: Message history in %1 (last sequence %2)").arg(directory).arg(history->lastSequence()));
+    return true;
+}
+
+void ChatServerCore::setQueueLimits(const OutboundQueue::Limits& limits)
+{
+    m_server->setQueueLimits(limits);
+}
+
+void ChatServerCore::setHeartbeat(const ConnectionWorker::Heartbeat& heartbeat)
+{
+    m_server->setHeartbeat(heartbeat);
+}
+
+void ChatServerCore::setRateLimit(const ConnectionWorker::RateLimit& rateLimit)
+{
+    m_server->setRateLimit(rateLimit);
+}
+
+void ChatServerCore::slot_attachmentOffered(ConnectionId connectionId, quint32 transferId, const QString& fileName, qint64 fileSize, const QHostAddress& peerAddress)
+{
+    // 정책으로 결정할 수 없는 첨부파일만 화면에 수신 여부를 물음
+    switch(m_attachmentPolicy.decide(fileName, fileSize, peerAddress))
+    {
+    case AttachmentPolicy::Decision::Accept:
+        acceptAttachment(connectionId, transferId, m_attachmentPolicy.spoolPath(fileName));
+        break;
+    case AttachmentPolicy::Decision::Reject:
+        rejectAttachment(connectionId, transferId);
+        break;
+    case AttachmentPolicy::Decision::Ask:
+        emit signal_attachmentOffered(connectionId, transferId, fileName, fileSize);
+        break;
+    }
+}
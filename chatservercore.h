@@ -0,0 +1,90 @@
+#ifndef CHATSERVERCORE_H
+#define CHATSERVERCORE_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QSharedPointer>
+
+#include "attachmentpolicy.h"
+
+#include "connectionid.h"
+#include "connectionworker.h"
+#include "outboundqueue.h"
+
+class ChatTcpServer;
+class MessageHistory;
+
+// 위젯에 의존하지 않는 채팅 서버 엔진
+// 접속 대기, 메시지/첨부파일 라우팅, 첨부파일 저장을 담당하며
+// 화면(MainWindow)이나 daemon은 signal로 상태를 받아 표시만 함
+class ChatServerCore : public QObject
+{
+    Q_OBJECT
+public:
+    // workerCount가 0이면 CPU 코어 수만큼 worker thread 생성
+    explicit ChatServerCore(int workerCount = 0, QObject* parent = nullptr);
+    ~ChatServerCore();
+
+    bool listen(const QHostAddress& address = QHostAddress::Any, quint16 port = 8080);
+    void close();
+    QString errorString() const;
+    // 같은 host 클라이언트용 local 소켓 접속 대기
+    bool listenLocal(const QString& name);
+    QString localErrorString() const;
+
+    QList<ConnectionId> connectionIds() const;
+    bool isConnected(ConnectionId connectionId) const;
+
+    // 메시지/첨부파일 송신
+    bool sendMessage(ConnectionId connectionId, const QString& message);
+    void broadcastMessage(const QString& message);
+    // room 구독자에게만 메시지 전송
+    void publishMessage(const QString& room, const QString& message);
+    QHash<QByteArray, int> roomMemberCounts() const;
+    bool sendAttachment(ConnectionId connectionId, const QString& filePath);
+    bool broadcastAttachment(const QString& filePath);
+
+    // 첨부파일 수신 여부 결정
+    void acceptAttachment(ConnectionId connectionId, quint32 transferId, const QString& filePath);
+    void rejectAttachment(ConnectionId connectionId, quint32 transferId);
+
+    // 연결별 송신 대기열 watermark와 느린 수신자 policy
+    void setQueueLimits(const OutboundQueue::Limits& limits);
+    OutboundQueue::Statistics queueStatistics() const { return OutboundQueue::statistics(); }
+
+    // 한동안 받은 것이 없는 연결에 Ping을 보내고, 그래도 응답이 없으면 끊는 주기
+    void setHeartbeat(const ConnectionWorker::Heartbeat& heartbeat);
+    ConnectionWorker::HeartbeatStatistics heartbeatStatistics() const { return ConnectionWorker::heartbeatStatistics(); }
+
+    // 한 클라이언트가 worker를 독차지하지 않도록 연결마다 초당 수신 frame/바이트를 제한
+    void setRateLimit(const ConnectionWorker::RateLimit& rateLimit);
+    ConnectionWorker::InboundStatistics inboundStatistics() const { return ConnectionWorker::inboundStatistics(); }
+
+    // 수신되는 첨부파일 처리 규칙
+    // 정책이 Ask로 결정한 첨부파일만 signal_attachmentOffered로 화면에 수신 여부를 물음
+    void setAttachmentPolicy(const AttachmentPolicy& policy) { m_attachmentPolicy = policy; }
+    const AttachmentPolicy& attachmentPolicy() const { return m_attachmentPolicy; }
+
+    // directory에 메시지 기록을 남기고 새로 접속한 클라이언트의 재생 요청에 응답
+    // (broadcast 메시지와 클라이언트가 보낸 메시지를 기록, 1:1 메시지는 기록하지 않음)
+    // 기록을 열 수 없으면 signal_error를 보내고 false 반환
+    bool enableHistory(const QString& directory, int maxSegments);
+    QSharedPointer<MessageHistory> history() const { return m_history; }
+
+signals:
+    void signal_clientConnected(ConnectionId connectionId);
+    void signal_clientDisconnected(ConnectionId connectionId);
+    void signal_attachmentOffered(ConnectionId connectionId, quint32 transferId, const QString& fileName, qint64 fileSize);
+    void signal_newMessage(const QString& message);
+    void signal_error(const QString& message);
+
+private slots:
+    void slot_attachmentOffered(ConnectionId connectionId, quint32 transferId, const QString& fileName, qint64 fileSize, const QHostAddress& peerAddress);
+
+private:
+    ChatTcpServer* m_server;
+    AttachmentPolicy m_attachmentPolicy;
+    QSharedPointer<MessageHistory> m_history;
+};
+
+#endif // CHATSERVERCORE_H
@@ -0,0 +1,254 @@
+#include "chattcpserver.h"
+#include "broadcastsender.h"
+#include "epolleventdispatcher.h"
+#include "frameprotocol.h"
+#include "outboundqueue.h"
+
+#include <QLocalServer>
+
+// QLocalServer도 QTcpServer처럼 descriptor만 받아 worker에 넘기기 위한 listener
+class ChatTcpServer::LocalListener : public QLocalServer
+{
+public:
+    explicit LocalListener(ChatTcpServer* server) : QLocalServer(server), m_server(server) {}
+
+protected:
+    void incomingConnection(quintptr socketDescriptor) override
+    {
+        m_server->dispatchConnection(qintptr(socketDescriptor), true);
+    }
+
+private:
+    ChatTcpServer* m_server;
+};
+
+ChatTcpServer::ChatTcpServer(int workerCount, QObject* parent) : QTcpServer(parent)
+{
+    // 연결 ID를 thread 간 signal 인자로 전달하기 위해 등록
+    qRegisterMetaType<ConnectionId>("ConnectionId");
+    qRegisterMetaType<QHostAddress>();
+
+    if(workerCount <= 0)
+        workerCount = qMax(1, QThread::idealThreadCount());
+
+    // worker마다 전용 thread와 event loop 생성
+    for(int i = 0; i < workerCount; ++i)
+    {
+        QThread* thread = new QThread(this);
+        thread->setObjectName(QString("ConnectionWorker-%1").arg(i));
+
+        ConnectionWorker* worker = new ConnectionWorker(&m_rooms);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+
+        // worker의 signal은 GUI thread로 queued 전달
+        connect(worker, &ConnectionWorker::signal_clientConnected, this, &ChatTcpServer::signal_clientConnected);
+        connect(worker, &ConnectionWorker::signal_clientDisconnected, this, [this](ConnectionId connectionId) {
+            m_owners.remove(connectionId);
+            emit signal_clientDisconnected(connectionId);
+        });
+        connect(worker, &ConnectionWorker::signal_attachmentOffered, this, &ChatTcpServer::signal_attachmentOffered);
+        connect(worker, &ConnectionWorker::signal_newMessage, this, &ChatTcpServer::signal_newMessage);
+        connect(worker, &ConnectionWorker::signal_error, this, &ChatTcpServer::signal_error);
+
+        // 켜져 있으면 Qt 기본 dispatcher 대신 epoll dispatcher로 소켓을 감시(thread 시작 전에만 설치 가능)
+        if(QAbstractEventDispatcher* dispatcher = EpollEventDispatcher::create())
+            thread->setEventDispatcher(dispatcher);
+
+        thread->start();
+        m_threads.append(thread);
+        m_workers.append(worker);
+    }
+}
+
+ChatTcpServer::~ChatTcpServer()
+{
+    close();
+    closeLocal();
+
+    // 각 worker thread에서 소켓을 닫은 뒤 thread 종료
+    foreach (ConnectionWorker* worker, m_workers)
+        QMetaObject::invokeMethod(worker, &ConnectionWorker::slot_closeAll, Qt::BlockingQueuedConnection);
+
+    foreach (QThread* thread, m_threads)
+    {
+        thread->quit();
+        thread->wait();
+    }
+}
+
+// 새 연결 요청이 들어오면 QTcpSocket을 만들지 않고 descriptor를 worker에 전달
+void ChatTcpServer::incomingConnection(qintptr socketDescriptor)
+{
+    dispatchConnection(socketDescriptor, false);
+}
+
+bool ChatTcpServer::listenLocal(const QString& name)
+{
+    if(!m_localListener)
+        m_localListener = new LocalListener(this);
+    else
+        m_localListener->close();
+
+    // 이전 실행이 비정상 종료하여 남은 소켓 파일 때문에 listen이 실패하지 않도록 함
+    QLocalServer::removeServer(name);
+    return m_localListener->listen(name);
+}
+
+void ChatTcpServer::closeLocal()
+{
+    if(m_localListener)
+        m_localListener->close();
+}
+
+QString ChatTcpServer::localErrorString() const
+{
+    return m_localListener ? m_localListener->errorString() : QString();
+}
+
+void ChatTcpServer::dispatchConnection(qintptr socketDescriptor, bool local)
+{
+    // descriptor는 연결이 끊기면 재사용되므로 연결마다 새 ID 발급
+    const ConnectionId connectionId = ++m_lastConnectionId;
+
+    ConnectionWorker* worker = leastLoadedWorker();
+    worker->reserveConnection();
+    m_owners.insert(connectionId, worker);
+
+    QMetaObject::invokeMethod(worker, [worker, connectionId, socketDescriptor, local]() {
+        if(local)
+            worker->slot_addLocalConnection(connectionId, socketDescriptor);
+        else
+            worker->slot_addConnection(connectionId, socketDescriptor);
+    }, Qt::QueuedConnection);
+}
+
+// 담당 연결 수가 가장 적은 worker 선택
+ConnectionWorker* ChatTcpServer::leastLoadedWorker() const
+{
+    ConnectionWorker* selected = m_workers.first();
+    foreach (ConnectionWorker* worker, m_workers)
+    {
+        if(worker->connectionCount() < selected->connectionCount())
+            selected = worker;
+    }
+    return selected;
+}
+
+void ChatTcpServer::sendFrame(ConnectionId connectionId, const QByteArray& frame)
+{
+    ConnectionWorker* worker = m_owners.value(connectionId);
+    if(!worker)
+        return;
+
+    QMetaObject::invokeMethod(worker, [worker, connectionId, frame]() {
+        worker->slot_sendFrame(connectionId, frame);
+    }, Qt::QueuedConnection);
+}
+
+void ChatTcpServer::broadcastFrame(const QByteArray& frame, OutboundQueue::Delivery delivery, const QSharedPointer<BroadcastBudget>& budget)
+{
+    // 압축을 지원하는 수신자가 여럿이어도 압축은 한 번만 함
+    const QByteArray compressedFrame = FrameProtocol::compressFrame(frame);
+
+    foreach (ConnectionWorker* worker, m_workers)
+    {
+        // worker가 처리하기 전까지의 몫을 미리 잡아두어 송신 측이 앞서 나가지 않도록 함
+        if(budget)
+            budget->acquire(frame.size());
+
+        QMetaObject::invokeMethod(worker, [worker, frame, compressedFrame, delivery, budget]() {
+            worker->slot_broadcastFrame(frame, compressedFrame, delivery, budget);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void ChatTcpServer::publishFrame(const QByteArray& room, const QByteArray& frame, OutboundQueue::Delivery delivery)
+{
+    m_rooms.publish(room, frame, delivery);
+}
+
+void ChatTcpServer::setQueueLimits(const OutboundQueue::Limits& limits)
+{
+    foreach (ConnectionWorker* worker, m_workers)
+    {
+        QMetaObject::invokeMethod(worker, [worker, limits]() {
+            worker->slot_setQueueLimits(limits);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void ChatTcpServer::setHistory(const QSharedPointer<MessageHistory>& history)
+{
+    foreach (ConnectionWorker* worker, m_workers)
+    {
+        QMetaObject::invokeMethod(worker, [worker, history]() {
+            worker->slot_setHistory(history);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void ChatTcpServer::setHeartbeat(const ConnectionWorker::Heartbeat& heartbeat)
+{
+    foreach (ConnectionWorker* worker, m_workers)
+    {
+        QMetaObject::invokeMethod(worker, [worker, heartbeat]() {
+            worker->slot_setHeartbeat(heartbeat);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void ChatTcpServer::setRateLimit(const ConnectionWorker::RateLimit& rateLimit)
+{
+    foreach (ConnectionWorker* worker, m_workers)
+    {
+        QMetaObject::invokeMethod(worker, [worker, rateLimit]() {
+            worker->slot_setRateLimit(rateLimit);
+        }, Qt::QueuedConnection);
+    }
+}
+
+bool ChatTcpServer::broadcastAttachment(const QString& filePath)
+{
+    // BroadcastSender는 전송이 끝나면 스스로 삭제됨
+    BroadcastSender* broadcastSender = new BroadcastSender(this, filePath, this);
+    if(!broadcastSender->start())
+    {
+        delete broadcastSender;
+        return false;
+    }
+    return true;
+}
+
+void ChatTcpServer::sendAttachment(ConnectionId connectionId, const QString& filePath)
+{
+    ConnectionWorker* worker = m_owners.value(connectionId);
+    if(!worker)
+        return;
+
+    QMetaObject::invokeMethod(worker, [worker, connectionId, filePath]() {
+        worker->slot_sendAttachment(connectionId, filePath);
+    }, Qt::QueuedConnection);
+}
+
+void ChatTcpServer::acceptAttachment(ConnectionId connectionId, quint32 transferId, const QString& filePath)
+{
+    ConnectionWorker* worker = m_owners.value(connectionId);
+    if(!worker)
+        return;
+
+    QMetaObject::invokeMethod(worker, [worker, connectionId, transferId, filePath]() {
+        worker->slot_acceptAttachment(connectionId, transferId, filePath);
+    }, Qt::QueuedConnection);
+}
+
+void ChatTcpServer::rejectAttachment(ConnectionId connectionId, quint32 transferId)
+{
+    ConnectionWorker* worker = m_owners.value(connectionId);
+    if(!worker)
+        return;
+
+    QMetaObject::invokeMethod(worker, [worker, connectionId, transferId]() {
+        worker->slot_rejectAttachment(connectionId, transferId);
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,85 @@
+#ifndef CHATTCPSERVER_H
+#define CHATTCPSERVER_H
+
+#include <QTcpServer>
+#include <QHash>
+#include <QList>
+#include <QThread>
+
+#include "connectionworker.h"
+#include "roomdirectory.h"
+
+// accept한 연결을 여러 worker thread에 나누어 주는 TCP 서버
+// incomingConnection에서 QTcpSocket을 만들지 않고 descriptor만 가장 한가한 worker에 넘김
+// 연결마다 재사용되지 않는 ConnectionId를 발급하여 이후 모든 송수신 대상 지정에 사용
+// 각 worker는 자신의 event loop에서 담당 소켓을 처리하므로
+// 한 클라이언트의 대용량 전송이 다른 클라이언트나 GUI를 멈추게 하지 않음
+// 같은 host의 클라이언트는 listenLocal로 연 local 소켓(AF_UNIX)으로도 접속할 수 있으며
+// TCP 연결과 같은 worker, 같은 ConnectionId 체계로 처리됨
+class ChatTcpServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    // workerCount가 0이면 CPU 코어 수만큼 worker thread 생성
+    explicit ChatTcpServer(int workerCount = 0, QObject* parent = nullptr);
+    ~ChatTcpServer();
+
+    // local 소켓 접속 대기(name은 소켓 이름 또는 파일 경로), 남아 있는 같은 이름의 소켓 파일은 지움
+    bool listenLocal(const QString& name);
+    void closeLocal();
+    QString localErrorString() const;
+
+    QList<ConnectionId> connectionIds() const { return m_owners.keys(); }
+    bool isConnected(ConnectionId connectionId) const { return m_owners.contains(connectionId); }
+
+    // GUI thread에서 호출, 실제 소켓 작업은 담당 worker thread에서 실행
+    void sendFrame(ConnectionId connectionId, const QByteArray& frame);
+    // 한 번 인코딩된 frame을 모든 연결에 전송(worker마다 한 번만 전달, 데이터 복사 없음, 압축도 한 번만 함)
+    void broadcastFrame(const QByteArray& frame, OutboundQueue::Delivery delivery = OutboundQueue::Delivery::Reliable, const QSharedPointer<BroadcastBudget>& budget = QSharedPointer<BroadcastBudget>());
+    // room 구독자에게만 frame 전송(구독자가 있는 worker에만 전달, 압축은 한 번만 함)
+    void publishFrame(const QByteArray& room, const QByteArray& frame, OutboundQueue::Delivery delivery = OutboundQueue::Delivery::Droppable);
+    // room별 구독자 수
+    QHash<QByteArray, int> roomMemberCounts() const { return m_rooms.memberCounts(); }
+    // 파일을 한 번만 읽어 모든 연결에 chunk 단위로 전송
+    bool broadcastAttachment(const QString& filePath);
+    void sendAttachment(ConnectionId connectionId, const QString& filePath);
+    void acceptAttachment(ConnectionId connectionId, quint32 transferId, const QString& filePath);
+    void rejectAttachment(ConnectionId connectionId, quint32 transferId);
+
+    // 연결별 송신 대기열 watermark와 느린 수신자 policy 설정
+    void setQueueLimits(const OutboundQueue::Limits& limits);
+    // 클라이언트 메시지 기록과 HistoryRequest 처리에 사용할 메시지 기록 설정
+    void setHistory(const QSharedPointer<MessageHistory>& history);
+    // 응답 없는 연결을 찾아 끊는 생존 확인 주기 설정
+    void setHeartbeat(const ConnectionWorker::Heartbeat& heartbeat);
+    // 연결별 수신 frame/바이트 한도 설정
+    void setRateLimit(const ConnectionWorker::RateLimit& rateLimit);
+
+signals:
+    void signal_clientConnected(ConnectionId connectionId);
+    void signal_clientDisconnected(ConnectionId connectionId);
+    void signal_attachmentOffered(ConnectionId connectionId, quint32 transferId, const QString& fileName, qint64 fileSize, const QHostAddress& peerAddress);
+    void signal_newMessage(const QString& message);
+    void signal_error(const QString& message);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    class LocalListener;
+
+    // TCP/local 연결의 descriptor를 가장 한가한 worker에 전달
+    void dispatchConnection(qintptr socketDescriptor, bool local);
+    ConnectionWorker* leastLoadedWorker() const;
+
+    // worker들이 함께 쓰는 room 색인(worker보다 늦게 해제되도록 먼저 선언)
+    RoomDirectory m_rooms;
+    QList<QThread*> m_threads;
+    QList<ConnectionWorker*> m_workers;
+    // 연결별 담당 worker(GUI thread에서만 접근)
+    QHash<ConnectionId, ConnectionWorker*> m_owners;
+    ConnectionId m_lastConnectionId = 0;
+    LocalListener* m_localListener = nullptr;
+};
+
+#endif // CHATTCPSERVER_H
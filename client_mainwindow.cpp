@@ -1,33 +1,82 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "blobcache.h"
+#include "attachmentreceiver.h"
+#include "attachmentsender.h"
+#include "frameprotocol.h"
+#include "messagelogmodel.h"
+#include "messagelogview.h"
+#include "outboundqueue.h"
+
+#include <QCommandLineParser>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QTimer>
+
+// 처음 접속할 때 서버에 요청하는 이전 메시지 수
+static constexpr quint32 HistoryReplayCount = 50;
+// 접속 시도 제한 시간(ms)
+static constexpr int ConnectTimeout = 10000;
+// 재접속 대기 시간(ms) : 처음 상한에서 실패할 때마다 두 배, 최대 ReconnectMaxDelay
+static constexpr int ReconnectInitialDelay = 500;
+static constexpr int ReconnectMaxDelay = 30000;
+// 연결이 끊어진 동안 모아 두는 최대 메시지 수
+static constexpr int MaxPendingMessages = 1000;
 
 // MainWindow 생성자 실행
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
 
-    // 소켓 초기화 및 생성
-    m_socket = new QTcpSocket(this);
-    // 서버 연결 요청
-    m_socket->connectToHost(QHostAddress::LocalHost,8080);
-    if(m_socket->waitForConnected())
-    {
-        // 연결 성공시 출력
-        ui->statusBar->showMessage("Connected to Server");
-    }
-    else
-    {
-        QMessageBox::critical(this,"QTCPClient", QString("The following error occurred: %1.").arg(m_socket->errorString()));
-        exit(EXIT_FAILURE);
-    }
+    // 로그는 ring buffer model에 모았다가 일정 주기로만 화면에 반영
+    m_log = new MessageLogModel(MessageLogModel::DefaultCapacity, this);
+    MessageLogView::replace(ui->textBrowser_receivedMessages, m_log);
 
-    // 연결된 socket에 data 수신 시, slot_readSocket 실행
-    connect(m_socket, &QTcpSocket::readyRead, this, &MainWindow::slot_readSocket);
+    // 받은 첨부파일을 내용 hash로 보관해 같은 파일은 다시 받지 않음
+    BlobCache::instance()->open(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/attachments");
 
     // singal_newMessage 시그널 발생 시, slot_displayMessage 실행
     connect(this, &MainWindow::signal_newMessage,
             this, &MainWindow::slot_displayMessage);
 
+    // 접속할 서버 : 실행 인자 --host, --port(기본값 localhost:8080)
+    QCommandLineParser parser;
+    QCommandLineOption hostOption("host", "Server host name or address.", "host", "localhost");
+    QCommandLineOption portOption("port", "Server port.", "port", "8080");
+    parser.addOption(hostOption);
+    parser.addOption(portOption);
+    parser.parse(QCoreApplication::arguments());
+    m_host = parser.value(hostOption);
+    m_port = parser.value(portOption).toUShort();
+    if(m_port == 0)
+        m_port = 8080;
+
+    // 접속 시도 제한 시간과 재접속 대기는 timer 하나씩으로 처리(소켓이 바뀌어도 유지)
+    m_connectTimer = new QTimer(this);
+    m_connectTimer->setSingleShot(true);
+    connect(m_connectTimer, &QTimer::timeout, this, [this]() {
+        scheduleReconnect("Connection timed out");
+    });
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &MainWindow::connectToServer);
+
+    // 화면을 띄운 뒤 event loop에서 접속(접속을 기다리느라 화면이 멈추지 않음)
+    QTimer::singleShot(0, this, &MainWindow::connectToServer);
+}
+
+// 새 소켓을 만들어 비동기로 접속 시작
+// 소켓마다 송신 대기열과 첨부파일 수신기를 새로 붙이므로 이전 연결의 상태는 남지 않음
+void MainWindow::connectToServer()
+{
+    m_socket = new QTcpSocket(this);
+
+    // 연결된 socket에 data 수신 시, slot_readSocket 실행
+    connect(m_socket, &QTcpSocket::readyRead, this, &MainWindow::slot_readSocket);
+
+    // 접속이 완료되면 slot_connected 실행
+    connect(m_socket, &QTcpSocket::connected, this, &MainWindow::slot_connected);
+
     // 연결된 소켓과 연결이 종료되면, slot_discardSocket 실행
     connect(m_socket, &QTcpSocket::disconnected,
             this,     &MainWindow::slot_discardSocket);
@@ -36,42 +85,124 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     connect(m_socket, &QAbstractSocket::errorOccurred,
             this,     &MainWindow::slot_displayError);
 
+    // 첨부파일 chunk를 보관할 송신 대기열을 소켓의 자식으로 생성
+    new OutboundQueue(m_socket);
+
+    // 첨부파일 chunk를 디스크에 기록할 수신기를 소켓의 자식으로 생성
+    AttachmentReceiver* receiver = new AttachmentReceiver(m_socket);
+    connect(receiver, &AttachmentReceiver::signal_stored, this, [this](quint32, const QString& filePath) {
+        emit signal_newMessage(QString("INFO :: Attachment from server successfully stored on disk under the path %1").arg(filePath));
+    });
+    // 소켓 읽기 slot 안에서(write/finish) 발생할 수 있으므로 modal 대화상자 대신 메시지 목록에 표시
+    connect(receiver, &AttachmentReceiver::signal_failed, this, [this](quint32, const QString& reason) {
+        emit signal_newMessage(QString("ERROR :: An error occurred while trying to write the attachment: %1.").arg(reason));
+    });
+    // 디스크 기록이 따라잡으면 멈췄던 읽기 재개
+    connect(receiver, &AttachmentReceiver::signal_drained, this, &MainWindow::slot_readSocket);
+    // 읽기를 멈춘 동안 소켓 데이터가 끝없이 쌓이지 않도록 버퍼 크기를 frame 하나로 제한
+    m_socket->setReadBufferSize(FrameProtocol::MaxFrameSize);
+
+    ui->statusBar->showMessage(QString("Connecting to %1:%2...").arg(m_host).arg(m_port));
+    m_connectTimer->start(ConnectTimeout);
+    m_socket->connectToHost(m_host, m_port);
+}
+
+// 접속 완료 : 지원 기능을 알리고 끊어진 동안 쌓아 둔 메시지를 한 번에 보냄
+void MainWindow::slot_connected()
+{
+    m_connectTimer->stop();
+    m_reconnectAttempts = 0;
+
+    // 가장 먼저 Hello로 지원 기능을 알림(서버의 Hello를 받기 전까지는 압축하지 않음)
+    // 서버의 Hello를 받으면 마지막으로 받은 메시지 이후의 기록을 요청함
+    OutboundQueue* queue = OutboundQueue::of(m_socket);
+    queue->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Hello, 0, QByteArray(), FrameProtocol::encodeHello(FrameProtocol::localCapabilities())));
+
+    // 들어가 있던 room에 다시 들어감
+    if(!m_currentRoom.isEmpty())
+        queue->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Join, 0, m_currentRoom.toUtf8(), QByteArray()));
+
+    // 쌓아 둔 frame은 이어 붙여 대기열에 한 번만 넣음(메시지 frame이므로 섞이지 않음)
+    if(!m_pendingFrames.isEmpty())
+    {
+        QByteArray batch;
+        foreach (const QByteArray& frame, m_pendingFrames)
+            batch += frame;
+        queue->enqueue(batch);
+        emit signal_newMessage(QString("INFO :: Sent %1 message(s) queued while disconnected").arg(m_pendingFrames.size()));
+        m_pendingFrames.clear();
+    }
+
+    ui->statusBar->showMessage(m_currentRoom.isEmpty() ? QString("Connected to Server") : QString("Room: %1").arg(m_currentRoom));
+}
+
+// 재접속 예약
+// 대기 시간은 실패할 때마다 두 배로 늘리되 상한을 두고, 그 안에서 무작위로 골라(full jitter)
+// 서버가 재시작되어도 모든 클라이언트가 같은 순간에 다시 접속하지 않도록 함
+void MainWindow::scheduleReconnect(const QString& reason)
+{
+    m_connectTimer->stop();
+    if(m_socket)
+    {
+        m_socket->disconnect(this);
+        m_socket->abort();
+        m_socket->deleteLater();
+        m_socket = nullptr;
+    }
+
+    const qint64 ceiling = qMin<qint64>(ReconnectMaxDelay, static_cast<qint64>(ReconnectInitialDelay) << qMin(m_reconnectAttempts, 16));
+    const int delay = 1 + static_cast<int>(QRandomGenerator::global()->bounded(ceiling));
+    m_reconnectAttempts++;
+
+    ui->statusBar->showMessage(QString("%1, reconnecting in %2 s").arg(reason).arg(delay / 1000.0, 0, 'f', 1));
+    m_reconnectTimer->start(delay);
 }
 
 // [ex.02.2]
 MainWindow::~MainWindow()
 {
-    // 소멸자, socket 해제
-    if(m_socket->isOpen())
+    // 소멸자, socket 해제(닫으면서 재접속을 예약하지 않도록 연결을 먼저 끊음)
+    if(m_socket)
+    {
+        m_socket->disconnect(this);
         m_socket->close();
+    }
     delete ui;
 }
 
 
-// 서버에서 연결이 끊어지면 소켓 제거
+// 서버에서 연결이 끊어지면 소켓을 제거하고 재접속 예약
 void MainWindow::slot_discardSocket()
 {
-    m_socket->deleteLater();
-    m_socket=nullptr;
-
-    ui->statusBar->showMessage("Disconnected!");
+    scheduleReconnect("Disconnected");
 }
 
 
 // 연결된 소켓에서 발생한 오류에 따라 문장 출력
 void MainWindow::slot_displayError(QAbstractSocket::SocketError socketError)
 {
+    // 접속 중의 오류는 대화상자 대신 상태 표시줄에 알리고 재접속(연결된 뒤의 오류는 disconnected에서 처리)
+    if(m_socket && m_socket->state() != QAbstractSocket::ConnectedState && m_connectTimer->isActive())
+    {
+        switch (socketError) {
+        case QAbstractSocket::HostNotFoundError:
+            scheduleReconnect(QString("Host %1 not found").arg(m_host));
+            break;
+        case QAbstractSocket::ConnectionRefusedError:
+            scheduleReconnect("Connection refused");
+            break;
+        default:
+            scheduleReconnect(m_socket->errorString());
+            break;
+        }
+        return;
+    }
+
     switch (socketError) {
     case QAbstractSocket::RemoteHostClosedError:
         break;
-    case QAbstractSocket::HostNotFoundError:
-        QMessageBox::information(this, "QTCPClient", "The host was not found. Please check the host name and port settings.");
-        break;
-    case QAbstractSocket::ConnectionRefusedError:
-        QMessageBox::information(this, "QTCPClient", "The connection was refused by the peer. Make sure QTCPServer is running, and check that the host name and port settings are correct.");
-        break;
     default:
-        QMessageBox::information(this, "QTCPClient", QString("The following error occurred: %1.").arg(m_socket->errorString()));
+        emit signal_newMessage(QString("INFO :: The following error occurred: %1.").arg(m_socket ? m_socket->errorString() : QString()));
         break;
     }
 }
@@ -80,78 +211,172 @@ void MainWindow::slot_displayError(QAbstractSocket::SocketError socketError)
 // 첨부파일 또는 메시지 수신 함수
 void MainWindow::slot_readSocket()
 {
-    // QByteArray 자료형 선언
-    QByteArray buffer;
-
-    // socket을 stream으로 연결
-    QDataStream socketStream(m_socket);
-    socketStream.setVersion(QDataStream::Qt_5_15);
+    if(!m_socket)
+        return;
 
-    // transaction을 시작
-    socketStream.startTransaction();
-    socketStream >> buffer;
+    // 소켓에 붙어있는 첨부파일 수신기
+    AttachmentReceiver* receiver = m_socket->findChild<AttachmentReceiver*>(QString(), Qt::FindDirectChildrenOnly);
 
-    // stream startTransaction 실행 문제시 에러 표시 후 함수 종료
-    if(!socketStream.commitTransaction())
+    // 한 번의 readyRead에 도착한 frame(chunk)을 모두 처리
+    FrameProtocol::Frame frame;
+    while(m_socket)
     {
-        QString message = QString("%1 :: Waiting for more data to come..").arg(m_socket->socketDescriptor());
-        emit signal_newMessage(message);
-        return;
-    }
-
-    // 수신한 메시지의 0~128byte를 header에 저장
-    QString header = buffer.mid(0,128);
-    // ,로 split한 후에 나온 0번째 인덱스 값을 :로 split하여 1번째 값을 fileType에 저장
-    QString fileType = header.split(",")[0].split(":")[1];
+        // 첨부파일 기록이 밀려 있으면 더 읽지 않고 signal_drained에서 재개
+        if(receiver->isBackedUp())
+            return;
 
-    // buffer의 128 byte 이후 부분을 저장
-    buffer = buffer.mid(128);
+        // 소켓 버퍼에서 완성된 frame을 하나 꺼냄
+        FrameProtocol::DecodeResult result = FrameProtocol::readFrame(m_socket, &frame);
 
+        // frame이 다 도착하지 않았으면 다음 readyRead까지 대기
+        // 큰 첨부파일을 받는 동안에는 거의 매번 일어나므로 로그에 남기지 않음
+        if(result == FrameProtocol::DecodeResult::NeedMoreData)
+            return;
 
-    // fileType이 attachment인 경우
-    if(fileType=="attachment")
-    {
-        // 파일 이름
-        QString fileName = header.split(",")[1].split(":")[1];
-        // 파일 형식
-        QString ext = fileName.split(".")[1];
-        // 파일 크기
-        QString size = header.split(",")[2].split(":")[1].split(";")[0];
-
-        // 파일 전송 관련 메시지 박스에서 Yes를 선택하면
-        if (QMessageBox::Yes == QMessageBox::question(this, "QTCPServer", QString("You are receiving an attachment from sd:%1 of size: %2 bytes, called %3. Do you want to accept it?").arg(m_socket->socketDescriptor()).arg(size).arg(fileName)))
+        // 형식이 맞지 않는 frame을 받으면 연결 종료(읽기 slot이 대화상자를 기다리지 않도록 메시지 목록에 표시)
+        if(result == FrameProtocol::DecodeResult::Invalid)
         {
-            // 저장될 파일 경로 및 파일 이름 + 확장자 지정
-            QString filePath = QFileDialog::getSaveFileName(this, tr("Save File"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)+"/"+fileName, QString("File (*.%1)").arg(ext));
-
-            // 해당 경로의 파일을 file 객체로 설정
-            QFile file(filePath);
+            emit signal_newMessage("ERROR :: Received an invalid frame from the server, closing connection");
+            m_socket->abort();
+            return;
+        }
 
-            // file 객체를 열음
-            if(file.open(QIODevice::WriteOnly))
+        switch(frame.header.type)
+        {
+        // 첨부파일 전송 시작
+        case FrameProtocol::FrameType::AttachmentStart:
+        {
+            // 파일 이름(경로가 섞여 있으면 파일 이름만 사용)
+            QString fileName = QFileInfo(QString::fromUtf8(frame.name)).fileName();
+            // 파일 형식
+            QString ext = QFileInfo(fileName).suffix();
+            // 파일 크기
+            qint64 size = FrameProtocol::decodeFileSize(frame.payload);
+            // 전송 식별자, 이어받기 key
+            quint32 transferId = frame.header.streamId;
+            QByteArray resumeKey = FrameProtocol::decodeResumeKey(frame.payload);
+            QByteArray contentHash = FrameProtocol::decodeContentHash(frame.payload);
+
+            // 수신 여부를 묻는 동안 도착하는 chunk는 임시 파일에 바로 기록
+            qint64 received = receiver->begin(transferId, fileName, size, resumeKey, contentHash);
+            // 받을 수 없으면(이유는 signal_failed로 표시됨) 이미 다 받은 것으로 알려
+            // 송신 측이 본문 없이 end frame만 보내게 함(end frame은 무시됨)
+            if(received < 0)
             {
-                // buffer에 있는 데이터를 수신
-                file.write(buffer);
+                OutboundQueue::of(m_socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentResume, transferId, QByteArray(), FrameProtocol::encodeFileSize(qMax<qint64>(0, size))));
+                break;
+            }
 
-                // 파일이 저장되는 것에 대한 메시지를 ui에 출력
-                QString message = QString("INFO :: Attachment from sd:%1 successfully stored on disk under the path %2").arg(m_socket->socketDescriptor()).arg(QString(filePath));
-                emit signal_newMessage(message);
+            // 이어받기 가능한 전송이면 대화상자를 띄우기 전에 이미 받은 바이트 수를 알려줌
+            if(!resumeKey.isEmpty())
+            {
+                OutboundQueue::of(m_socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentResume, transferId, QByteArray(), FrameProtocol::encodeFileSize(received)));
+                if(received > 0 && received == size)
+                    emit signal_newMessage(QString("INFO :: Attachment %1 is already available, skipping %2 bytes").arg(fileName).arg(size));
+                else if(received > 0)
+                    emit signal_newMessage(QString("INFO :: Resuming attachment %1 at %2 of %3 bytes").arg(fileName).arg(received).arg(size));
             }
-            else
-                QMessageBox::critical(this,"QTCPServer", "An error occurred while trying to write the attachment.");
+
+            // 수신 여부는 modal event loop 없이 묻고 결과는 signal로 받음
+            // (소켓 읽기 slot이 대화상자를 기다리지 않으므로 그동안에도 chunk 수신이 계속됨)
+            // 대화상자가 떠 있는 동안 연결이 끊겨 수신기가 사라질 수 있으므로 QPointer로 확인
+            QPointer<AttachmentReceiver> pendingReceiver(receiver);
+            // 거절하면 송신 측이 남은 본문을 보내지 않도록 끝 offset을 알림(다시 연결했을 수 있으므로 수신기의 소켓으로 보냄)
+            auto discard = [this, pendingReceiver, transferId]() {
+                const qint64 skipTo = pendingReceiver ? pendingReceiver->reject(transferId) : -1;
+                if(skipTo >= 0)
+                    OutboundQueue::of(qobject_cast<QIODevice*>(pendingReceiver->parent()))->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentResume, transferId, QByteArray(), FrameProtocol::encodeFileSize(skipTo)));
+                emit signal_newMessage("INFO :: Attachment from server discarded");
+            };
+
+            QMessageBox* question = new QMessageBox(QMessageBox::Question, "QTCPClient", QString("You are receiving an attachment from the server of size: %1 bytes, called %2. Do you want to accept it?").arg(size).arg(fileName), QMessageBox::Yes | QMessageBox::No, this);
+            question->setAttribute(Qt::WA_DeleteOnClose);
+            connect(question, &QMessageBox::finished, this, [this, pendingReceiver, transferId, fileName, ext, discard](int result) {
+                // 파일 전송 관련 메시지 박스에서 No를 선택
+                if(result != QMessageBox::Yes)
+                {
+                    discard();
+                    return;
+                }
+
+                // 저장될 파일 경로 및 파일 이름 + 확장자 지정
+                QString filter = ext.isEmpty() ? QString("File (*)") : QString("File (*.%1)").arg(ext);
+                QFileDialog* dialog = new QFileDialog(this, tr("Save File"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)+"/"+fileName, filter);
+                dialog->setAcceptMode(QFileDialog::AcceptSave);
+                dialog->setAttribute(Qt::WA_DeleteOnClose);
+
+                // 저장 경로를 지정하면 수신 완료 시 해당 경로로 저장
+                connect(dialog, &QFileDialog::fileSelected, this, [pendingReceiver, transferId](const QString& filePath) {
+                    if(pendingReceiver)
+                        pendingReceiver->accept(transferId, filePath);
+                });
+                connect(dialog, &QFileDialog::rejected, this, discard);
+                dialog->open();
+            });
+            question->open();
+            break;
         }
-        else
+        // 첨부파일 데이터 chunk
+        case FrameProtocol::FrameType::AttachmentChunk:
+            receiver->write(frame.header.streamId, frame.payload);
+            break;
+        // 첨부파일 전송 완료
+        case FrameProtocol::FrameType::AttachmentEnd:
+            receiver->finish(frame.header.streamId, FrameProtocol::decodeFileChecksum(frame.payload));
+            break;
+        // 서버가 알려준 offset부터 첨부파일 송신 시작
+        case FrameProtocol::FrameType::AttachmentResume:
+            if(AttachmentSender* attachmentSender = AttachmentSender::find(m_socket, frame.header.streamId))
+                attachmentSender->resume(FrameProtocol::decodeFileSize(frame.payload));
+            break;
+        case FrameProtocol::FrameType::Message:
         {
-            // 파일 전송 관련 메시지 박스에서 No를 선택
-            QString message = QString("INFO :: Attachment from sd:%1 discarded").arg(m_socket->socketDescriptor());
+            // 서버가 기록한 메시지는 sequence를 기억해 두었다가 다시 접속할 때 그 이후만 요청
+            m_lastSequence = qMax(m_lastSequence, frame.header.streamId);
+
+            // 전송된 메시지를 출력(보낸 쪽이 있으면 함께 표시)
+            QString source = frame.name.isEmpty() ? QString::number(m_socket->socketDescriptor()) : QString::fromUtf8(frame.name);
+            QString message = QString("%1 :: %2").arg(source).arg(QString::fromUtf8(frame.payload));
             emit signal_newMessage(message);
+            break;
+        }
+        // 서버의 Ping에는 payload를 그대로 Pong으로 응답
+        case FrameProtocol::FrameType::Ping:
+            OutboundQueue::of(m_socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Pong, frame.header.streamId, QByteArray(), frame.payload));
+            break;
+        case FrameProtocol::FrameType::Pong:
+            break;
+        // 서버의 지원 기능 : 이후 보내는 frame의 압축 여부 결정
+        // 서버가 메시지를 기록하면 이전 메시지 재생 요청(처음이면 마지막 HistoryReplayCount개, 이후에는 받은 다음부터 전부)
+        case FrameProtocol::FrameType::Hello:
+        {
+            const quint32 capabilities = FrameProtocol::decodeHello(frame.payload);
+            OutboundQueue::of(m_socket)->setPeerCapabilities(capabilities);
+            if(capabilities & FrameProtocol::CapHistory)
+            {
+                QByteArray request = m_lastSequence > 0 ? FrameProtocol::encodeHistoryRequest(m_lastSequence + 1, 0)
+                                                        : FrameProtocol::encodeHistoryRequest(0, HistoryReplayCount);
+                OutboundQueue::of(m_socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::HistoryRequest, 0, QByteArray(), request));
+            }
+            break;
+        }
+        // 들어가 있는 room의 메시지
+        case FrameProtocol::FrameType::Publish:
+        {
+            QByteArray sender;
+            QByteArray text;
+            if(!FrameProtocol::decodeRoomMessage(frame.payload, &sender, &text))
+                break;
+            QString source = sender.isEmpty() ? QString("server") : QString::fromUtf8(sender);
+            emit signal_newMessage(QString("[%1] %2 :: %3").arg(QString::fromUtf8(frame.name), source, QString::fromUtf8(text)));
+            break;
+        }
+        // 서버만 처리하는 frame
+        case FrameProtocol::FrameType::HistoryRequest:
+        case FrameProtocol::FrameType::Join:
+        case FrameProtocol::FrameType::Leave:
+            break;
         }
-    }
-    else if(fileType=="message")
-    {
-        // 전송된 메시지를 출력
-        QString message = QString("%1 :: %2").arg(m_socket->socketDescriptor()).arg(QString::fromStdString(buffer.toStdString()));
-        emit signal_newMessage(message);
     }
 }
 
@@ -159,47 +384,71 @@ void MainWindow::slot_readSocket()
 // 메시지 송신
 void MainWindow::on_pushButton_sendMessage_clicked()
 {
-    if(m_socket)
+    // ui에서 입력한 텍스트를 저장
+    QString str = ui->lineEdit_message->text();
+    bool connected = m_socket && m_socket->state() == QAbstractSocket::ConnectedState;
+
+    // room 명령 : "/join <room>"은 room에 들어가 이후 메시지를 그 room으로 보내고, "/leave"는 현재 room에서 나옴
+    // 서버가 room을 지원하는지 알아야 하므로 연결된 동안에만 사용
+    if(str.startsWith("/join ") || str == "/leave")
     {
-        // 소켓이 열려있다면
-        if(m_socket->isOpen())
+        if(!connected)
         {
-            // ui에서 입력한 텍스트를 저장
-            QString str = ui->lineEdit_message->text();
+            QMessageBox::critical(this,"QTCPClient","Not connected");
+            return;
+        }
 
-            // stream에 socket을 연결
-            QDataStream socketStream(m_socket);
-            socketStream.setVersion(QDataStream::Qt_5_15);
+        OutboundQueue* queue = OutboundQueue::of(m_socket);
+        if(!(queue->peerCapabilities() & FrameProtocol::CapRooms))
+        {
+            QMessageBox::critical(this,"QTCPClient","The server doesn't support rooms");
+            return;
+        }
 
-            // 헤더 부분에 fileType을 message로 설정
-            QByteArray header;
-            header.prepend(QString("fileType:message,fileName:null,fileSize:%1;").arg(str.size()).toUtf8());
-            // 128byte로 조정
-            header.resize(128);
+        if(!m_currentRoom.isEmpty())
+            queue->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Leave, 0, m_currentRoom.toUtf8(), QByteArray()));
 
-            // message 인코딩 설정하고, QByteArray에 할당
-            QByteArray byteArray = str.toUtf8();
-            // header 정보를 앞에 붙임
-            byteArray.prepend(header);
+        m_currentRoom = str == "/leave" ? QString() : str.mid(6).trimmed();
+        if(!m_currentRoom.isEmpty())
+            queue->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Join, 0, m_currentRoom.toUtf8(), QByteArray()));
 
-            // stream으로 byteArray 정보 전송
-            socketStream << byteArray;
+        ui->statusBar->showMessage(m_currentRoom.isEmpty() ? QString("Connected to Server") : QString("Room: %1").arg(m_currentRoom));
+        ui->lineEdit_message->clear();
+        return;
+    }
 
-            // 메시지 입력창 리셋
-            ui->lineEdit_message->clear();
-        }
-        else
-            QMessageBox::critical(this,"QTCPClient","Socket doesn't seem to be opened");
+    // 16byte binary header + 메시지(UTF-8)로 frame을 만들어 전송
+    // (첨부파일 chunk 사이에 끼워 넣을 수 있도록 송신 대기열을 거침)
+    // room에 들어가 있으면 room 구독자에게만 전달되도록 Publish로 보냄
+    QByteArray frame = m_currentRoom.isEmpty()
+            ? FrameProtocol::encodeFrame(FrameProtocol::FrameType::Message, 0, QByteArray(), str.toUtf8())
+            : FrameProtocol::encodeFrame(FrameProtocol::FrameType::Publish, 0, m_currentRoom.toUtf8(), FrameProtocol::encodeRoomMessage(QByteArray(), str.toUtf8()));
+
+    if(connected)
+    {
+        // 서버가 압축을 지원하면 긴 메시지는 압축하여 보냄
+        OutboundQueue* queue = OutboundQueue::of(m_socket);
+        queue->enqueue(queue->acceptsCompression() ? FrameProtocol::compressFrame(frame) : frame);
     }
     else
-        QMessageBox::critical(this,"QTCPClient","Not connected");
+    {
+        // 연결이 끊어진 동안에는 모아 두었다가 다시 접속하면 한 번에 보냄(오래된 것부터 버림)
+        if(m_pendingFrames.size() >= MaxPendingMessages)
+            m_pendingFrames.removeFirst();
+        m_pendingFrames.append(frame);
+        emit signal_newMessage(QString("INFO :: Not connected, message queued (%1 waiting)").arg(m_pendingFrames.size()));
+    }
+
+    // 메시지 입력창 리셋
+    ui->lineEdit_message->clear();
 }
 
 void MainWindow::on_pushButton_sendAttachment_clicked()
 {
     if(m_socket)
     {
-        if(m_socket->isOpen())
+        // 첨부파일은 모아 두지 않음(다시 접속한 뒤 보내면 이어받기로 못 받은 부분만 전송됨)
+        if(m_socket->state() == QAbstractSocket::ConnectedState)
         {
             // 파일 경로 가져오고, 경로 문제시 경고 출력
             QString filePath = QFileDialog::getOpenFileName(this, ("Select an attachment"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation), ("File (*.json *.txt *.png *.jpg *.jpeg)"));
@@ -209,36 +458,24 @@ void MainWindow::on_pushButton_sendAttachment_clicked()
                 return;
             }
 
-            // 전송 할 file 객체를 경로 지정해서 열고(송신, 읽기 전용, read)
-            QFile m_file(filePath);
-            if(m_file.open(QIODevice::ReadOnly))
+            // 파일을 고르는 동안 연결이 끊어졌을 수 있음
+            if(!m_socket || m_socket->state() != QAbstractSocket::ConnectedState)
             {
-                // 선택한 파일 이름
-                QFileInfo fileInfo(m_file.fileName());
-                QString fileName(fileInfo.fileName());
-
-                // stream으로 보내는데
-                QDataStream socketStream(m_socket);
-                socketStream.setVersion(QDataStream::Qt_5_15);
-
-                // 헤더 부분에 fileType을 attachment로 설정
-                QByteArray header;
-                header.prepend(QString("fileType:attachment,fileName:%1,fileSize:%2;").arg(fileName).arg(m_file.size()).toUtf8());
-                header.resize(128);
-
-                // QByteArray에 file을 byte로 할당
-                QByteArray byteArray = m_file.readAll();
-                // header 정보를 앞에 붙임
-                byteArray.prepend(header);
-
-                // stream으로 byteArray 정보 전송
-                socketStream << byteArray;
+                QMessageBox::critical(this,"QTCPClient","Disconnected while selecting the attachment");
+                return;
             }
-            else
+
+            // 파일 전체를 메모리에 올리지 않고 chunk 단위로 전송
+            // 전송이 끝나거나 소켓이 닫히면 sender는 스스로 삭제됨
+            AttachmentSender* attachmentSender = new AttachmentSender(m_socket, filePath, m_socket);
+            if(!attachmentSender->start())
+            {
+                delete attachmentSender;
                 QMessageBox::critical(this,"QTCPClient","Attachment is not readable!");
+            }
         }
         else
-            QMessageBox::critical(this,"QTCPClient","Socket doesn't seem to be opened");
+            QMessageBox::critical(this,"QTCPClient","Not connected yet, please try again in a moment");
     }
     else
         QMessageBox::critical(this,"QTCPClient","Not connected");
@@ -247,5 +484,6 @@ void MainWindow::on_pushButton_sendAttachment_clicked()
 // [ex.02.12]
 void MainWindow::slot_displayMessage(const QString& str)
 {
-    ui->textBrowser_receivedMessages->append(str);
+    // 화면에는 다음 flush 때 반영
+    m_log->append(str);
 }
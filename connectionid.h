@@ -0,0 +1,11 @@
+#ifndef CONNECTIONID_H
+#define CONNECTIONID_H
+
+#include <QtGlobal>
+
+// 서버가 연결마다 발급하는 식별자
+// socket descriptor는 연결이 끊기면 곧바로 재사용되므로 대신 사용하며, 프로세스 내에서 재사용되지 않음
+// 0은 유효하지 않은 연결(또는 broadcast 대상)을 뜻함
+typedef quint64 ConnectionId;
+
+#endif // CONNECTIONID_H
@@ -0,0 +1,65 @@
+#include "connectionlistmodel.h"
+
+#include <algorithm>
+
+ConnectionListModel::ConnectionListModel(QObject* parent) : QAbstractListModel(parent)
+{
+}
+
+int ConnectionListModel::rowCount(const QModelIndex& parent) const
+{
+    if(parent.isValid())
+        return 0;
+
+    // Broadcast 행 포함
+    return m_connectionIds.size() + 1;
+}
+
+QVariant ConnectionListModel::data(const QModelIndex& index, int role) const
+{
+    if(!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    const ConnectionId connectionId = this->connectionId(index.row());
+    switch(role)
+    {
+    case Qt::DisplayRole:
+        return connectionId == 0 ? QString("Broadcast") : QString::number(connectionId);
+    case ConnectionIdRole:
+        return connectionId;
+    default:
+        return QVariant();
+    }
+}
+
+void ConnectionListModel::addConnection(ConnectionId connectionId)
+{
+    // worker thread마다 signal 도착 순서가 다를 수 있으므로 정렬 위치에 삽입
+    auto it = std::lower_bound(m_connectionIds.begin(), m_connectionIds.end(), connectionId);
+    if(it != m_connectionIds.end() && *it == connectionId)
+        return;
+
+    const int position = static_cast<int>(it - m_connectionIds.begin());
+    beginInsertRows(QModelIndex(), position + 1, position + 1);
+    m_connectionIds.insert(position, connectionId);
+    endInsertRows();
+}
+
+void ConnectionListModel::removeConnection(ConnectionId connectionId)
+{
+    auto it = std::lower_bound(m_connectionIds.begin(), m_connectionIds.end(), connectionId);
+    if(it == m_connectionIds.end() || *it != connectionId)
+        return;
+
+    const int position = static_cast<int>(it - m_connectionIds.begin());
+    beginRemoveRows(QModelIndex(), position + 1, position + 1);
+    m_connectionIds.remove(position);
+    endRemoveRows();
+}
+
+ConnectionId ConnectionListModel::connectionId(int row) const
+{
+    if(row <= 0 || row > m_connectionIds.size())
+        return 0;
+    return m_connectionIds.at(row - 1);
+}
@@ -0,0 +1,37 @@
+#ifndef CONNECTIONLISTMODEL_H
+#define CONNECTIONLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "connectionid.h"
+
+// 수신 대상 선택 목록(QComboBox 등)에 쓰는 model
+// 첫 행은 Broadcast(ConnectionId 0), 이후 행은 연결 ID 오름차순
+// 연결/종료마다 해당 행만 추가/삭제하므로 목록 전체를 다시 만들지 않음
+class ConnectionListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles
+    {
+        ConnectionIdRole = Qt::UserRole + 1
+    };
+
+    explicit ConnectionListModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void addConnection(ConnectionId connectionId);
+    void removeConnection(ConnectionId connectionId);
+
+    // 행에 해당하는 연결 ID(Broadcast 행이나 잘못된 행이면 0)
+    ConnectionId connectionId(int row) const;
+
+private:
+    // 연결 ID는 증가하며 발급되므로 정렬된 배열에 대부분 끝에 추가되고, 이진 탐색으로 찾음
+    QVector<ConnectionId> m_connectionIds;
+};
+
+#endif // CONNECTIONLISTMODEL_H
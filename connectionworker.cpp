@@ -0,0 +1,790 @@
+#include "connectionworker.h"
+#include "attachmentreceiver.h"
+#include "attachmentsender.h"
+#include "frameprotocol.h"
+#include "historyreplayer.h"
+#include "messagehistory.h"
+#include "outboundqueue.h"
+#include "roomdirectory.h"
+#include "servermetrics.h"
+#include "streamsocket.h"
+
+#include <QFileInfo>
+
+#include <limits>
+
+// 프로세스 전체 생존 확인 결과
+static QAtomicInteger<quint64> s_pingsSent;
+static QAtomicInteger<quint64> s_reaped;
+// 프로세스 전체 수신 조절 결과
+static QAtomicInteger<quint64> s_throttled;
+static QAtomicInteger<quint64> s_deferredReads;
+
+ConnectionWorker::ConnectionWorker(RoomDirectory* rooms, QObject* parent) : QObject(parent), m_rooms(rooms)
+{
+    // 자식으로 만들어 worker와 함께 worker thread로 옮겨지게 함(첫 연결이 들어올 때 시작)
+    m_heartbeatTimer = new QTimer(this);
+    m_heartbeatTimer->setTimerType(Qt::CoarseTimer);
+    connect(m_heartbeatTimer, &QTimer::timeout, this, &ConnectionWorker::slot_heartbeatTick);
+
+    // 수신 한도를 넘은 연결 중 가장 먼저 token이 차는 시각에 실행
+    m_throttleTimer = new QTimer(this);
+    m_throttleTimer->setSingleShot(true);
+    m_throttleTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_throttleTimer, &QTimer::timeout, this, &ConnectionWorker::slot_resumeThrottled);
+
+    m_clock.start();
+}
+
+ConnectionWorker::HeartbeatStatistics ConnectionWorker::heartbeatStatistics()
+{
+    HeartbeatStatistics statistics;
+    statistics.pingsSent = s_pingsSent.loadRelaxed();
+    statistics.reaped = s_reaped.loadRelaxed();
+    return statistics;
+}
+
+ConnectionWorker::InboundStatistics ConnectionWorker::inboundStatistics()
+{
+    InboundStatistics statistics;
+    statistics.throttled = s_throttled.loadRelaxed();
+    statistics.deferredReads = s_deferredReads.loadRelaxed();
+    return statistics;
+}
+
+// ChatTcpServer가 넘겨준 descriptor로 이 thread 소속의 소켓 생성
+void ConnectionWorker::slot_addConnection(ConnectionId connectionId, qintptr socketDescriptor)
+{
+    QTcpSocket* socket = new QTcpSocket(this);
+    if(!socket->setSocketDescriptor(socketDescriptor))
+    {
+        rejectConnection(connectionId, socket);
+        return;
+    }
+    adoptConnection(connectionId, socket);
+}
+
+// local 소켓(AF_UNIX)도 같은 방식으로 생성하고, 이후 처리는 TCP 연결과 같음
+void ConnectionWorker::slot_addLocalConnection(ConnectionId connectionId, qintptr socketDescriptor)
+{
+    QLocalSocket* socket = new QLocalSocket(this);
+    if(!socket->setSocketDescriptor(socketDescriptor))
+    {
+        rejectConnection(connectionId, socket);
+        return;
+    }
+    adoptConnection(connectionId, socket);
+}
+
+void ConnectionWorker::rejectConnection(ConnectionId connectionId, QIODevice* socket)
+{
+    emit signal_error(QString("Unable to adopt the connection: %1.").arg(socket->errorString()));
+    m_connectionCount.deref();
+    delete socket;
+    // 서버의 연결 목록에서도 제거되도록 알림
+    emit signal_clientDisconnected(connectionId);
+}
+
+void ConnectionWorker::adoptConnection(ConnectionId connectionId, QIODevice* socket)
+{
+    m_sockets.insert(connectionId, socket);
+    m_connectionIds.insert(socket, connectionId);
+    configureInbound(m_inbound[connectionId]);
+
+    // 소켓에 읽을 메시지가 수신 시에 slot_readSocket 실행
+    // 첨부파일 기록이 밀려 읽기를 멈춘 동안 Qt가 소켓 데이터를 끝없이 쌓아두지 않도록 버퍼 크기를 frame 하나로 제한
+    StreamSocket::setReadBufferSize(socket, FrameProtocol::MaxFrameSize);
+    connect(socket, &QIODevice::readyRead, this, &ConnectionWorker::slot_readSocket);
+
+    // 소켓 연결이 끊기면 slot_discardSocket 실행
+    StreamSocket::connectDisconnected(socket, this, &ConnectionWorker::slot_discardSocket);
+
+    // 연결된 소켓에 오류가 발생하면 slot_displayError 실행
+    StreamSocket::connectErrorOccurred(socket, this, &ConnectionWorker::slot_displayError);
+
+    // 송신할 frame을 복사 없이 보관하는 대기열을 소켓의 자식으로 생성
+    // 가장 먼저 Hello로 지원 기능을 알림(상대의 Hello를 받기 전까지는 압축하지 않음)
+    OutboundQueue* queue = new OutboundQueue(socket, m_queueLimits);
+    queue->setMetrics(ServerMetrics::addConnection(connectionId));
+    const quint32 capabilities = FrameProtocol::localCapabilities() | FrameProtocol::CapRooms | (m_history ? FrameProtocol::CapHistory : 0);
+    queue->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Hello, 0, QByteArray(), FrameProtocol::encodeHello(capabilities)));
+
+    // 첨부파일 chunk를 디스크에 기록할 수신기를 소켓의 자식으로 생성
+    AttachmentReceiver* receiver = new AttachmentReceiver(socket);
+    connect(receiver, &AttachmentReceiver::signal_stored, this, [this, connectionId](quint32, const QString& filePath) {
+        emit signal_newMessage(QString("INFO :: Attachment from id:%1 successfully stored on disk under the path %2").arg(connectionId).arg(filePath));
+    });
+    connect(receiver, &AttachmentReceiver::signal_failed, this, [this](quint32, const QString& reason) {
+        emit signal_error(QString("An error occurred while trying to write the attachment: %1.").arg(reason));
+    });
+    // 디스크 기록이 따라잡으면 멈췄던 읽기 재개
+    connect(receiver, &AttachmentReceiver::signal_drained, this, [this, socket]() {
+        readFrames(socket);
+    });
+
+    // 생존 확인은 접속한 시각부터 셈
+    m_liveness[connectionId].lastActivity = m_idleTimers.now();
+    scheduleLivenessCheck(connectionId);
+    if(!m_heartbeatTimer->isActive() && (m_heartbeat.pingInterval > 0 || m_heartbeat.idleTimeout > 0))
+        m_heartbeatTimer->start(HeartbeatTickInterval);
+
+    emit signal_clientConnected(connectionId);
+}
+
+
+// 연결된 소켓에서 연결이 끊어지면 동작
+void ConnectionWorker::slot_discardSocket()
+{
+    QIODevice* socket = qobject_cast<QIODevice*>(sender());
+
+    auto it = m_connectionIds.find(socket);
+    if(it != m_connectionIds.end())
+    {
+        ConnectionId connectionId = it.value();
+        leaveAllRooms(socket);
+        m_idleTimers.cancel(connectionId);
+        m_liveness.remove(connectionId);
+        // 읽기 대기열에 남은 ID는 slot_serviceReadQueue에서 건너뜀
+        m_inbound.remove(connectionId);
+        m_throttled.remove(connectionId);
+        ServerMetrics::removeConnection(connectionId);
+        m_connectionIds.erase(it);
+        m_sockets.remove(connectionId);
+        m_connectionCount.deref();
+
+        emit signal_clientDisconnected(connectionId);
+    }
+
+    socket->deleteLater();
+}
+
+
+// 연결된 소켓에서 오류 종류에 따른 오류 관련 상태 전달
+void ConnectionWorker::slot_displayError()
+{
+    // 연결 종료는 slot_discardSocket에서 처리
+    QIODevice* socket = qobject_cast<QIODevice*>(sender());
+    if(StreamSocket::isPeerClosedError(socket))
+        return;
+
+    emit signal_error(QString("The following error occurred: %1.").arg(socket->errorString()));
+}
+
+
+// IPv4-mapped IPv6 주소(dual-stack listen)는 IPv4 주소로 바꾸어 subnet 규칙과 비교할 수 있게 함
+static QHostAddress peerAddressOf(QIODevice* socket)
+{
+    QHostAddress address = StreamSocket::peerAddress(socket);
+    bool isIPv4 = false;
+    const quint32 ipv4 = address.toIPv4Address(&isIPv4);
+    return isIPv4 ? QHostAddress(ipv4) : address;
+}
+
+
+// 첨부파일 또는 메시지 수신 처리
+void ConnectionWorker::slot_readSocket()
+{
+    QIODevice* socket = qobject_cast<QIODevice*>(sender());
+
+    // 무엇이든 받았으면 살아있는 연결(wheel은 만료될 때 마지막 수신 tick을 보고 다시 등록)
+    auto liveness = m_liveness.find(m_connectionIds.value(socket, 0));
+    if(liveness != m_liveness.end())
+    {
+        liveness->lastActivity = m_idleTimers.now();
+        liveness->pinged = false;
+    }
+
+    // 차례를 기다리는 연결은 새로 도착한 데이터도 그 차례에 함께 처리
+    auto inbound = m_inbound.constFind(m_connectionIds.value(socket, 0));
+    if(inbound != m_inbound.constEnd() && inbound->queued)
+        return;
+
+    readFrames(socket);
+}
+
+void ConnectionWorker::readFrames(QIODevice* socket)
+{
+    ConnectionId connectionId = m_connectionIds.value(socket, 0);
+
+    // 소켓마다 생성해 둔 첨부파일 수신기
+    AttachmentReceiver* receiver = socket->findChild<AttachmentReceiver*>(QString(), Qt::FindDirectChildrenOnly);
+
+    // 수신 counter(꺼져 있으면 시간도 재지 않음)
+    ServerMetrics::Connection* metrics = ServerMetrics::isEnabled() ? OutboundQueue::of(socket)->metrics().data() : nullptr;
+    QElapsedTimer decodeTimer;
+
+    // 도착한 frame을 차례 한도까지 처리
+    FrameProtocol::Frame frame;
+    int framesThisTurn = 0;
+    qint64 bytesThisTurn = 0;
+    while(true)
+    {
+        // 첨부파일 기록이 밀려 있으면 더 읽지 않음(TCP 흐름 제어로 송신 측이 느려지고, signal_drained에서 재개)
+        if(receiver->isBackedUp())
+            return;
+
+        // 수신 한도를 넘었으면 token이 찰 때까지 읽지 않음(slot_resumeThrottled에서 재개)
+        if(throttle(connectionId, socket))
+            return;
+
+        // 이번 차례를 다 썼으면 남은 frame은 밀려 있는 다른 연결들을 처리한 뒤에 이어서 처리
+        if(framesThisTurn >= MaxFramesPerTurn || bytesThisTurn >= MaxBytesPerTurn)
+        {
+            if(socket->bytesAvailable() > 0)
+            {
+                s_deferredReads.ref();
+                deferRead(connectionId);
+            }
+            return;
+        }
+
+        const qint64 available = socket->bytesAvailable();
+        if(metrics)
+            decodeTimer.start();
+
+        FrameProtocol::DecodeResult result = FrameProtocol::readFrame(socket, &frame);
+
+        // 데이터를 다 받지 못하면 return하여 다음 readyRead에서 재실행
+        // 부하 중에는 매우 자주 일어나므로 로그 대신 PartialReads counter로만 기록
+        if(result == FrameProtocol::DecodeResult::NeedMoreData)
+        {
+            if(metrics && socket->bytesAvailable() > 0)
+                metrics->add(ServerMetrics::PartialReads);
+            return;
+        }
+
+        if(result == FrameProtocol::DecodeResult::Ok)
+        {
+            const qint64 consumed = available - socket->bytesAvailable();
+            ++framesThisTurn;
+            bytesThisTurn += consumed;
+
+            // 처리 중에 연결이 끊겨 정리되었을 수 있으므로 매번 다시 찾음
+            auto inbound = m_inbound.find(connectionId);
+            if(inbound != m_inbound.end())
+            {
+                inbound->frames.consume(1);
+                inbound->bytes.consume(consumed);
+            }
+
+            if(metrics)
+            {
+                ServerMetrics::record(ServerMetrics::DecodeNsecs, static_cast<quint64>(decodeTimer.nsecsElapsed()));
+                metrics->add(ServerMetrics::FramesIn);
+                metrics->add(ServerMetrics::BytesIn, static_cast<quint64>(consumed));
+            }
+        }
+
+        // 형식이 맞지 않는 frame을 보낸 클라이언트는 연결 종료
+        if(result == FrameProtocol::DecodeResult::Invalid)
+        {
+            emit signal_newMessage(QString("INFO :: Invalid frame from id:%1, closing connection").arg(connectionId));
+            StreamSocket::abort(socket);
+            return;
+        }
+
+        switch(frame.header.type)
+        {
+        // 첨부파일 전송 시작
+        // 수신 여부는 정책이나 GUI에서 결정하고, 그동안 도착하는 chunk는 임시 파일에 기록
+        case FrameProtocol::FrameType::AttachmentStart:
+        {
+            QString fileName = QFileInfo(QString::fromUtf8(frame.name)).fileName();
+            qint64 fileSize = FrameProtocol::decodeFileSize(frame.payload);
+            QByteArray resumeKey = FrameProtocol::decodeResumeKey(frame.payload);
+            QByteArray contentHash = FrameProtocol::decodeContentHash(frame.payload);
+
+            qint64 received = receiver->begin(frame.header.streamId, fileName, fileSize, resumeKey, contentHash);
+            // 받을 수 없으면(이유는 signal_failed로 알림) 이미 다 받은 것으로 알려
+            // 송신 측이 본문 없이 end frame만 보내게 함(end frame은 무시됨)
+            if(received < 0)
+            {
+                OutboundQueue::of(socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentResume, frame.header.streamId, QByteArray(), FrameProtocol::encodeFileSize(qMax<qint64>(0, fileSize))));
+                break;
+            }
+
+            // 이어받기 가능한 전송이면 이미 받은 바이트 수를 알려 송신 측이 그 위치부터 보내도록 함
+            if(!resumeKey.isEmpty())
+            {
+                OutboundQueue::of(socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentResume, frame.header.streamId, QByteArray(), FrameProtocol::encodeFileSize(received)));
+                if(received > 0 && received == fileSize)
+                    emit signal_newMessage(QString("INFO :: Attachment %1 from id:%2 is already available, skipping %3 bytes").arg(fileName).arg(connectionId).arg(fileSize));
+                else if(received > 0)
+                    emit signal_newMessage(QString("INFO :: Resuming attachment %1 from id:%2 at %3 of %4 bytes").arg(fileName).arg(connectionId).arg(received).arg(fileSize));
+            }
+
+            emit signal_attachmentOffered(connectionId, frame.header.streamId, fileName, fileSize, peerAddressOf(socket));
+            break;
+        }
+        // 첨부파일 데이터 chunk
+        case FrameProtocol::FrameType::AttachmentChunk:
+            receiver->write(frame.header.streamId, frame.payload);
+            break;
+        // 첨부파일 전송 완료
+        case FrameProtocol::FrameType::AttachmentEnd:
+            receiver->finish(frame.header.streamId, FrameProtocol::decodeFileChecksum(frame.payload));
+            break;
+        // 수신 측이 알려준 offset부터 첨부파일 송신 시작
+        case FrameProtocol::FrameType::AttachmentResume:
+            if(AttachmentSender* attachmentSender = AttachmentSender::find(socket, frame.header.streamId))
+                attachmentSender->resume(FrameProtocol::decodeFileSize(frame.payload));
+            break;
+        case FrameProtocol::FrameType::Message:
+            // 이후 접속하는 클라이언트가 받아볼 수 있도록 기록
+            if(m_history)
+                m_history->append(QString("id:%1").arg(connectionId).toUtf8(), frame.payload);
+            emit signal_newMessage(QString("%1 :: %2").arg(connectionId).arg(QString::fromUtf8(frame.payload)));
+            break;
+        // Ping은 payload를 그대로 Pong으로 돌려줌
+        // 앞서 받은 frame을 모두 처리한 뒤 같은 대기열로 나가므로 왕복 지연 측정에 사용
+        case FrameProtocol::FrameType::Ping:
+            OutboundQueue::of(socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Pong, frame.header.streamId, QByteArray(), frame.payload));
+            break;
+        case FrameProtocol::FrameType::Pong:
+            break;
+        // 클라이언트의 지원 기능 : 이후 이 소켓으로 보내는 frame의 압축 여부 결정
+        case FrameProtocol::FrameType::Hello:
+            OutboundQueue::of(socket)->setPeerCapabilities(FrameProtocol::decodeHello(frame.payload));
+            break;
+        // 기록된 메시지 재생 요청(HistoryReplayer는 재생이 끝나면 스스로 삭제됨)
+        // 이미 재생 중이면 요청을 반복해도 읽기와 대기열이 늘어나지 않도록 무시
+        case FrameProtocol::FrameType::HistoryRequest:
+        {
+            quint32 sinceSequence = 0;
+            quint32 limit = 0;
+            if(m_history && !HistoryReplayer::find(socket) && FrameProtocol::decodeHistoryRequest(frame.payload, &sinceSequence, &limit))
+                (new HistoryReplayer(socket, m_history, sinceSequence, limit))->start();
+            break;
+        }
+        case FrameProtocol::FrameType::Join:
+            joinRoom(socket, frame.name);
+            break;
+        case FrameProtocol::FrameType::Leave:
+            leaveRoom(socket, frame.name);
+            break;
+        // room 구독자에게 전달(보낸 쪽은 연결 ID로 채움, 구독하지 않은 room에도 보낼 수 있음)
+        case FrameProtocol::FrameType::Publish:
+        {
+            QByteArray sender;
+            QByteArray text;
+            if(frame.name.isEmpty() || frame.name.size() > FrameProtocol::MaxRoomNameLength || !FrameProtocol::decodeRoomMessage(frame.payload, &sender, &text))
+                break;
+
+            const QByteArray payload = FrameProtocol::encodeRoomMessage(QString("id:%1").arg(connectionId).toUtf8(), text);
+            m_rooms->publish(frame.name, FrameProtocol::encodeFrame(FrameProtocol::FrameType::Publish, 0, frame.name, payload), OutboundQueue::Delivery::Droppable);
+            break;
+        }
+        }
+    }
+}
+
+
+// 인코딩이 끝난 frame을 해당 소켓으로 전송
+void ConnectionWorker::slot_sendFrame(ConnectionId connectionId, const QByteArray& frame)
+{
+    QIODevice* socket = m_sockets.value(connectionId);
+    if(!socket || !socket->isOpen())
+        return;
+
+    OutboundQueue* queue = OutboundQueue::of(socket);
+    queue->enqueue(queue->acceptsCompression() ? FrameProtocol::compressFrame(frame) : frame);
+}
+
+
+// 한 번 인코딩된 frame을 이 worker가 담당하는 모든 소켓의 대기열에 넣음
+// frame은 암시적 공유이므로 소켓 수와 관계없이 데이터는 한 벌만 존재
+// 압축도 ChatTcpServer::broadcastFrame에서 한 번만 하고, 소켓마다 상대의 지원 여부에 따라 고름
+void ConnectionWorker::slot_broadcastFrame(const QByteArray& frame, const QByteArray& compressedFrame, OutboundQueue::Delivery delivery, const QSharedPointer<BroadcastBudget>& budget)
+{
+    QElapsedTimer fanOutTimer;
+    if(ServerMetrics::isEnabled())
+        fanOutTimer.start();
+
+    foreach (QIODevice* socket, m_sockets)
+    {
+        if(!socket->isOpen())
+            continue;
+
+        OutboundQueue* queue = OutboundQueue::of(socket);
+        const QByteArray& selected = queue->acceptsCompression() ? compressedFrame : frame;
+        if(budget)
+            budget->acquire(selected.size());
+        queue->enqueue(selected, delivery, budget);
+    }
+
+    // ChatTcpServer::broadcastFrame에서 전달 중인 몫으로 잡아둔 budget 반환
+    if(budget)
+        budget->release(frame.size());
+
+    if(fanOutTimer.isValid())
+        ServerMetrics::record(ServerMetrics::FanOutNsecs, static_cast<quint64>(fanOutTimer.nsecsElapsed()));
+}
+
+
+// RoomDirectory가 이 worker에 구독자가 있는 room에만 전달하므로 room 구독자 수만큼만 대기열에 넣음
+void ConnectionWorker::slot_publishFrame(const QByteArray& room, const QByteArray& frame, const QByteArray& compressedFrame, OutboundQueue::Delivery delivery)
+{
+    auto it = m_roomMembers.constFind(room);
+    if(it == m_roomMembers.constEnd())
+        return;
+
+    QElapsedTimer fanOutTimer;
+    if(ServerMetrics::isEnabled())
+        fanOutTimer.start();
+
+    foreach (QIODevice* socket, it.value())
+    {
+        if(!socket->isOpen())
+            continue;
+
+        OutboundQueue* queue = OutboundQueue::of(socket);
+        queue->enqueue(queue->acceptsCompression() ? compressedFrame : frame, delivery);
+    }
+
+    if(fanOutTimer.isValid())
+        ServerMetrics::record(ServerMetrics::FanOutNsecs, static_cast<quint64>(fanOutTimer.nsecsElapsed()));
+}
+
+
+void ConnectionWorker::joinRoom(QIODevice* socket, const QByteArray& room)
+{
+    if(room.isEmpty() || room.size() > FrameProtocol::MaxRoomNameLength)
+        return;
+
+    QSet<QByteArray>& rooms = m_memberships[socket];
+    if(rooms.contains(room) || rooms.size() >= MaxRoomsPerConnection)
+        return;
+
+    rooms.insert(room);
+    m_roomMembers[room].insert(socket);
+    m_rooms->join(room, this);
+    emit signal_newMessage(QString("INFO :: Client id:%1 joined room %2").arg(m_connectionIds.value(socket)).arg(QString::fromUtf8(room)));
+}
+
+void ConnectionWorker::leaveRoom(QIODevice* socket, const QByteArray& room)
+{
+    auto membership = m_memberships.find(socket);
+    if(membership == m_memberships.end() || !membership->remove(room))
+        return;
+    if(membership->isEmpty())
+        m_memberships.erase(membership);
+
+    auto members = m_roomMembers.find(room);
+    members->remove(socket);
+    if(members->isEmpty())
+        m_roomMembers.erase(members);
+
+    m_rooms->leave(room, this);
+    emit signal_newMessage(QString("INFO :: Client id:%1 left room %2").arg(m_connectionIds.value(socket)).arg(QString::fromUtf8(room)));
+}
+
+// 연결이 끊어진 소켓은 알림 없이 모든 room에서 제거
+void ConnectionWorker::leaveAllRooms(QIODevice* socket)
+{
+    const QSet<QByteArray> rooms = m_memberships.take(socket);
+    foreach (const QByteArray& room, rooms)
+    {
+        auto members = m_roomMembers.find(room);
+        members->remove(socket);
+        if(members->isEmpty())
+            m_roomMembers.erase(members);
+        m_rooms->leave(room, this);
+    }
+}
+
+
+// 첨부파일을 chunk 단위로 전송(AttachmentSender는 전송이 끝나면 스스로 삭제됨)
+void ConnectionWorker::slot_sendAttachment(ConnectionId connectionId, const QString& filePath)
+{
+    QIODevice* socket = m_sockets.value(connectionId);
+    if(!socket || !socket->isOpen())
+        return;
+
+    AttachmentSender* attachmentSender = new AttachmentSender(socket, filePath, socket);
+    if(!attachmentSender->start())
+    {
+        delete attachmentSender;
+        emit signal_error("Couldn't open the attachment!");
+    }
+}
+
+
+void ConnectionWorker::slot_acceptAttachment(ConnectionId connectionId, quint32 transferId, const QString& filePath)
+{
+    QIODevice* socket = m_sockets.value(connectionId);
+    if(!socket)
+        return;
+
+    AttachmentReceiver* receiver = socket->findChild<AttachmentReceiver*>(QString(), Qt::FindDirectChildrenOnly);
+    receiver->accept(transferId, filePath);
+}
+
+
+void ConnectionWorker::slot_rejectAttachment(ConnectionId connectionId, quint32 transferId)
+{
+    QIODevice* socket = m_sockets.value(connectionId);
+    if(!socket)
+        return;
+
+    // 거절하면 송신 측이 남은 본문을 보내지 않도록 끝 offset을 알림
+    AttachmentReceiver* receiver = socket->findChild<AttachmentReceiver*>(QString(), Qt::FindDirectChildrenOnly);
+    const qint64 skipTo = receiver->reject(transferId);
+    if(skipTo >= 0)
+        OutboundQueue::of(socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::AttachmentResume, transferId, QByteArray(), FrameProtocol::encodeFileSize(skipTo)));
+}
+
+
+void ConnectionWorker::slot_setQueueLimits(const OutboundQueue::Limits& limits)
+{
+    m_queueLimits = limits;
+    foreach (QIODevice* socket, m_sockets)
+        OutboundQueue::of(socket)->setLimits(limits);
+}
+
+
+void ConnectionWorker::slot_setHistory(const QSharedPointer<MessageHistory>& history)
+{
+    m_history = history;
+}
+
+
+void ConnectionWorker::slot_setHeartbeat(const Heartbeat& heartbeat)
+{
+    m_heartbeat = heartbeat;
+
+    // 바뀐 주기로 모든 연결을 다시 등록
+    foreach (ConnectionId connectionId, m_sockets.keys())
+        scheduleLivenessCheck(connectionId);
+
+    if(m_heartbeat.pingInterval <= 0 && m_heartbeat.idleTimeout <= 0)
+        m_heartbeatTimer->stop();
+    else if(!m_heartbeatTimer->isActive() && !m_sockets.isEmpty())
+        m_heartbeatTimer->start(HeartbeatTickInterval);
+}
+
+
+void ConnectionWorker::slot_setRateLimit(const RateLimit& rateLimit)
+{
+    m_rateLimit = rateLimit;
+    for(auto it = m_inbound.begin(); it != m_inbound.end(); ++it)
+        configureInbound(it.value());
+
+    // 한도가 풀리거나 늘어난 연결은 바로 재개
+    slot_resumeThrottled();
+}
+
+
+void ConnectionWorker::configureInbound(Inbound& inbound)
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    const double burstSeconds = qMax(m_rateLimit.burstSeconds, 0.0);
+    inbound.frames.configure(m_rateLimit.framesPerSecond, m_rateLimit.framesPerSecond * burstSeconds, now);
+    inbound.bytes.configure(m_rateLimit.bytesPerSecond, m_rateLimit.bytesPerSecond * burstSeconds, now);
+}
+
+
+bool ConnectionWorker::throttle(ConnectionId connectionId, QIODevice* socket)
+{
+    auto inbound = m_inbound.find(connectionId);
+    if(inbound == m_inbound.end())
+        return false;
+    if(!inbound->frames.isLimited() && !inbound->bytes.isLimited())
+        return false;
+
+    const qint64 now = m_clock.nsecsElapsed();
+    inbound->frames.refill(now);
+    inbound->bytes.refill(now);
+    if(inbound->frames.isAvailable() && inbound->bytes.isAvailable())
+        return false;
+
+    // 읽기 버퍼를 최소로 줄여 Qt가 커널 버퍼에서 더 가져오지 않게 함
+    // 커널 수신 버퍼가 차면 TCP window가 닫혀 송신 측이 보내기를 멈추므로 서버 메모리는 늘지 않음
+    if(!m_throttled.contains(connectionId))
+    {
+        m_throttled.insert(connectionId);
+        s_throttled.ref();
+        StreamSocket::setReadBufferSize(socket, ThrottledReadBufferSize);
+    }
+    scheduleResume(qMax(inbound->frames.nsecsUntilAvailable(), inbound->bytes.nsecsUntilAvailable()));
+    return true;
+}
+
+
+void ConnectionWorker::scheduleResume(qint64 nsecs)
+{
+    const int msecs = static_cast<int>(qMin<qint64>((nsecs + 999999) / 1000000, std::numeric_limits<int>::max()));
+    if(!m_throttleTimer->isActive() || m_throttleTimer->remainingTime() > msecs)
+        m_throttleTimer->start(msecs);
+}
+
+
+void ConnectionWorker::slot_resumeThrottled()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    qint64 nextWait = -1;
+
+    for(auto it = m_throttled.begin(); it != m_throttled.end();)
+    {
+        const ConnectionId connectionId = *it;
+        QIODevice* socket = m_sockets.value(connectionId);
+        auto inbound = m_inbound.find(connectionId);
+        if(!socket || inbound == m_inbound.end())
+        {
+            it = m_throttled.erase(it);
+            continue;
+        }
+
+        inbound->frames.refill(now);
+        inbound->bytes.refill(now);
+        const qint64 wait = qMax(inbound->frames.nsecsUntilAvailable(), inbound->bytes.nsecsUntilAvailable());
+        if(wait > 0)
+        {
+            nextWait = nextWait < 0 ? wait : qMin(nextWait, wait);
+            ++it;
+            continue;
+        }
+
+        // 버퍼를 되돌리면 Qt가 다시 커널 버퍼에서 읽고, 이미 받아둔 frame은 차례에 맞춰 처리
+        it = m_throttled.erase(it);
+        StreamSocket::setReadBufferSize(socket, FrameProtocol::MaxFrameSize);
+        deferRead(connectionId);
+    }
+
+    if(nextWait >= 0)
+        scheduleResume(nextWait);
+}
+
+
+void ConnectionWorker::deferRead(ConnectionId connectionId)
+{
+    auto inbound = m_inbound.find(connectionId);
+    if(inbound == m_inbound.end() || inbound->queued)
+        return;
+
+    inbound->queued = true;
+    m_readQueue.enqueue(connectionId);
+    if(!m_readQueueScheduled)
+    {
+        // 지금 쌓인 다른 event(다른 연결의 readyRead 등)를 먼저 처리한 뒤 실행
+        m_readQueueScheduled = true;
+        QTimer::singleShot(0, this, &ConnectionWorker::slot_serviceReadQueue);
+    }
+}
+
+
+void ConnectionWorker::slot_serviceReadQueue()
+{
+    m_readQueueScheduled = false;
+
+    // 지금 대기열에 있는 연결만 한 차례씩 처리하고, 그동안 다시 밀린 연결은 다음 실행에서 처리
+    const int pending = m_readQueue.size();
+    for(int i = 0; i < pending && !m_readQueue.isEmpty(); ++i)
+    {
+        const ConnectionId connectionId = m_readQueue.dequeue();
+        auto inbound = m_inbound.find(connectionId);
+        QIODevice* socket = m_sockets.value(connectionId);
+        if(inbound == m_inbound.end() || !socket)
+            continue;
+
+        inbound->queued = false;
+        readFrames(socket);
+    }
+}
+
+
+void ConnectionWorker::slot_heartbeatTick()
+{
+    // tick마다 만료된 연결만 확인하므로 연결 수와 관계없이 비용이 일정
+    const QVector<ConnectionId> expired = m_idleTimers.advance();
+    foreach (ConnectionId connectionId, expired)
+        checkLiveness(connectionId);
+}
+
+
+void ConnectionWorker::scheduleLivenessCheck(ConnectionId connectionId)
+{
+    auto liveness = m_liveness.constFind(connectionId);
+    if(liveness == m_liveness.constEnd())
+        return;
+
+    // Ping을 보낼(이미 보냈으면 다시 확인할) 시각과 연결을 끊을 시각 중 먼저 오는 시각
+    // 수신할 때는 wheel을 건드리지 않으므로 생존 확인을 하는 동안에는 항상 등록되어 있어야 함
+    quint64 deadline = 0;
+    if(m_heartbeat.pingInterval > 0)
+        deadline = (liveness->pinged ? m_idleTimers.now() : liveness->lastActivity) + static_cast<quint64>(m_heartbeat.pingInterval);
+    if(m_heartbeat.idleTimeout > 0)
+    {
+        const quint64 idleDeadline = liveness->lastActivity + static_cast<quint64>(m_heartbeat.idleTimeout);
+        deadline = deadline == 0 ? idleDeadline : qMin(deadline, idleDeadline);
+    }
+
+    if(deadline == 0)
+        m_idleTimers.cancel(connectionId);
+    else
+        m_idleTimers.schedule(connectionId, deadline > m_idleTimers.now() ? deadline - m_idleTimers.now() : 1);
+}
+
+
+void ConnectionWorker::checkLiveness(ConnectionId connectionId)
+{
+    QIODevice* socket = m_sockets.value(connectionId);
+    auto liveness = m_liveness.find(connectionId);
+    if(!socket || liveness == m_liveness.end())
+        return;
+
+    // 첨부파일 기록이 밀리거나 수신 한도를 넘어 읽기를 멈춘 연결은 받을 데이터가 남아 있으므로 살아있는 것으로 봄
+    AttachmentReceiver* receiver = socket->findChild<AttachmentReceiver*>(QString(), Qt::FindDirectChildrenOnly);
+    if((receiver && receiver->isBackedUp()) || m_throttled.contains(connectionId))
+    {
+        liveness->lastActivity = m_idleTimers.now();
+        liveness->pinged = false;
+    }
+
+    const quint64 idle = m_idleTimers.now() - liveness->lastActivity;
+    if(m_heartbeat.idleTimeout > 0 && idle >= static_cast<quint64>(m_heartbeat.idleTimeout))
+    {
+        // disconnected가 오지 않는 연결일 수 있으므로 abort로 바로 정리(slot_discardSocket에서 목록 제거)
+        s_reaped.ref();
+        emit signal_newMessage(QString("INFO :: No data from id:%1 for %2 s, closing connection").arg(connectionId).arg(idle));
+        StreamSocket::abort(socket);
+        return;
+    }
+
+    if(m_heartbeat.pingInterval > 0 && !liveness->pinged && idle >= static_cast<quint64>(m_heartbeat.pingInterval))
+    {
+        // 어떤 응답이든(Pong 포함) 받으면 slot_readSocket에서 다시 살아있는 것으로 기록
+        liveness->pinged = true;
+        s_pingsSent.ref();
+        OutboundQueue::of(socket)->enqueue(FrameProtocol::encodeFrame(FrameProtocol::FrameType::Ping, 0, QByteArray(), QByteArray()));
+    }
+
+    scheduleLivenessCheck(connectionId);
+}
+
+
+// 서버 종료 시 담당하는 모든 연결 소켓 해제
+void ConnectionWorker::slot_closeAll()
+{
+    for(auto it = m_sockets.begin(); it != m_sockets.end(); ++it)
+    {
+        QIODevice* socket = it.value();
+        leaveAllRooms(socket);
+        ServerMetrics::removeConnection(it.key());
+        socket->disconnect(this);
+        socket->close();
+        socket->deleteLater();
+    }
+    m_sockets.clear();
+    m_connectionIds.clear();
+    m_connectionCount.storeRelaxed(0);
+
+    foreach (ConnectionId connectionId, m_liveness.keys())
+        m_idleTimers.cancel(connectionId);
+    m_liveness.clear();
+    m_heartbeatTimer->stop();
+
+    m_inbound.clear();
+    m_throttled.clear();
+    m_readQueue.clear();
+    m_throttleTimer->stop();
+}
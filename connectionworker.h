@@ -0,0 +1,190 @@
+#ifndef CONNECTIONWORKER_H
+#define CONNECTIONWORKER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QSet>
+#include <QSharedPointer>
+#include <QLocalSocket>
+#include <QQueue>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "connectionid.h"
+#include "outboundqueue.h"
+#include "timerwheel.h"
+#include "tokenbucket.h"
+
+class MessageHistory;
+class RoomDirectory;
+
+// 자신의 event loop thread에서 여러 연결 소켓을 담당하는 worker
+// ChatTcpServer가 accept한 socket descriptor와 연결 ID를 넘겨받아 QTcpSocket(또는 QLocalSocket)을 생성하고
+// frame 수신/송신을 모두 이 thread에서 처리함
+// GUI에는 화면 표시용 signal만 전달
+//
+// 담당 소켓의 room 구독 목록도 이 thread에서 관리하고, 서버 전체 색인(RoomDirectory)에는
+// room마다 이 worker의 구독자 수만 알려 publish가 구독자가 있는 worker에만 오도록 함
+//
+// disconnected를 받지 못하는 반쯤 열린 연결(끊어진 NAT 뒤의 클라이언트 등)을 정리하기 위해
+// 한동안 아무것도 받지 못한 연결에는 Ping을 보내고, 그래도 응답이 없으면 연결을 끊음
+// 연결마다 QTimer를 두지 않고 worker마다 timer 하나로 TimerWheel을 돌리며,
+// 수신할 때는 마지막 수신 tick만 기록하고 wheel에서 만료된 연결만 다시 확인함
+//
+// 한 클라이언트가 worker를 독차지하지 않도록 연결마다 수신 frame 수/바이트에 token bucket 한도를 두고,
+// 한도를 넘은 연결은 소켓 읽기 버퍼를 줄여 더 읽지 않음(커널 버퍼가 차면 TCP 흐름 제어로 송신 측이 멈춤)
+// 또 한 번에 처리하는 양을 MaxFramesPerTurn/MaxBytesPerTurn으로 제한하고 남은 frame은 대기열 뒤로 미뤄
+// 밀린 연결들을 돌아가며(round-robin) 처리하므로, 그 사이 다른 연결의 수신도 지연되지 않음
+class ConnectionWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // 한 연결이 동시에 들어가 있을 수 있는 최대 room 수
+    static constexpr int MaxRoomsPerConnection = 64;
+    // TimerWheel 한 tick의 길이(ms)
+    static constexpr int HeartbeatTickInterval = 1000;
+    // 한 연결을 다른 연결에 차례를 넘기기 전까지 처리하는 최대 frame 수와 바이트
+    static constexpr int MaxFramesPerTurn = 64;
+    static constexpr qint64 MaxBytesPerTurn = 256 * 1024;
+    // 수신 한도를 넘은 연결의 소켓 읽기 버퍼 크기(0은 무제한이므로 최소값 1)
+    static constexpr qint64 ThrottledReadBufferSize = 1;
+
+    // 연결 생존 확인 주기(초 단위, 0이면 사용하지 않음)
+    struct Heartbeat
+    {
+        int pingInterval = 30;      // 이 시간 동안 받은 것이 없으면 Ping 전송
+        int idleTimeout = 90;       // 이 시간 동안 받은 것이 없으면 연결 종료
+    };
+
+    // 모든 worker의 생존 확인 결과(프로세스 전체 누적)
+    struct HeartbeatStatistics
+    {
+        quint64 pingsSent = 0;
+        quint64 reaped = 0;         // 응답이 없어 끊은 연결 수
+    };
+
+    // 연결별 수신 한도(0이면 제한하지 않음)
+    struct RateLimit
+    {
+        double framesPerSecond = 0;
+        double bytesPerSecond = 0;
+        double burstSeconds = 1;    // 잠시 한도를 넘어 받을 수 있는 양(초당 한도 x burstSeconds)
+    };
+
+    // 모든 worker의 수신 조절 결과(프로세스 전체 누적)
+    struct InboundStatistics
+    {
+        quint64 throttled = 0;      // 한도를 넘어 읽기를 멈춘 횟수
+        quint64 deferredReads = 0;  // 차례가 끝나 남은 frame을 뒤로 미룬 횟수
+    };
+
+    explicit ConnectionWorker(RoomDirectory* rooms, QObject* parent = nullptr);
+
+    // 이 worker가 담당하는 연결 수(least-loaded 분배에 사용, 어느 thread에서나 읽을 수 있음)
+    int connectionCount() const { return m_connectionCount.loadRelaxed(); }
+    // 새 연결을 배정할 때 서버 thread에서 먼저 증가시킴
+    void reserveConnection() { m_connectionCount.ref(); }
+
+    static HeartbeatStatistics heartbeatStatistics();
+    static InboundStatistics inboundStatistics();
+
+public slots:
+    // 아래 slot들은 모두 worker thread에서 실행되어야 함(QueuedConnection/invokeMethod로 호출)
+    void slot_addConnection(ConnectionId connectionId, qintptr socketDescriptor);
+    void slot_addLocalConnection(ConnectionId connectionId, qintptr socketDescriptor);
+    void slot_sendFrame(ConnectionId connectionId, const QByteArray& frame);
+    // compressedFrame : 압축을 지원하는 소켓에 대신 보낼 frame(압축하지 않았으면 frame과 같음)
+    void slot_broadcastFrame(const QByteArray& frame, const QByteArray& compressedFrame, OutboundQueue::Delivery delivery, const QSharedPointer<BroadcastBudget>& budget);
+    // room에 들어가 있는 이 worker의 소켓에만 frame 전송(RoomDirectory::publish에서 호출)
+    void slot_publishFrame(const QByteArray& room, const QByteArray& frame, const QByteArray& compressedFrame, OutboundQueue::Delivery delivery);
+    void slot_sendAttachment(ConnectionId connectionId, const QString& filePath);
+    void slot_acceptAttachment(ConnectionId connectionId, quint32 transferId, const QString& filePath);
+    void slot_rejectAttachment(ConnectionId connectionId, quint32 transferId);
+    void slot_closeAll();
+    // 이후 생성되는 소켓과 기존 소켓의 송신 대기열 한도 변경
+    void slot_setQueueLimits(const OutboundQueue::Limits& limits);
+    // 클라이언트 메시지를 기록하고 HistoryRequest에 응답할 메시지 기록(nullptr이면 기록하지 않음)
+    void slot_setHistory(const QSharedPointer<MessageHistory>& history);
+    // 이후 생성되는 소켓과 기존 소켓의 생존 확인 주기 변경
+    void slot_setHeartbeat(const Heartbeat& heartbeat);
+    // 이후 생성되는 소켓과 기존 소켓의 수신 한도 변경
+    void slot_setRateLimit(const RateLimit& rateLimit);
+
+signals:
+    void signal_clientConnected(ConnectionId connectionId);
+    void signal_clientDisconnected(ConnectionId connectionId);
+    void signal_attachmentOffered(ConnectionId connectionId, quint32 transferId, const QString& fileName, qint64 fileSize, const QHostAddress& peerAddress);
+    void signal_newMessage(const QString& message);
+    void signal_error(const QString& message);
+
+private slots:
+    void slot_readSocket();
+    void slot_discardSocket();
+    void slot_displayError();
+    void slot_heartbeatTick();
+    void slot_serviceReadQueue();
+    void slot_resumeThrottled();
+
+private:
+    // 소켓 종류와 관계없이 QIODevice로 처리
+    void adoptConnection(ConnectionId connectionId, QIODevice* socket);
+    void rejectConnection(ConnectionId connectionId, QIODevice* socket);
+    void readFrames(QIODevice* socket);
+    void joinRoom(QIODevice* socket, const QByteArray& room);
+    void leaveRoom(QIODevice* socket, const QByteArray& room);
+    void leaveAllRooms(QIODevice* socket);
+    // 연결의 다음 생존 확인 시각을 wheel에 등록
+    void scheduleLivenessCheck(ConnectionId connectionId);
+    // wheel에서 만료된 연결 : Ping을 보내거나 연결을 끊음
+    void checkLiveness(ConnectionId connectionId);
+    // 수신 한도를 넘었으면 소켓 읽기를 멈추고 token이 찰 때 재개하도록 예약한 뒤 true 반환
+    bool throttle(ConnectionId connectionId, QIODevice* socket);
+    void scheduleResume(qint64 nsecs);
+    // 남은 frame을 읽기 대기열 끝에 넣어 다음 차례에 처리
+    void deferRead(ConnectionId connectionId);
+
+    // 연결 ID -> socket, socket -> 연결 ID
+    QHash<ConnectionId, QIODevice*> m_sockets;
+    QHash<QIODevice*, ConnectionId> m_connectionIds;
+    QAtomicInt m_connectionCount;
+    OutboundQueue::Limits m_queueLimits;
+    QSharedPointer<MessageHistory> m_history;
+
+    RoomDirectory* m_rooms;
+    // room -> 구독 중인 소켓, 소켓 -> 들어가 있는 room
+    QHash<QByteArray, QSet<QIODevice*>> m_roomMembers;
+    QHash<QIODevice*, QSet<QByteArray>> m_memberships;
+
+    // 연결별 마지막 수신 tick과 그 뒤에 Ping을 보냈는지 여부
+    struct Liveness
+    {
+        quint64 lastActivity = 0;
+        bool pinged = false;
+    };
+    Heartbeat m_heartbeat;
+    QTimer* m_heartbeatTimer;
+    TimerWheel m_idleTimers;
+    QHash<ConnectionId, Liveness> m_liveness;
+
+    // 연결별 수신 token과 읽기 상태
+    struct Inbound
+    {
+        TokenBucket frames;
+        TokenBucket bytes;
+        bool queued = false;        // 읽기 대기열에 들어 있음
+    };
+    void configureInbound(Inbound& inbound);
+    RateLimit m_rateLimit;
+    QElapsedTimer m_clock;
+    QHash<ConnectionId, Inbound> m_inbound;
+    // 한도를 넘어 읽기를 멈춘 연결, 다음 차례를 기다리는 연결
+    QSet<ConnectionId> m_throttled;
+    QQueue<ConnectionId> m_readQueue;
+    bool m_readQueueScheduled = false;
+    QTimer* m_throttleTimer;
+};
+
+#endif // CONNECTIONWORKER_H
@@ -0,0 +1,206 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_X86
+#include <nmmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define CRC32C_ARM64
+#include <arm_acle.h>
+#if defined(Q_OS_LINUX)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+namespace Crc32c
+{
+
+// 반사(reflected) 형태의 Castagnoli 다항식
+static constexpr quint32 Polynomial = 0x82F63B78;
+
+// slicing-by-8 표 : tables[k][b]는 바이트 b 뒤에 0이 k바이트 더 있을 때의 crc
+struct Tables
+{
+    quint32 entries[8][256];
+
+    Tables()
+    {
+        for(quint32 byte = 0; byte < 256; ++byte)
+        {
+            quint32 crc = byte;
+            for(int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ ((crc & 1) ? Polynomial : 0);
+            entries[0][byte] = crc;
+        }
+        for(quint32 byte = 0; byte < 256; ++byte)
+        {
+            for(int k = 1; k < 8; ++k)
+                entries[k][byte] = (entries[k - 1][byte] >> 8) ^ entries[0][entries[k - 1][byte] & 0xFF];
+        }
+    }
+};
+
+static const Tables& tables()
+{
+    static const Tables s_tables;
+    return s_tables;
+}
+
+// crc 값은 시작/끝에서 반전하므로 내부 계산 함수는 반전된 상태의 값을 주고받음
+static quint32 updatePortable(quint32 crc, const uchar* data, qint64 size)
+{
+    const Tables& t = tables();
+
+    while(size > 0 && (quintptr(data) & 7))
+    {
+        crc = (crc >> 8) ^ t.entries[0][(crc ^ *data++) & 0xFF];
+        --size;
+    }
+
+    // 8바이트씩 : little-endian 순서로 읽어 표 8개를 한 번에 참조
+    while(size >= 8)
+    {
+        const quint32 low = crc ^ (quint32(data[0]) | quint32(data[1]) << 8 | quint32(data[2]) << 16 | quint32(data[3]) << 24);
+        const quint32 high = quint32(data[4]) | quint32(data[5]) << 8 | quint32(data[6]) << 16 | quint32(data[7]) << 24;
+        crc = t.entries[7][low & 0xFF] ^ t.entries[6][(low >> 8) & 0xFF] ^ t.entries[5][(low >> 16) & 0xFF] ^ t.entries[4][low >> 24]
+            ^ t.entries[3][high & 0xFF] ^ t.entries[2][(high >> 8) & 0xFF] ^ t.entries[1][(high >> 16) & 0xFF] ^ t.entries[0][high >> 24];
+        data += 8;
+        size -= 8;
+    }
+
+    while(size > 0)
+    {
+        crc = (crc >> 8) ^ t.entries[0][(crc ^ *data++) & 0xFF];
+        --size;
+    }
+    return crc;
+}
+
+#if defined(CRC32C_X86)
+__attribute__((target("sse4.2")))
+static quint32 updateHardware(quint32 crc, const uchar* data, qint64 size)
+{
+    while(size > 0 && (quintptr(data) & 7))
+    {
+        crc = _mm_crc32_u8(crc, *data++);
+        --size;
+    }
+
+#if defined(__x86_64__)
+    quint64 crc64 = crc;
+    while(size >= 8)
+    {
+        quint64 value;
+        memcpy(&value, data, sizeof(value));
+        crc64 = _mm_crc32_u64(crc64, value);
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<quint32>(crc64);
+#endif
+
+    while(size >= 4)
+    {
+        quint32 value;
+        memcpy(&value, data, sizeof(value));
+        crc = _mm_crc32_u32(crc, value);
+        data += 4;
+        size -= 4;
+    }
+
+    while(size > 0)
+    {
+        crc = _mm_crc32_u8(crc, *data++);
+        --size;
+    }
+    return crc;
+}
+
+static bool hasHardwareSupport()
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+
+static const char* const HardwareName = "sse4.2";
+#elif defined(CRC32C_ARM64)
+#if defined(__clang__)
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+static quint32 updateHardware(quint32 crc, const uchar* data, qint64 size)
+{
+    while(size > 0 && (quintptr(data) & 7))
+    {
+        crc = __crc32cb(crc, *data++);
+        --size;
+    }
+
+    while(size >= 8)
+    {
+        quint64 value;
+        memcpy(&value, data, sizeof(value));
+        crc = __crc32cd(crc, value);
+        data += 8;
+        size -= 8;
+    }
+
+    while(size > 0)
+    {
+        crc = __crc32cb(crc, *data++);
+        --size;
+    }
+    return crc;
+}
+
+static bool hasHardwareSupport()
+{
+#if defined(__ARM_FEATURE_CRC32) || defined(Q_OS_DARWIN)
+    return true;
+#elif defined(Q_OS_LINUX)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+
+static const char* const HardwareName = "armv8-crc";
+#endif
+
+typedef quint32 (*UpdateFunction)(quint32, const uchar*, qint64);
+
+// 실행 중인 CPU에 맞는 구현(처음 호출할 때 한 번만 확인)
+static UpdateFunction selectedUpdate()
+{
+    static const UpdateFunction s_update = []() -> UpdateFunction {
+#if defined(CRC32C_X86) || defined(CRC32C_ARM64)
+        if(hasHardwareSupport())
+            return updateHardware;
+#endif
+        return updatePortable;
+    }();
+    return s_update;
+}
+
+quint32 extend(quint32 crc, const char* data, qint64 size)
+{
+    return ~selectedUpdate()(~crc, reinterpret_cast<const uchar*>(data), size);
+}
+
+quint32 extendPortable(quint32 crc, const char* data, qint64 size)
+{
+    return ~updatePortable(~crc, reinterpret_cast<const uchar*>(data), size);
+}
+
+const char* implementation()
+{
+#if defined(CRC32C_X86) || defined(CRC32C_ARM64)
+    if(selectedUpdate() == updateHardware)
+        return HardwareName;
+#endif
+    return "portable";
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QByteArray>
+
+// CRC32C(Castagnoli) 계산
+// x86은 SSE4.2, ARMv8은 CRC 명령을 실행 중인 CPU가 지원할 때 사용하고, 아니면 slicing-by-8 표 방식으로 계산
+// 어느 구현이든 결과는 같으며(iSCSI/ext4 등과 같은 값), 처음 한 번 CPU를 확인한 뒤에는 분기 없이 호출됨
+// 첨부파일 chunk와 파일 전체의 무결성 확인에 사용하며, 전송 속도보다 훨씬 빨라 송수신 중에 바로 계산함
+namespace Crc32c
+{
+    // 앞부분의 결과 crc(처음에는 0)에 data를 이어서 계산
+    // extend(extend(0, a), b) == extend(0, a + b)
+    quint32 extend(quint32 crc, const char* data, qint64 size);
+    inline quint32 extend(quint32 crc, const QByteArray& data) { return extend(crc, data.constData(), data.size()); }
+    inline quint32 compute(const QByteArray& data) { return extend(0, data); }
+
+    // CPU 명령을 쓰지 않는 구현(속도 비교용)
+    quint32 extendPortable(quint32 crc, const char* data, qint64 size);
+
+    // 사용 중인 구현 : "sse4.2", "armv8-crc", "portable"
+    const char* implementation();
+}
+
+#endif // CRC32C_H
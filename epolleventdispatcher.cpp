@@ -0,0 +1,353 @@
+#include "epolleventdispatcher.h"
+
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QVarLengthArray>
+
+#include <climits>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Qt 기본 dispatcher들과 같이 hasPendingEvents에서 사용
+extern Q_CORE_EXPORT uint qGlobalPostedEventsCount();
+
+// epoll dispatcher 사용 여부(기본은 Qt 기본 dispatcher)
+static QAtomicInt s_enabled(0);
+
+void EpollEventDispatcher::setEnabled(bool enabled)
+{
+    s_enabled.storeRelaxed(enabled ? 1 : 0);
+}
+
+bool EpollEventDispatcher::isEnabled()
+{
+#ifdef Q_OS_LINUX
+    return s_enabled.loadRelaxed() != 0;
+#else
+    return false;
+#endif
+}
+
+QAbstractEventDispatcher* EpollEventDispatcher::create()
+{
+#ifdef Q_OS_LINUX
+    if(!isEnabled())
+        return nullptr;
+
+    EpollEventDispatcher* dispatcher = new EpollEventDispatcher;
+    if(dispatcher->isValid())
+        return dispatcher;
+
+    qWarning("epoll is not available, using the default event loop: %s", qPrintable(qt_error_string(errno)));
+    delete dispatcher;
+#endif
+    return nullptr;
+}
+
+#ifdef Q_OS_LINUX
+
+EpollEventDispatcher::EpollEventDispatcher(QObject* parent) : QAbstractEventDispatcher(parent)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(m_epollFd < 0)
+        return;
+
+    m_wakeUpFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(m_wakeUpFd < 0)
+        return;
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeUpFd;
+    if(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeUpFd, &event) < 0)
+    {
+        ::close(m_wakeUpFd);
+        m_wakeUpFd = -1;
+    }
+}
+
+EpollEventDispatcher::~EpollEventDispatcher()
+{
+    if(m_wakeUpFd >= 0)
+        ::close(m_wakeUpFd);
+    if(m_epollFd >= 0)
+        ::close(m_epollFd);
+}
+
+qint64 EpollEventDispatcher::currentMsecs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+bool EpollEventDispatcher::processEvents(QEventLoop::ProcessEventsFlags flags)
+{
+    m_interrupted.storeRelaxed(0);
+    emit awake();
+
+    // 다른 thread가 post한 event(invokeMethod 등)와 deleteLater 처리
+    // 처리 도중 새로 post된 event는 wakeUp으로 eventfd가 깨어 있으므로 아래에서 기다리지 않음
+    QCoreApplication::sendPostedEvents();
+
+    const bool includeTimers = !(flags & QEventLoop::X11ExcludeTimers);
+    int timeout = 0;
+    if((flags & QEventLoop::WaitForMoreEvents) && !m_interrupted.loadRelaxed())
+        timeout = includeTimers ? timeUntilNextTimer() : -1;
+
+    if(timeout != 0)
+        emit aboutToBlock();
+
+    epoll_event events[MaxEvents];
+    int ready = epoll_wait(m_epollFd, events, MaxEvents, timeout);
+    if(ready < 0)
+    {
+        if(errno != EINTR)
+            qWarning("epoll_wait failed: %s", qPrintable(qt_error_string(errno)));
+        ready = 0;
+    }
+
+    if(timeout != 0)
+        emit awake();
+
+    for(int i = 0; i < ready; ++i)
+    {
+        const int fd = events[i].data.fd;
+        if(fd == m_wakeUpFd)
+        {
+            eventfd_t value;
+            eventfd_read(m_wakeUpFd, &value);
+            continue;
+        }
+
+        // level-triggered이므로 지금 건너뛴 descriptor는 다음 loop에서 다시 알려짐
+        if(flags & QEventLoop::ExcludeSocketNotifiers)
+            continue;
+
+        QHash<int, Notifiers>::const_iterator it = m_notifiers.constFind(fd);
+        if(it == m_notifiers.constEnd())
+            continue;
+
+        // 오류/끊김은 읽기와 쓰기 쪽 모두에 알려 소켓이 직접 오류를 확인하도록 함
+        const quint32 occurred = events[i].events;
+        if(occurred & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            m_pendingNotifiers.append(it->read);
+        if(occurred & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+            m_pendingNotifiers.append(it->write);
+        if(occurred & EPOLLPRI)
+            m_pendingNotifiers.append(it->exception);
+    }
+
+    // notifier 처리 중에 다른 notifier가 해제될 수 있으므로 하나씩 꺼내며 처리
+    int activated = 0;
+    while(!m_pendingNotifiers.isEmpty())
+    {
+        QSocketNotifier* notifier = m_pendingNotifiers.takeFirst();
+        QEvent event(QEvent::SockAct);
+        QCoreApplication::sendEvent(notifier, &event);
+        ++activated;
+    }
+
+    if(includeTimers)
+        activated += activateTimers();
+
+    return activated > 0;
+}
+
+bool EpollEventDispatcher::hasPendingEvents()
+{
+    return qGlobalPostedEventsCount() > 0;
+}
+
+void EpollEventDispatcher::registerSocketNotifier(QSocketNotifier* notifier)
+{
+    const int fd = int(notifier->socket());
+    Notifiers& notifiers = m_notifiers[fd];
+    QList<QSocketNotifier*>* list = nullptr;
+    switch(notifier->type())
+    {
+    case QSocketNotifier::Read:
+        list = &notifiers.read;
+        break;
+    case QSocketNotifier::Write:
+        list = &notifiers.write;
+        break;
+    case QSocketNotifier::Exception:
+        list = &notifiers.exception;
+        break;
+    }
+    if(list && !list->contains(notifier))
+        list->append(notifier);
+    updateEpoll(fd, notifiers);
+}
+
+void EpollEventDispatcher::unregisterSocketNotifier(QSocketNotifier* notifier)
+{
+    m_pendingNotifiers.removeAll(notifier);
+
+    const int fd = int(notifier->socket());
+    QHash<int, Notifiers>::iterator it = m_notifiers.find(fd);
+    if(it == m_notifiers.end())
+        return;
+
+    // 같은 descriptor의 다른 notifier가 남아 있으면 그 event는 계속 감시
+    it->read.removeAll(notifier);
+    it->write.removeAll(notifier);
+    it->exception.removeAll(notifier);
+    updateEpoll(fd, it.value());
+
+    if(it->read.isEmpty() && it->write.isEmpty() && it->exception.isEmpty())
+        m_notifiers.erase(it);
+}
+
+void EpollEventDispatcher::updateEpoll(int fd, Notifiers& notifiers)
+{
+    quint32 events = 0;
+    if(!notifiers.read.isEmpty())
+        events |= EPOLLIN;
+    if(!notifiers.write.isEmpty())
+        events |= EPOLLOUT;
+    if(!notifiers.exception.isEmpty())
+        events |= EPOLLPRI;
+    if(events == notifiers.events)
+        return;
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    const int operation = notifiers.events == 0 ? EPOLL_CTL_ADD : (events == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD);
+    // descriptor를 먼저 닫은 경우에는 커널이 이미 epoll에서 뺐으므로 DEL 실패는 무시
+    if(epoll_ctl(m_epollFd, operation, fd, &event) < 0 && operation != EPOLL_CTL_DEL)
+    {
+        qWarning("Unable to watch socket %d with epoll: %s", fd, qPrintable(qt_error_string(errno)));
+        return;
+    }
+    notifiers.events = events;
+}
+
+void EpollEventDispatcher::registerTimer(int timerId, int interval, Qt::TimerType timerType, QObject* object)
+{
+    unregisterTimer(timerId);
+
+    Timer timer;
+    timer.interval = interval;
+    timer.type = timerType;
+    timer.object = object;
+    timer.deadline = currentMsecs() + interval;
+    timer.position = m_deadlines.emplace(timer.deadline, timerId);
+    m_timers.insert(timerId, timer);
+}
+
+bool EpollEventDispatcher::unregisterTimer(int timerId)
+{
+    QHash<int, Timer>::iterator it = m_timers.find(timerId);
+    if(it == m_timers.end())
+        return false;
+
+    m_deadlines.erase(it->position);
+    m_timers.erase(it);
+    return true;
+}
+
+bool EpollEventDispatcher::unregisterTimers(QObject* object)
+{
+    bool removed = false;
+    QHash<int, Timer>::iterator it = m_timers.begin();
+    while(it != m_timers.end())
+    {
+        if(it->object == object)
+        {
+            m_deadlines.erase(it->position);
+            it = m_timers.erase(it);
+            removed = true;
+        }
+        else
+            ++it;
+    }
+    return removed;
+}
+
+QList<QAbstractEventDispatcher::TimerInfo> EpollEventDispatcher::registeredTimers(QObject* object) const
+{
+    QList<TimerInfo> timers;
+    for(QHash<int, Timer>::const_iterator it = m_timers.constBegin(); it != m_timers.constEnd(); ++it)
+    {
+        if(it->object == object)
+            timers.append(TimerInfo(it.key(), it->interval, it->type));
+    }
+    return timers;
+}
+
+int EpollEventDispatcher::remainingTime(int timerId)
+{
+    QHash<int, Timer>::const_iterator it = m_timers.constFind(timerId);
+    if(it == m_timers.constEnd())
+        return -1;
+    return int(qMax<qint64>(0, it->deadline - currentMsecs()));
+}
+
+int EpollEventDispatcher::timeUntilNextTimer() const
+{
+    if(m_deadlines.empty())
+        return -1;
+    return int(qBound<qint64>(0, m_deadlines.begin()->first - currentMsecs(), INT_MAX));
+}
+
+int EpollEventDispatcher::activateTimers()
+{
+    // 지금 만료된 timer만 실행(timerEvent 안에서 다시 만료 시각이 된 timer는 다음 loop에서 처리)
+    const qint64 now = currentMsecs();
+    QVarLengthArray<int, 32> expired;
+    for(Deadlines::const_iterator it = m_deadlines.cbegin(); it != m_deadlines.cend() && it->first <= now; ++it)
+        expired.append(it->second);
+
+    int activated = 0;
+    for(int timerId : expired)
+    {
+        // 앞의 timerEvent에서 해제되었을 수 있으므로 다시 찾음
+        QHash<int, Timer>::iterator it = m_timers.find(timerId);
+        if(it == m_timers.end() || it->active)
+            continue;
+
+        // 다음 만료 시각, 처리가 밀려 이미 지났으면 지금부터 다시 셈
+        it->deadline += it->interval;
+        if(it->deadline < now)
+            it->deadline = now + it->interval;
+        m_deadlines.erase(it->position);
+        it->position = m_deadlines.emplace(it->deadline, timerId);
+        it->active = true;
+
+        QTimerEvent event(timerId);
+        QCoreApplication::sendEvent(it->object, &event);
+        ++activated;
+
+        // timerEvent 안에서 timer가 추가/삭제되어 iterator가 무효일 수 있음
+        it = m_timers.find(timerId);
+        if(it != m_timers.end())
+            it->active = false;
+    }
+    return activated;
+}
+
+void EpollEventDispatcher::wakeUp()
+{
+    eventfd_write(m_wakeUpFd, 1);
+}
+
+void EpollEventDispatcher::interrupt()
+{
+    m_interrupted.storeRelaxed(1);
+    wakeUp();
+}
+
+void EpollEventDispatcher::flush()
+{
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef EPOLLEVENTDISPATCHER_H
+#define EPOLLEVENTDISPATCHER_H
+
+#include <QAbstractEventDispatcher>
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+
+#include <map>
+
+// connection worker thread용 Linux epoll event dispatcher
+// Qt 기본 dispatcher(glib/poll)는 깨어날 때마다 등록된 모든 socket notifier를 poll 배열로 넘기고 다시 훑으므로
+// 데이터가 온 연결이 하나뿐이어도 event loop 한 번의 비용이 담당 연결 수에 비례함
+// 이 dispatcher는 descriptor를 epoll에 등록해두고(notifier가 켜지고 꺼질 때만 epoll_ctl) 준비된 descriptor만 받아 처리하므로
+// loop 한 번의 비용이 실제로 활동한 연결 수에만 비례함
+// QSocketNotifier는 level-triggered 동작(읽을 데이터가 남아 있으면 다시 알림)을 기대하므로 epoll도 level-triggered로 사용
+// timer는 만료 시각 순으로 정렬해 두고 가장 가까운 만료 시각까지만 기다림(timer 종류와 관계없이 ms 단위)
+// QThread::setEventDispatcher로 thread 시작 전에 설치하며, 설치한 thread에서만 사용(wakeUp/interrupt는 어느 thread에서나 가능)
+class EpollEventDispatcher : public QAbstractEventDispatcher
+{
+public:
+    // epoll_wait 한 번에 받는 최대 event 수
+    static constexpr int MaxEvents = 256;
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    // 켜져 있고 epoll을 쓸 수 있으면 새 dispatcher를, 아니면 nullptr(Qt 기본 dispatcher 사용)을 반환
+    static QAbstractEventDispatcher* create();
+
+    explicit EpollEventDispatcher(QObject* parent = nullptr);
+    ~EpollEventDispatcher() override;
+
+    bool isValid() const { return m_epollFd >= 0 && m_wakeUpFd >= 0; }
+
+    bool processEvents(QEventLoop::ProcessEventsFlags flags) override;
+    bool hasPendingEvents() override;
+
+    void registerSocketNotifier(QSocketNotifier* notifier) override;
+    void unregisterSocketNotifier(QSocketNotifier* notifier) override;
+
+    void registerTimer(int timerId, int interval, Qt::TimerType timerType, QObject* object) override;
+    bool unregisterTimer(int timerId) override;
+    bool unregisterTimers(QObject* object) override;
+    QList<TimerInfo> registeredTimers(QObject* object) const override;
+    int remainingTime(int timerId) override;
+
+    void wakeUp() override;
+    void interrupt() override;
+    void flush() override;
+
+private:
+    typedef std::multimap<qint64, int> Deadlines;   // 만료 시각(ms) -> timerId
+
+    // descriptor 하나에 등록된 notifier
+    // 같은 종류의 notifier가 여럿일 수 있음(소켓의 쓰기 notifier와 AttachmentSender의 sendfile용 notifier 등)
+    // 하나를 등록하거나 해제해도 다른 notifier는 그대로 두고, event는 모두에게 전달
+    struct Notifiers
+    {
+        QList<QSocketNotifier*> read;
+        QList<QSocketNotifier*> write;
+        QList<QSocketNotifier*> exception;
+        quint32 events = 0;     // 현재 epoll에 등록된 event
+    };
+
+    struct Timer
+    {
+        int interval;
+        Qt::TimerType type;
+        QObject* object;
+        qint64 deadline;
+        Deadlines::iterator position;
+        bool active = false;    // timerEvent 실행 중(재진입 방지)
+    };
+
+    static qint64 currentMsecs();
+    // notifier 구성에 맞게 epoll 등록을 고침(모두 해제되었으면 epoll에서 뺌)
+    void updateEpoll(int fd, Notifiers& notifiers);
+    // 가장 가까운 timer 만료까지 남은 ms(timer가 없으면 -1)
+    int timeUntilNextTimer() const;
+    int activateTimers();
+
+    int m_epollFd = -1;
+    int m_wakeUpFd = -1;        // eventfd, 다른 thread의 wakeUp으로 epoll_wait를 깨움
+    QAtomicInt m_interrupted;
+    QHash<int, Notifiers> m_notifiers;
+    // 이번 loop에서 활성화할 notifier(처리 도중 해제된 notifier는 여기서 빠짐)
+    QList<QSocketNotifier*> m_pendingNotifiers;
+    QHash<int, Timer> m_timers;
+    Deadlines m_deadlines;
+};
+
+#endif // EPOLLEVENTDISPATCHER_H
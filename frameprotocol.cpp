@@ -0,0 +1,360 @@
+#include "frameprotocol.h"
+#include "crc32c.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace FrameProtocol
+{
+
+// 압축 설정
+static QAtomicInt s_compressionEnabled(1);
+static QAtomicInt s_compressionThreshold(256);
+
+// 압축 통계
+static QAtomicInteger<quint64> s_compressedFrames;
+static QAtomicInteger<quint64> s_skippedFrames;
+static QAtomicInteger<quint64> s_rawBytes;
+static QAtomicInteger<quint64> s_wireBytes;
+static QAtomicInteger<quint64> s_compressNsecs;
+static QAtomicInteger<quint64> s_decompressedFrames;
+static QAtomicInteger<quint64> s_decompressNsecs;
+static QAtomicInteger<quint64> s_checksumFailures;
+
+// FlagChecksum frame의 payload 끝에 붙는 CRC32C 크기
+static constexpr int ChecksumSize = sizeof(quint32);
+
+static void writeHeader(uchar* data, FrameType type, quint8 flags, quint16 nameLength, quint32 streamId, quint32 payloadLength)
+{
+    qToBigEndian<quint16>(Magic, data);
+    data[2] = Version;
+    data[3] = static_cast<quint8>(type);
+    data[4] = flags;
+    data[5] = 0;
+    qToBigEndian<quint16>(nameLength, data + 6);
+    qToBigEndian<quint32>(streamId, data + 8);
+    qToBigEndian<quint32>(payloadLength, data + 12);
+}
+
+QByteArray encodeFrame(FrameType type, quint32 streamId, const QByteArray& name, const QByteArray& payload, quint8 flags)
+{
+    // 이름은 nameLength(quint16) 범위까지만 전송
+    const int nameLength = qMin(name.size(), 0xFFFF);
+    const int payloadLength = payload.size() + ((flags & FlagChecksum) ? ChecksumSize : 0);
+
+    QByteArray frame(HeaderSize + nameLength + payloadLength, Qt::Uninitialized);
+    uchar* data = reinterpret_cast<uchar*>(frame.data());
+
+    writeHeader(data, type, flags, static_cast<quint16>(nameLength), streamId, static_cast<quint32>(payloadLength));
+
+    memcpy(data + HeaderSize, name.constData(), nameLength);
+    memcpy(data + HeaderSize + nameLength, payload.constData(), payload.size());
+    if(flags & FlagChecksum)
+        qToBigEndian<quint32>(Crc32c::compute(payload), data + HeaderSize + nameLength + payload.size());
+    return frame;
+}
+
+QByteArray encodeHeader(FrameType type, quint32 streamId, quint32 payloadLength, quint8 flags)
+{
+    QByteArray header(HeaderSize, Qt::Uninitialized);
+    writeHeader(reinterpret_cast<uchar*>(header.data()), type, flags, 0, streamId, payloadLength);
+    return header;
+}
+
+DecodeResult decodeHeader(const char* data, qint64 size, FrameHeader* header)
+{
+    if(size < HeaderSize)
+        return DecodeResult::NeedMoreData;
+
+    const uchar* bytes = reinterpret_cast<const uchar*>(data);
+
+    // magic, version이 다르면 이 프로토콜의 frame이 아님
+    if(qFromBigEndian<quint16>(bytes) != Magic || bytes[2] != Version)
+        return DecodeResult::Invalid;
+
+    const quint8 type = bytes[3];
+    if(type < static_cast<quint8>(FrameType::Message) || type > static_cast<quint8>(FrameType::Publish))
+        return DecodeResult::Invalid;
+
+    header->type = static_cast<FrameType>(type);
+    header->flags = bytes[4];
+    header->nameLength = qFromBigEndian<quint16>(bytes + 6);
+    header->streamId = qFromBigEndian<quint32>(bytes + 8);
+    header->payloadLength = qFromBigEndian<quint32>(bytes + 12);
+
+    if(header->payloadLength > MaxPayloadLength)
+        return DecodeResult::Invalid;
+
+    return DecodeResult::Ok;
+}
+
+// 전송 형식의 payload를 원래 payload로 되돌림(압축 해제, CRC32C 확인)
+static DecodeResult unpackPayload(Frame* frame)
+{
+    // 압축된 payload는 여기서 풀어 호출 측은 항상 원래 payload를 받음
+    if(frame->header.flags & FlagCompressed)
+    {
+        // qCompress 결과 앞 4바이트는 원래 크기 : 한도를 넘는 크기로 메모리를 잡지 않도록 먼저 확인
+        if(frame->payload.size() < 4 || qFromBigEndian<quint32>(frame->payload.constData()) > MaxPayloadLength)
+            return DecodeResult::Invalid;
+
+        QElapsedTimer timer;
+        timer.start();
+        QByteArray payload = qUncompress(frame->payload);
+        s_decompressNsecs.fetchAndAddRelaxed(static_cast<quint64>(timer.nsecsElapsed()));
+        if(payload.isEmpty())
+            return DecodeResult::Invalid;
+        s_decompressedFrames.fetchAndAddRelaxed(1);
+
+        frame->payload = payload;
+        frame->header.flags &= ~FlagCompressed;
+        frame->header.payloadLength = static_cast<quint32>(payload.size());
+    }
+
+    // 송신 측이 읽은 내용 그대로인지 확인한 뒤 CRC32C를 떼어냄
+    if(frame->header.flags & FlagChecksum)
+    {
+        const int dataLength = frame->payload.size() - ChecksumSize;
+        if(dataLength < 0 || Crc32c::extend(0, frame->payload.constData(), dataLength) != qFromBigEndian<quint32>(frame->payload.constData() + dataLength))
+        {
+            s_checksumFailures.fetchAndAddRelaxed(1);
+            return DecodeResult::Invalid;
+        }
+
+        frame->payload.truncate(dataLength);
+        frame->header.flags &= ~FlagChecksum;
+        frame->header.payloadLength = static_cast<quint32>(dataLength);
+    }
+    return DecodeResult::Ok;
+}
+
+DecodeResult readFrame(QIODevice* device, Frame* frame)
+{
+    // header는 스택 버퍼에 peek해서 해석
+    char headerBytes[HeaderSize];
+    const qint64 peeked = device->peek(headerBytes, HeaderSize);
+
+    DecodeResult result = decodeHeader(headerBytes, peeked, &frame->header);
+    if(result != DecodeResult::Ok)
+        return result;
+
+    // frame 전체가 도착할 때까지 기다림
+    if(device->bytesAvailable() < frame->header.frameSize())
+        return DecodeResult::NeedMoreData;
+
+    device->skip(HeaderSize);
+    frame->name = device->read(frame->header.nameLength);
+    frame->payload = device->read(frame->header.payloadLength);
+    return unpackPayload(frame);
+}
+
+DecodeResult decodeFrame(const char* data, qint64 size, Frame* frame, qint64* frameSize)
+{
+    DecodeResult result = decodeHeader(data, size, &frame->header);
+    if(result != DecodeResult::Ok)
+        return result;
+
+    // 압축/checksum을 풀면 payloadLength가 바뀌므로 차지한 크기는 먼저 구해 둠
+    const qint64 wireSize = frame->header.frameSize();
+    if(size < wireSize)
+        return DecodeResult::NeedMoreData;
+
+    frame->name = QByteArray(data + HeaderSize, frame->header.nameLength);
+    frame->payload = QByteArray(data + HeaderSize + frame->header.nameLength, static_cast<int>(frame->header.payloadLength));
+    result = unpackPayload(frame);
+    if(result == DecodeResult::Ok)
+        *frameSize = wireSize;
+    return result;
+}
+
+QByteArray encodeFileSize(qint64 fileSize)
+{
+    QByteArray payload(sizeof(quint64), Qt::Uninitialized);
+    qToBigEndian<quint64>(static_cast<quint64>(fileSize), payload.data());
+    return payload;
+}
+
+qint64 decodeFileSize(const QByteArray& payload)
+{
+    if(payload.size() < static_cast<int>(sizeof(quint64)))
+        return -1;
+    return static_cast<qint64>(qFromBigEndian<quint64>(payload.constData()));
+}
+
+QByteArray encodeAttachmentStart(qint64 fileSize, const QByteArray& resumeKey, const QByteArray& contentHash)
+{
+    // 내용 hash는 key 뒤의 고정 위치에 두므로 key가 있을 때만 붙임
+    if(resumeKey.size() != ResumeKeySize || contentHash.size() != ContentHashSize)
+        return encodeFileSize(fileSize) + resumeKey.left(ResumeKeySize);
+    return encodeFileSize(fileSize) + resumeKey + contentHash;
+}
+
+QByteArray decodeResumeKey(const QByteArray& payload)
+{
+    if(payload.size() < static_cast<int>(sizeof(quint64)) + ResumeKeySize)
+        return QByteArray();
+    return payload.mid(sizeof(quint64), ResumeKeySize);
+}
+
+QByteArray decodeContentHash(const QByteArray& payload)
+{
+    if(payload.size() < static_cast<int>(sizeof(quint64)) + ResumeKeySize + ContentHashSize)
+        return QByteArray();
+    return payload.mid(sizeof(quint64) + ResumeKeySize, ContentHashSize);
+}
+
+QByteArray encodeFileChecksum(quint32 checksum)
+{
+    QByteArray payload(sizeof(quint32), Qt::Uninitialized);
+    qToBigEndian<quint32>(checksum, payload.data());
+    return payload;
+}
+
+qint64 decodeFileChecksum(const QByteArray& payload)
+{
+    if(payload.size() < static_cast<int>(sizeof(quint32)))
+        return -1;
+    return qFromBigEndian<quint32>(payload.constData());
+}
+
+QByteArray encodeHello(quint32 capabilities)
+{
+    QByteArray payload(sizeof(quint32), Qt::Uninitialized);
+    qToBigEndian<quint32>(capabilities, payload.data());
+    return payload;
+}
+
+quint32 decodeHello(const QByteArray& payload)
+{
+    // 이후 버전이 payload를 늘려도 앞 4바이트만 해석
+    if(payload.size() < static_cast<int>(sizeof(quint32)))
+        return 0;
+    return qFromBigEndian<quint32>(payload.constData());
+}
+
+quint32 localCapabilities()
+{
+    return CapChecksum | (isCompressionEnabled() ? CapCompression : 0);
+}
+
+QByteArray encodeHistoryRequest(quint32 sinceSequence, quint32 limit)
+{
+    QByteArray payload(2 * sizeof(quint32), Qt::Uninitialized);
+    qToBigEndian<quint32>(sinceSequence, payload.data());
+    qToBigEndian<quint32>(limit, payload.data() + sizeof(quint32));
+    return payload;
+}
+
+bool decodeHistoryRequest(const QByteArray& payload, quint32* sinceSequence, quint32* limit)
+{
+    if(payload.size() < static_cast<int>(2 * sizeof(quint32)))
+        return false;
+    *sinceSequence = qFromBigEndian<quint32>(payload.constData());
+    *limit = qFromBigEndian<quint32>(payload.constData() + sizeof(quint32));
+    return true;
+}
+
+QByteArray encodeRoomMessage(const QByteArray& sender, const QByteArray& text)
+{
+    const int senderLength = qMin(sender.size(), 0xFFFF);
+
+    QByteArray payload(static_cast<int>(sizeof(quint16)) + senderLength + text.size(), Qt::Uninitialized);
+    char* data = payload.data();
+    qToBigEndian<quint16>(static_cast<quint16>(senderLength), data);
+    memcpy(data + sizeof(quint16), sender.constData(), senderLength);
+    memcpy(data + sizeof(quint16) + senderLength, text.constData(), text.size());
+    return payload;
+}
+
+bool decodeRoomMessage(const QByteArray& payload, QByteArray* sender, QByteArray* text)
+{
+    if(payload.size() < static_cast<int>(sizeof(quint16)))
+        return false;
+
+    const int senderLength = qFromBigEndian<quint16>(payload.constData());
+    if(payload.size() < static_cast<int>(sizeof(quint16)) + senderLength)
+        return false;
+
+    *sender = payload.mid(sizeof(quint16), senderLength);
+    *text = payload.mid(sizeof(quint16) + senderLength);
+    return true;
+}
+
+QByteArray compressFrame(const QByteArray& frame)
+{
+    FrameHeader header;
+    if(decodeHeader(frame.constData(), frame.size(), &header) != DecodeResult::Ok || (header.flags & FlagCompressed))
+        return frame;
+
+    const int threshold = s_compressionThreshold.loadRelaxed();
+    if(!isCompressionEnabled() || header.payloadLength < static_cast<quint32>(qMax(threshold, 1)))
+        return frame;
+
+    const int payloadOffset = HeaderSize + header.nameLength;
+
+    // 전송 지연이 중요하므로 가장 빠른 level 사용
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray compressed = qCompress(reinterpret_cast<const uchar*>(frame.constData()) + payloadOffset, static_cast<int>(header.payloadLength), 1);
+    s_compressNsecs.fetchAndAddRelaxed(static_cast<quint64>(timer.nsecsElapsed()));
+
+    if(compressed.isEmpty() || compressed.size() >= static_cast<int>(header.payloadLength))
+    {
+        s_skippedFrames.fetchAndAddRelaxed(1);
+        return frame;
+    }
+
+    s_compressedFrames.fetchAndAddRelaxed(1);
+    s_rawBytes.fetchAndAddRelaxed(header.payloadLength);
+    s_wireBytes.fetchAndAddRelaxed(static_cast<quint64>(compressed.size()));
+
+    QByteArray result(payloadOffset + compressed.size(), Qt::Uninitialized);
+    uchar* data = reinterpret_cast<uchar*>(result.data());
+    writeHeader(data, header.type, header.flags | FlagCompressed, header.nameLength, header.streamId, static_cast<quint32>(compressed.size()));
+    memcpy(data + HeaderSize, frame.constData() + HeaderSize, header.nameLength);
+    memcpy(data + payloadOffset, compressed.constData(), compressed.size());
+    return result;
+}
+
+void setCompressionEnabled(bool enabled)
+{
+    s_compressionEnabled.storeRelaxed(enabled ? 1 : 0);
+}
+
+bool isCompressionEnabled()
+{
+    return s_compressionEnabled.loadRelaxed() != 0;
+}
+
+void setCompressionThreshold(int bytes)
+{
+    s_compressionThreshold.storeRelaxed(qMax(bytes, 0));
+}
+
+int compressionThreshold()
+{
+    return s_compressionThreshold.loadRelaxed();
+}
+
+CompressionStatistics compressionStatistics()
+{
+    CompressionStatistics statistics;
+    statistics.compressedFrames = s_compressedFrames.loadRelaxed();
+    statistics.skippedFrames = s_skippedFrames.loadRelaxed();
+    statistics.rawBytes = s_rawBytes.loadRelaxed();
+    statistics.wireBytes = s_wireBytes.loadRelaxed();
+    statistics.compressNsecs = s_compressNsecs.loadRelaxed();
+    statistics.decompressedFrames = s_decompressedFrames.loadRelaxed();
+    statistics.decompressNsecs = s_decompressNsecs.loadRelaxed();
+    return statistics;
+}
+
+quint64 checksumFailures()
+{
+    return s_checksumFailures.loadRelaxed();
+}
+
+}
@@ -0,0 +1,176 @@
+#ifndef FRAMEPROTOCOL_H
+#define FRAMEPROTOCOL_H
+
+#include <QByteArray>
+#include <QIODevice>
+
+// 서버/클라이언트가 주고받는 binary frame 형식
+//
+//  offset  size  field
+//  0       2     magic        (0x5143, 'QC')
+//  2       1     version
+//  3       1     type         (FrameType)
+//  4       1     flags        (FrameFlag)
+//  5       1     reserved     (0)
+//  6       2     nameLength   이름(UTF-8) 길이
+//  8       4     streamId     첨부파일 전송 식별자(메시지는 history sequence, 기록하지 않은 메시지는 0)
+//  12      4     payloadLength
+//  16      ..    name[nameLength]
+//  ..      ..    payload[payloadLength]
+//
+// 모든 정수는 big-endian
+namespace FrameProtocol
+{
+    constexpr quint16 Magic = 0x5143;
+    constexpr quint8 Version = 1;
+    constexpr int HeaderSize = 16;
+    // 한 frame의 payload 최대 크기(첨부파일은 chunk로 나뉘므로 이보다 훨씬 작음)
+    constexpr quint32 MaxPayloadLength = 16 * 1024 * 1024;
+    // header + 이름 + payload의 최대 크기
+    constexpr qint64 MaxFrameSize = HeaderSize + 0xFFFF + MaxPayloadLength;
+    // 이어받기 key 크기(SHA-1)
+    constexpr int ResumeKeySize = 20;
+    // 첨부파일 내용 hash 크기(SHA-256)
+    constexpr int ContentHashSize = 32;
+
+    enum class FrameType : quint8
+    {
+        Message          = 1,    // name : 보낸 쪽(비어 있으면 서버), payload : 메시지(UTF-8)
+        AttachmentStart  = 2,    // name : 파일 이름, payload : 파일 크기(quint64) [+ 이어받기 key [+ 내용 hash]]
+        AttachmentChunk  = 3,    // payload : 파일 데이터
+        AttachmentEnd    = 4,    // payload : [파일 전체의 CRC32C(quint32)]
+        Ping             = 5,    // payload : 보낸 쪽이 정한 임의의 값(그대로 Pong으로 돌아옴)
+        Pong             = 6,
+        AttachmentResume = 7,   // 수신 측 -> 송신 측, payload : 이미 받은 바이트 수(quint64)
+        Hello            = 8,   // 연결 직후 양쪽이 한 번씩 보냄, payload : 지원 기능(Capability) bitmask(quint32)
+        HistoryRequest   = 9,   // 클라이언트 -> 서버, payload : 시작 sequence(quint32) + 최대 개수(quint32)
+        Join             = 10,  // 클라이언트 -> 서버, name : room
+        Leave            = 11,  // 클라이언트 -> 서버, name : room
+        Publish          = 12   // name : room, payload : 보낸 쪽 + 메시지(encodeRoomMessage)
+    };
+
+    enum FrameFlag : quint8
+    {
+        FlagCompressed = 0x01,  // payload가 qCompress(zlib)로 압축됨(이름은 압축하지 않음)
+        FlagChecksum   = 0x02   // payload 끝 4바이트가 앞부분의 CRC32C(압축 전에 붙이므로 압축을 푼 뒤 확인)
+    };
+
+    // Hello로 알리는 지원 기능
+    // 상대가 알린 기능만 사용하므로 Hello를 보내지 않는 이전 버전과도 그대로 통신됨
+    enum Capability : quint32
+    {
+        CapCompression = 0x01,  // FlagCompressed frame 수신 가능
+        CapHistory     = 0x02,  // HistoryRequest 처리 가능(서버가 메시지 기록을 켰을 때)
+        CapRooms       = 0x04,  // Join/Leave/Publish 처리 가능
+        CapChecksum    = 0x08   // FlagChecksum frame 수신 가능
+    };
+
+    // room 이름(UTF-8) 최대 길이
+    constexpr int MaxRoomNameLength = 255;
+
+    struct FrameHeader
+    {
+        FrameType type = FrameType::Message;
+        quint8 flags = 0;
+        quint16 nameLength = 0;
+        quint32 streamId = 0;
+        quint32 payloadLength = 0;
+
+        qint64 frameSize() const { return HeaderSize + nameLength + payloadLength; }
+    };
+
+    struct Frame
+    {
+        FrameHeader header;
+        QByteArray name;
+        QByteArray payload;
+    };
+
+    enum class DecodeResult { Ok, NeedMoreData, Invalid };
+
+    // header와 이름, payload를 한 번의 할당으로 frame에 담아 반환
+    // flags에 FlagChecksum이 있으면 payload 뒤에 CRC32C를 붙임
+    QByteArray encodeFrame(FrameType type, quint32 streamId, const QByteArray& name, const QByteArray& payload, quint8 flags = 0);
+
+    // payload 없이 header만 인코딩(payload는 sendfile 등으로 따로 전송할 때 사용)
+    QByteArray encodeHeader(FrameType type, quint32 streamId, quint32 payloadLength, quint8 flags = 0);
+
+    // data 앞부분의 header만 해석(메모리 할당 없음)
+    DecodeResult decodeHeader(const char* data, qint64 size, FrameHeader* header);
+
+    // device에 완성된 frame이 있으면 읽어서 frame에 담음
+    // frame이 다 도착하지 않았으면 device에서 아무것도 읽지 않고 NeedMoreData 반환
+    // FlagChecksum frame은 CRC32C를 확인하여 떼어낸 payload를 담고, 맞지 않으면 Invalid 반환
+    DecodeResult readFrame(QIODevice* device, Frame* frame);
+
+    // readFrame과 같은 해석을 메모리 버퍼에 대해 수행(소켓/화면과 무관하게 benchmark, fuzzing에 사용)
+    // Ok이면 frameSize에 data에서 차지한 바이트 수를 담음(그 외의 결과에서는 frame 내용을 사용하지 않아야 함)
+    // 임의의 입력에도 size를 넘어 읽지 않으며, 결과는 항상 Ok, NeedMoreData, Invalid 중 하나
+    DecodeResult decodeFrame(const char* data, qint64 size, Frame* frame, qint64* frameSize);
+
+    // AttachmentStart payload(파일 크기), AttachmentResume payload(offset) 변환
+    QByteArray encodeFileSize(qint64 fileSize);
+    qint64 decodeFileSize(const QByteArray& payload);
+
+    // AttachmentStart payload의 이어받기 key
+    // key가 있으면 수신 측은 AttachmentResume으로 이미 받은 바이트 수를 알려주고,
+    // 송신 측은 그 응답을 받은 뒤 해당 offset부터 chunk를 보냄(key가 없으면 바로 처음부터 보냄)
+    // 내용 hash는 key 뒤에 붙음 : 수신 측이 같은 내용을 캐시에 갖고 있으면 파일 크기를 offset으로 알려
+    // 송신 측이 chunk 없이 end frame만 보내게 함
+    // 수신 측이 전송 도중 거절할 때도 파일 크기를 AttachmentResume으로 보내 남은 chunk를 건너뛰게 함
+    QByteArray encodeAttachmentStart(qint64 fileSize, const QByteArray& resumeKey, const QByteArray& contentHash = QByteArray());
+    QByteArray decodeResumeKey(const QByteArray& payload);
+    QByteArray decodeContentHash(const QByteArray& payload);
+
+    // AttachmentEnd payload(파일 전체의 CRC32C) 변환, 없으면(이전 버전 송신 측) -1
+    // payload가 없는 end frame도 그대로 처리되므로 상대의 지원 여부와 관계없이 붙임
+    QByteArray encodeFileChecksum(quint32 checksum);
+    qint64 decodeFileChecksum(const QByteArray& payload);
+
+    // Hello payload 변환, 이 프로세스가 지원하는 기능(압축을 끄면 CapCompression 제외)
+    QByteArray encodeHello(quint32 capabilities);
+    quint32 decodeHello(const QByteArray& payload);
+    quint32 localCapabilities();
+
+    // HistoryRequest payload 변환
+    // sinceSequence 이후(포함) 기록된 메시지 중 마지막 limit개를 요청(limit이 0이면 전부)
+    // "마지막 N개"는 sinceSequence 0, "X 이후 전부"는 limit 0으로 요청
+    QByteArray encodeHistoryRequest(quint32 sinceSequence, quint32 limit);
+    bool decodeHistoryRequest(const QByteArray& payload, quint32* sinceSequence, quint32* limit);
+
+    // Publish payload 변환 : 보낸 쪽 길이(quint16) + 보낸 쪽(UTF-8) + 메시지(UTF-8)
+    // 클라이언트는 보낸 쪽을 비워서 보내고, 서버가 연결 ID로 채워 room 구독자에게 보냄
+    QByteArray encodeRoomMessage(const QByteArray& sender, const QByteArray& text);
+    bool decodeRoomMessage(const QByteArray& payload, QByteArray* sender, QByteArray* text);
+
+    // 인코딩된 frame의 payload를 압축한 frame 반환
+    // payload가 threshold보다 작거나, 이미 압축되었거나, 압축해도 줄지 않으면 frame을 그대로 반환
+    // broadcast는 한 번만 압축하여 CapCompression을 알린 모든 수신자에게 같은 frame을 보냄
+    QByteArray compressFrame(const QByteArray& frame);
+
+    // 압축 설정(프로세스 전체, 기본값 : 사용, threshold 256 바이트)
+    void setCompressionEnabled(bool enabled);
+    bool isCompressionEnabled();
+    void setCompressionThreshold(int bytes);
+    int compressionThreshold();
+
+    // 압축 효과와 비용(프로세스 전체 누적)
+    struct CompressionStatistics
+    {
+        quint64 compressedFrames = 0;   // 압축해서 보낸 frame 수
+        quint64 skippedFrames = 0;      // threshold 이상이지만 줄지 않아 그대로 보낸 frame 수
+        quint64 rawBytes = 0;           // 압축한 frame의 원래 payload 크기 합
+        quint64 wireBytes = 0;          // 압축한 frame의 압축 후 payload 크기 합
+        quint64 compressNsecs = 0;      // 압축에 쓴 시간(실패한 압축 포함)
+        quint64 decompressedFrames = 0;
+        quint64 decompressNsecs = 0;
+
+        qint64 savedBytes() const { return static_cast<qint64>(rawBytes) - static_cast<qint64>(wireBytes); }
+    };
+    CompressionStatistics compressionStatistics();
+
+    // CRC32C가 맞지 않아 버린 frame 수(프로세스 전체 누적)
+    quint64 checksumFailures();
+}
+
+#endif // FRAMEPROTOCOL_H
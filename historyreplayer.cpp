@@ -0,0 +1,100 @@
+#include "historyreplayer.h"
+#include "messagehistory.h"
+#include "outboundqueue.h"
+#include "streamsocket.h"
+
+HistoryReplayer::HistoryReplayer(QIODevice* socket, const QSharedPointer<MessageHistory>& history, quint32 sinceSequence, quint32 limit)
+    : QObject(socket), m_socket(socket), m_history(history), m_sinceSequence(sinceSequence), m_limit(limit)
+{
+}
+
+HistoryReplayer* HistoryReplayer::find(QIODevice* socket)
+{
+    foreach (HistoryReplayer* replayer, socket->findChildren<HistoryReplayer*>(QString(), Qt::FindDirectChildrenOnly))
+    {
+        if(!replayer->m_finished)
+            return replayer;
+    }
+    return nullptr;
+}
+
+void HistoryReplayer::start()
+{
+    m_queue = OutboundQueue::of(m_socket);
+
+    // 요청 범위 : sinceSequence 이후 중 마지막 limit개
+    m_lastSequence = m_history->lastSequence();
+    m_nextSequence = qMax(m_sinceSequence, m_history->firstSequence());
+    if(m_limit > 0 && m_lastSequence >= m_limit)
+        m_nextSequence = qMax(m_nextSequence, m_lastSequence - m_limit + 1);
+
+    if(!m_queue || m_lastSequence == 0 || m_nextSequence > m_lastSequence)
+    {
+        finish();
+        return;
+    }
+
+    // 소켓 송신 버퍼가 비워지거나 일시 정지가 풀릴 때마다 다음 범위 전송
+    connect(m_socket, &QIODevice::bytesWritten, this, &HistoryReplayer::slot_sendNext);
+    connect(m_queue, &OutboundQueue::signal_resumed, this, &HistoryReplayer::slot_sendNext);
+    StreamSocket::connectDisconnected(m_socket, this, &HistoryReplayer::finish);
+
+    slot_sendNext();
+}
+
+void HistoryReplayer::slot_sendNext()
+{
+    while(!m_finished && m_queue->pendingBytes() < MaxPendingBytes && !m_queue->isPaused())
+    {
+        MessageHistory::Range range;
+        if(!m_history->locate(m_nextSequence, m_lastSequence, ReadSize, &range))
+        {
+            finish();
+            return;
+        }
+
+        // segment가 바뀔 때만 파일을 다시 엶
+        if(m_segment.fileName() != range.segmentPath || !m_segment.isOpen())
+        {
+            m_segment.close();
+            m_segment.setFileName(range.segmentPath);
+            if(!m_segment.open(QIODevice::ReadOnly))
+            {
+                // 그 사이 오래된 segment가 지워졌으면 다음 locate에서 남은 segment부터 찾음
+                m_nextSequence = range.lastSequence + 1;
+                continue;
+            }
+        }
+
+        const qint64 length = range.end - range.begin;
+        QByteArray frames;
+        if(m_segment.seek(range.begin))
+            frames = m_segment.read(length);
+        if(frames.size() != length)
+        {
+            finish();
+            return;
+        }
+
+        // 메시지 경계에서 자른 범위이므로 여러 frame을 한 덩어리로 넣어도 다른 frame과 섞이지 않음
+        // 첨부파일처럼 bulk 대기열로 보내 재생 중에도 실시간 메시지가 기록 뒤에서 기다리지 않게 함
+        m_queue->enqueueBulk(frames, OutboundQueue::ReplayStream);
+
+        if(range.lastSequence >= m_lastSequence)
+        {
+            finish();
+            return;
+        }
+        m_nextSequence = range.lastSequence + 1;
+    }
+}
+
+void HistoryReplayer::finish()
+{
+    if(m_finished)
+        return;
+
+    m_finished = true;
+    m_segment.close();
+    deleteLater();
+}
@@ -0,0 +1,56 @@
+#ifndef HISTORYREPLAYER_H
+#define HISTORYREPLAYER_H
+
+#include <QObject>
+#include <QFile>
+#include <QSharedPointer>
+#include <QIODevice>
+
+class MessageHistory;
+class OutboundQueue;
+
+// 클라이언트의 HistoryRequest에 따라 기록된 메시지를 segment 파일에서 읽어 소켓으로 보내는 클래스
+// segment에는 Message frame이 그대로 기록되어 있으므로 메시지 경계에 맞춘 범위(ReadSize 이하)를
+// 한 번에 읽어 인코딩 없이 송신 대기열에 넣음
+// AttachmentSender처럼 대기열이 MaxPendingBytes 아래로 내려갈 때마다 다음 범위를 읽으므로
+// 기록 크기와 관계없이 메모리 사용량이 일정하고, 재생 중에도 다른 소켓/메시지 처리가 멈추지 않음
+//
+// 요청 시점의 마지막 sequence까지만 보냄(이후 메시지는 실시간으로 전달됨)
+// 소켓의 자식 객체로 생성되며 재생이 끝나거나 연결이 끊어지면 스스로 삭제됨
+// 송신 대기열 제한(MaxPendingBytes)은 replayer마다 적용되므로 소켓마다 하나만 재생함(find로 확인)
+class HistoryReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    // 한 번에 읽는 최대 크기
+    static constexpr qint64 ReadSize = 64 * 1024;
+    // socket 송신 대기열에 쌓아둘 최대 크기
+    static constexpr qint64 MaxPendingBytes = 4 * ReadSize;
+
+    HistoryReplayer(QIODevice* socket, const QSharedPointer<MessageHistory>& history, quint32 sinceSequence, quint32 limit);
+
+    // 재생할 범위를 정하고 전송 시작
+    void start();
+
+    // socket에서 재생 중인 replayer를 찾음
+    static HistoryReplayer* find(QIODevice* socket);
+
+private slots:
+    void slot_sendNext();
+
+private:
+    void finish();
+
+    QIODevice* m_socket;
+    OutboundQueue* m_queue = nullptr;
+    QSharedPointer<MessageHistory> m_history;
+    QFile m_segment;
+    quint32 m_sinceSequence;
+    quint32 m_limit;
+    // 다음에 보낼 sequence, 마지막으로 보낼 sequence
+    quint32 m_nextSequence = 0;
+    quint32 m_lastSequence = 0;
+    bool m_finished = false;
+};
+
+#endif // HISTORYREPLAYER_H
@@ -0,0 +1,320 @@
+#include "messagehistory.h"
+#include "frameprotocol.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+
+static constexpr qint64 IndexBytes = MessageHistory::SegmentRecords * static_cast<qint64>(sizeof(quint64));
+
+MessageHistory::MessageHistory(const QString& directory, int maxSegments)
+    : m_directory(directory), m_maxSegments(qMax(1, maxSegments))
+{
+    // 기록 순서를 지키도록 writer thread는 하나만 사용
+    m_writerPool.setMaxThreadCount(1);
+}
+
+MessageHistory::~MessageHistory()
+{
+    // 대기열에 남은 frame을 모두 기록한 뒤 닫음
+    m_writerPool.waitForDone();
+    m_writer.close();
+    foreach (Segment* segment, m_segments)
+        closeSegment(segment, false);
+}
+
+QString MessageHistory::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
+
+void MessageHistory::setError(const QString& errorString)
+{
+    QMutexLocker locker(&m_mutex);
+    m_errorString = errorString;
+}
+
+bool MessageHistory::open()
+{
+    QDir dir(m_directory);
+    if(!dir.mkpath("."))
+    {
+        setError(QString("Unable to create history directory %1").arg(m_directory));
+        return false;
+    }
+
+    // open은 기록/조회를 시작하기 전에 호출하므로 segment를 모두 연 뒤 한 번에 넘김
+    // 파일 이름이 0으로 채운 첫 sequence이므로 이름 순서가 곧 sequence 순서
+    QVector<Segment*> segments;
+    foreach (const QString& fileName, dir.entryList(QStringList() << "*.log", QDir::Files, QDir::Name))
+    {
+        bool ok = false;
+        const quint32 firstSequence = QFileInfo(fileName).completeBaseName().toUInt(&ok);
+        if(!ok || firstSequence == 0)
+            continue;
+
+        // index가 없거나 열 수 없는 segment는 건너뜀
+        if(Segment* segment = openSegment(firstSequence))
+            segments.append(segment);
+    }
+
+    const bool opened = segments.isEmpty() || openWriter(segments.last());
+    const quint32 nextSequence = segments.isEmpty() ? 1 : segments.last()->firstSequence + static_cast<quint32>(segments.last()->count);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_segments = segments;
+        m_writtenSequence = nextSequence - 1;
+    }
+
+    QMutexLocker locker(&m_pendingMutex);
+    m_pendingSequence = nextSequence;
+    m_nextSequence = nextSequence;
+    return opened;
+}
+
+MessageHistory::Segment* MessageHistory::openSegment(quint32 firstSequence)
+{
+    const QString baseName = QString("%1/%2").arg(m_directory).arg(firstSequence, 10, 10, QChar('0'));
+
+    Segment* segment = new Segment;
+    segment->firstSequence = firstSequence;
+    segment->logPath = baseName + ".log";
+    segment->index = new QFile(baseName + ".idx");
+
+    // 새 index는 0으로 채운 고정 크기 파일
+    if(!segment->index->open(QIODevice::ReadWrite)
+            || (segment->index->size() != IndexBytes && !segment->index->resize(IndexBytes)))
+    {
+        closeSegment(segment, false);
+        return nullptr;
+    }
+
+    uchar* map = segment->index->map(0, IndexBytes);
+    if(!map)
+    {
+        closeSegment(segment, false);
+        return nullptr;
+    }
+    segment->ends = reinterpret_cast<quint64*>(map);
+
+    // 기록된 항목은 앞에서부터 0이 아닌 값으로 채워짐
+    const quint64* end = std::find(segment->ends, segment->ends + SegmentRecords, quint64(0));
+    segment->count = static_cast<int>(end - segment->ends);
+    return segment;
+}
+
+void MessageHistory::closeSegment(Segment* segment, bool remove)
+{
+    // QFile 소멸 시 map도 해제됨
+    if(remove)
+    {
+        segment->index->remove();
+        QFile::remove(segment->logPath);
+    }
+    delete segment->index;
+    delete segment;
+}
+
+bool MessageHistory::openWriter(Segment* segment)
+{
+    m_writer.close();
+    m_writer.setFileName(segment->logPath);
+    if(!m_writer.open(QIODevice::ReadWrite))
+    {
+        setError(QString("Unable to open history segment %1: %2").arg(segment->logPath, m_writer.errorString()));
+        return false;
+    }
+
+    // 비정상 종료로 log에 끝까지 기록되지 못한 메시지는 index에서 지움
+    while(segment->count > 0 && static_cast<qint64>(segment->ends[segment->count - 1]) > m_writer.size())
+        segment->ends[--segment->count] = 0;
+
+    // index에 기록되지 못한 log 뒷부분은 잘라냄
+    const qint64 size = segment->size();
+    if((m_writer.size() != size && !m_writer.resize(size)) || !m_writer.seek(size))
+    {
+        setError(QString("Unable to recover history segment %1: %2").arg(segment->logPath, m_writer.errorString()));
+        m_writer.close();
+        return false;
+    }
+    return true;
+}
+
+MessageHistory::Segment* MessageHistory::roll(quint32 sequence)
+{
+    Segment* segment = openSegment(sequence);
+    if(!segment)
+    {
+        setError(QString("Unable to create history segment in %1").arg(m_directory));
+        return nullptr;
+    }
+
+    // 이전 실행에서 같은 이름으로 남은 파일이 있으면 비우고 새로 시작
+    if(segment->count > 0)
+    {
+        std::fill(segment->ends, segment->ends + segment->count, quint64(0));
+        segment->count = 0;
+    }
+
+    if(!openWriter(segment))
+    {
+        closeSegment(segment, true);
+        return nullptr;
+    }
+
+    // 오래된 segment는 목록에서만 빼고 파일은 잠금 밖에서 지움
+    // (재생 중인 HistoryReplayer는 다음 locate에서 남은 segment로 넘어감)
+    QVector<Segment*> removed;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_segments.append(segment);
+        while(m_segments.size() > m_maxSegments)
+            removed.append(m_segments.takeFirst());
+    }
+    foreach (Segment* old, removed)
+        closeSegment(old, true);
+    return segment;
+}
+
+QByteArray MessageHistory::append(const QByteArray& sender, const QByteArray& text)
+{
+    QMutexLocker locker(&m_pendingMutex);
+
+    // sequence 순서대로 대기열에 들어가도록 잠근 채 인코딩
+    const QByteArray frame = FrameProtocol::encodeFrame(FrameProtocol::FrameType::Message, m_nextSequence, sender, text);
+    m_pending.append(frame);
+    ++m_nextSequence;
+
+    // writer가 대기열을 비우는 중이면 이어서 기록하므로 새로 예약하지 않음
+    if(!m_writeScheduled)
+    {
+        m_writeScheduled = true;
+        m_writerPool.start([this]() { writePending(); });
+    }
+    return frame;
+}
+
+void MessageHistory::writePending()
+{
+    forever
+    {
+        QVector<QByteArray> frames;
+        quint32 sequence = 0;
+        {
+            QMutexLocker locker(&m_pendingMutex);
+            if(m_pending.isEmpty())
+            {
+                m_writeScheduled = false;
+                return;
+            }
+            frames.swap(m_pending);
+            sequence = m_pendingSequence;
+            m_pendingSequence += static_cast<quint32>(frames.size());
+        }
+        writeFrames(sequence, frames);
+    }
+}
+
+void MessageHistory::writeFrames(quint32 sequence, const QVector<QByteArray>& frames)
+{
+    int next = 0;
+    while(next < frames.size())
+    {
+        Segment* segment = prepareWriter(sequence);
+        if(!segment)
+            return;
+
+        // 이 segment에 들어가는 만큼 묶어서 한 번에 기록
+        QByteArray batch;
+        QVector<quint64> ends;
+        qint64 size = segment->size();
+        while(next < frames.size() && segment->count + ends.size() < SegmentRecords && size < SegmentMaxBytes)
+        {
+            const QByteArray& frame = frames.at(next++);
+            batch.append(frame);
+            size += frame.size();
+            ends.append(static_cast<quint64>(size));
+        }
+
+        // log를 먼저 기록한 뒤 index를 갱신하므로 index에 있는 메시지는 항상 log에서 읽을 수 있음
+        if(m_writer.write(batch) != batch.size() || !m_writer.flush())
+        {
+            setError(m_writer.errorString());
+            // 일부만 기록되었을 수 있으므로 닫고, 빠진 sequence 다음부터는 prepareWriter가 새 segment에 기록
+            m_writer.close();
+            return;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        foreach (quint64 end, ends)
+            segment->ends[segment->count++] = end;
+        sequence += static_cast<quint32>(ends.size());
+        m_writtenSequence = sequence - 1;
+    }
+}
+
+MessageHistory::Segment* MessageHistory::prepareWriter(quint32 sequence)
+{
+    // index는 segment 첫 sequence부터 빈틈없이 이어져야 하므로 기록 실패로 sequence가 끊기면 새 segment로 넘어감
+    Segment* segment = m_segments.isEmpty() ? nullptr : m_segments.last();
+    if(!segment || segment->count >= SegmentRecords || segment->size() >= SegmentMaxBytes
+            || segment->firstSequence + static_cast<quint32>(segment->count) != sequence)
+        return roll(sequence);
+
+    // 이전 기록이 실패하여 닫혔으면 log 끝을 다시 맞춤
+    if(!m_writer.isOpen() && !openWriter(segment))
+        return nullptr;
+    return segment;
+}
+
+quint32 MessageHistory::firstSequence() const
+{
+    QMutexLocker locker(&m_mutex);
+    foreach (const Segment* segment, m_segments)
+    {
+        if(segment->count > 0)
+            return segment->firstSequence;
+    }
+    return 0;
+}
+
+quint32 MessageHistory::lastSequence() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_writtenSequence;
+}
+
+bool MessageHistory::locate(quint32 sequence, quint32 lastSequence, qint64 maxBytes, Range* range) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    // sequence를 포함하거나 그 뒤에 오는 첫 segment
+    auto it = std::find_if(m_segments.begin(), m_segments.end(), [sequence](const Segment* segment) {
+        return segment->count > 0 && segment->firstSequence + static_cast<quint32>(segment->count) > sequence;
+    });
+    if(it == m_segments.end())
+        return false;
+
+    const Segment* segment = *it;
+    const quint32 first = qMax(sequence, segment->firstSequence);
+    const quint32 last = qMin(lastSequence, segment->firstSequence + static_cast<quint32>(segment->count) - 1);
+    if(first > last)
+        return false;
+
+    const int firstIndex = static_cast<int>(first - segment->firstSequence);
+    const int lastIndex = static_cast<int>(last - segment->firstSequence);
+    const quint64 begin = firstIndex > 0 ? segment->ends[firstIndex - 1] : 0;
+
+    // 끝 위치는 증가하므로 maxBytes 안에 들어가는 마지막 메시지를 이진 탐색(최소 한 개)
+    const quint64* limit = std::upper_bound(segment->ends + firstIndex + 1, segment->ends + lastIndex + 1, begin + static_cast<quint64>(qMax<qint64>(maxBytes, 0)));
+    const int endIndex = static_cast<int>(limit - segment->ends) - 1;
+
+    range->segmentPath = segment->logPath;
+    range->begin = static_cast<qint64>(begin);
+    range->end = static_cast<qint64>(segment->ends[endIndex]);
+    range->firstSequence = first;
+    range->lastSequence = segment->firstSequence + static_cast<quint32>(endIndex);
+    return true;
+}
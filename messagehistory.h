@@ -0,0 +1,116 @@
+#ifndef MESSAGEHISTORY_H
+#define MESSAGEHISTORY_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+// 서버가 주고받은 채팅 메시지를 디스크에 순서대로 남기는 append-only 기록
+// 새로 접속하거나 다시 접속한 클라이언트가 "마지막 N개" 또는 "sequence X 이후"를 요청하면
+// HistoryReplayer가 segment 파일에서 해당 범위를 그대로 읽어 보냄
+//
+// 메시지마다 1부터 증가하는 sequence를 붙이고, 클라이언트에 보내는 Message frame 그대로
+// (streamId = sequence, name = 보낸 쪽) segment 파일(<첫 sequence>.log)에 이어서 기록함
+// segment마다 index 파일(<첫 sequence>.idx)을 두어 i번째 메시지가 끝나는 위치(quint64)를 저장하고,
+// index는 고정 크기로 만들어 memory-mapped file로 읽고 씀(기록 전 항목은 0)
+// segment가 SegmentRecords개 또는 SegmentMaxBytes를 넘으면 새 segment를 만들고,
+// maxSegments개를 넘는 오래된 segment는 지움
+//
+// append는 sequence를 붙인 frame만 만들어 대기열에 넣고 바로 반환하며,
+// 디스크 기록은 전용 writer thread 하나가 대기열에 모인 frame을 segment별로 묶어 한 번에 write/flush함
+// (worker thread가 디스크 I/O나 segment 교체를 기다리며 서로 막히지 않음)
+// 조회 함수는 디스크에 기록된 메시지만 보여주며, 기록에 실패한 메시지는 기록에서 빠짐
+//
+// 비정상 종료 후 다시 열면 index와 log 크기를 비교하여 끝까지 기록되지 못한 메시지는 버림
+// 모든 함수는 어느 thread에서나 호출할 수 있음(worker thread가 기록/조회를 함께 함)
+class MessageHistory
+{
+public:
+    // segment 하나에 담는 최대 메시지 수(index 파일 크기 = SegmentRecords * 8 바이트)
+    static constexpr int SegmentRecords = 64 * 1024;
+    // segment 하나의 최대 크기
+    static constexpr qint64 SegmentMaxBytes = 64 * 1024 * 1024;
+    static constexpr int DefaultMaxSegments = 16;
+
+    // segment 파일 안에서 연속된 메시지 범위
+    struct Range
+    {
+        QString segmentPath;
+        qint64 begin = 0;
+        qint64 end = 0;
+        quint32 firstSequence = 0;
+        quint32 lastSequence = 0;
+    };
+
+    explicit MessageHistory(const QString& directory, int maxSegments = DefaultMaxSegments);
+    ~MessageHistory();
+
+    // directory의 segment를 열고 마지막 sequence를 복구, 실패하면 false
+    bool open();
+    QString errorString() const;
+
+    // 메시지에 sequence를 붙인 Message frame을 반환하고(그대로 클라이언트에 보내면 됨) 기록은 writer thread에 맡김
+    QByteArray append(const QByteArray& sender, const QByteArray& text);
+
+    // 디스크에 남아있는 가장 오래된/최근 메시지의 sequence(기록이 없으면 0)
+    quint32 firstSequence() const;
+    quint32 lastSequence() const;
+
+    // sequence부터 lastSequence까지 중 한 segment 안에서 이어지는 앞부분을 찾아 range에 담음
+    // range 크기는 maxBytes 이하로 자르되 메시지 하나보다는 작게 자르지 않음
+    // sequence가 지워진 segment에 있었으면 남아있는 다음 메시지부터 찾음, 없으면 false
+    bool locate(quint32 sequence, quint32 lastSequence, qint64 maxBytes, Range* range) const;
+
+private:
+    struct Segment
+    {
+        quint32 firstSequence = 0;
+        int count = 0;
+        QString logPath;
+        QFile* index = nullptr;
+        quint64* ends = nullptr;    // index 파일을 map한 배열 : ends[i] = i번째 메시지가 끝나는 위치
+
+        qint64 size() const { return count > 0 ? static_cast<qint64>(ends[count - 1]) : 0; }
+    };
+
+    Segment* openSegment(quint32 firstSequence);
+    void closeSegment(Segment* segment, bool remove);
+    // segment를 기록용으로 열어 log 끝을 index와 맞춤
+    bool openWriter(Segment* segment);
+
+    // 아래는 writer thread에서만 호출
+    // 대기열이 빌 때까지 frame을 꺼내 기록
+    void writePending();
+    // sequence부터 이어지는 frame들을 기록, 실패하면 남은 frame은 버림
+    void writeFrames(quint32 sequence, const QVector<QByteArray>& frames);
+    // sequence를 이어서 기록할 segment를 준비(가득 찼거나 sequence가 끊겼으면 새 segment)
+    Segment* prepareWriter(quint32 sequence);
+    // sequence로 시작하는 새 segment로 넘어가고 오래된 segment 정리
+    Segment* roll(quint32 sequence);
+    void setError(const QString& errorString);
+
+    const QString m_directory;
+    const int m_maxSegments;
+
+    // m_segments 목록과 각 segment의 count/ends, 기록된 sequence를 보호
+    // (writer thread는 자기가 바꾸는 값을 읽을 때는 잠그지 않음)
+    mutable QMutex m_mutex;
+    QVector<Segment*> m_segments;   // sequence 순서
+    quint32 m_writtenSequence = 0;
+    QString m_errorString;
+
+    // 기록 대기열
+    QMutex m_pendingMutex;
+    QVector<QByteArray> m_pending;
+    quint32 m_pendingSequence = 1;  // m_pending 첫 frame의 sequence
+    quint32 m_nextSequence = 1;
+    bool m_writeScheduled = false;
+
+    QThreadPool m_writerPool;       // thread 하나만 사용
+    QFile m_writer;                 // writer thread 전용 : 마지막 segment의 log
+};
+
+#endif // MESSAGEHISTORY_H
@@ -0,0 +1,114 @@
+#include "messagelogmodel.h"
+
+MessageLogModel::MessageLogModel(int capacity, QObject* parent)
+    : QAbstractListModel(parent), m_capacity(qMax(1, capacity)), m_entries(m_capacity)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FlushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &MessageLogModel::slot_flush);
+}
+
+int MessageLogModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_size;
+}
+
+QVariant MessageLogModel::data(const QModelIndex& index, int role) const
+{
+    if(role != Qt::DisplayRole || !index.isValid() || index.row() >= m_size)
+        return QVariant();
+
+    const Entry& entry = m_entries.at(slotOf(index.row()));
+    if(entry.repeat > 1)
+        return QString("%1 (x%2)").arg(entry.text).arg(entry.repeat);
+    return entry.text;
+}
+
+void MessageLogModel::append(const QString& message)
+{
+    // 직전 줄과 같으면 반복 횟수만 증가
+    if(!m_pending.isEmpty() && m_pending.last().text == message)
+        ++m_pending.last().repeat;
+    else
+    {
+        // 한 flush 사이에 많이 쌓이면 화면에 남지 못할 오래된 줄은 capacity 단위로 한 번에 버림
+        if(m_pending.size() >= 2 * m_capacity)
+            m_pending.remove(0, m_pending.size() - m_capacity);
+        m_pending.append(Entry{message, 1});
+    }
+
+    if(!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void MessageLogModel::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if(capacity == m_capacity)
+        return;
+
+    // 최근 줄만 남겨 새 크기의 ring buffer로 옮김
+    beginResetModel();
+    const int kept = qMin(m_size, capacity);
+    QVector<Entry> entries(capacity);
+    for(int row = 0; row < kept; ++row)
+        entries[row] = m_entries.at(slotOf(m_size - kept + row));
+    m_entries = entries;
+    m_capacity = capacity;
+    m_head = 0;
+    m_size = kept;
+    endResetModel();
+}
+
+void MessageLogModel::clear()
+{
+    beginResetModel();
+    m_entries = QVector<Entry>(m_capacity);
+    m_head = 0;
+    m_size = 0;
+    m_pending.clear();
+    endResetModel();
+}
+
+void MessageLogModel::slot_flush()
+{
+    if(m_pending.isEmpty())
+        return;
+
+    QVector<Entry> pending;
+    pending.swap(m_pending);
+    if(pending.size() > m_capacity)
+        pending.remove(0, pending.size() - m_capacity);
+
+    // 마지막 줄과 이어지는 같은 줄은 합침
+    int first = 0;
+    if(m_size > 0 && lastEntry().text == pending.first().text)
+    {
+        lastEntry().repeat += pending.first().repeat;
+        const QModelIndex last = index(m_size - 1);
+        emit dataChanged(last, last, {Qt::DisplayRole});
+        first = 1;
+    }
+
+    const int count = pending.size() - first;
+    if(count == 0)
+        return;
+
+    // capacity를 넘기는 만큼 오래된 줄을 한 번에 제거
+    const int overflow = m_size + count - m_capacity;
+    if(overflow > 0)
+    {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        m_head = slotOf(overflow);
+        m_size -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_size, m_size + count - 1);
+    for(int i = first; i < pending.size(); ++i)
+    {
+        m_entries[slotOf(m_size)] = pending.at(i);
+        ++m_size;
+    }
+    endInsertRows();
+}
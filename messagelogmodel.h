@@ -0,0 +1,58 @@
+#ifndef MESSAGELOGMODEL_H
+#define MESSAGELOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+// 화면에 표시할 로그를 최근 capacity 줄만 보관하는 ring buffer model
+// append는 대기 목록에 넣기만 하고, FlushInterval마다 한 번에 model에 반영하므로
+// 메시지가 아무리 많이 들어와도 화면 갱신은 초당 약 30번으로 제한됨
+// 연속으로 같은 줄(수신 대기 등 진행 상황)이 들어오면 한 줄로 합치고 반복 횟수만 표시
+class MessageLogModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    static constexpr int DefaultCapacity = 10000;
+    static constexpr int FlushInterval = 33;    // ms
+
+    explicit MessageLogModel(int capacity = DefaultCapacity, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    // 로그 한 줄 추가(어느 thread에서든 signal로 전달받아 GUI thread에서 호출)
+    void append(const QString& message);
+
+    int capacity() const { return m_capacity; }
+    // 줄 수 제한 변경, 넘치는 오래된 줄은 버림
+    void setCapacity(int capacity);
+
+    void clear();
+
+private slots:
+    void slot_flush();
+
+private:
+    struct Entry
+    {
+        QString text;
+        int repeat = 1;
+    };
+
+    // row번째(가장 오래된 줄이 0) 줄의 ring buffer 위치
+    int slotOf(int row) const { return (m_head + row) % m_capacity; }
+    Entry& lastEntry() { return m_entries[slotOf(m_size - 1)]; }
+
+    int m_capacity;
+    QVector<Entry> m_entries;   // 크기 m_capacity의 ring buffer
+    int m_head = 0;             // 가장 오래된 줄의 위치
+    int m_size = 0;
+
+    // 다음 flush까지 모아둔 줄(같은 줄이 연속되면 반복 횟수만 증가)
+    QVector<Entry> m_pending;
+    QTimer m_flushTimer;
+};
+
+#endif // MESSAGELOGMODEL_H
@@ -0,0 +1,47 @@
+#include "messagelogview.h"
+
+#include <QLayout>
+#include <QScrollBar>
+
+MessageLogView::MessageLogView(QWidget* parent) : QListView(parent)
+{
+    // 줄 높이가 모두 같다고 알려 보이는 줄만 계산하도록 함
+    setUniformItemSizes(true);
+    setSelectionMode(QAbstractItemView::ExtendedSelection);
+    setEditTriggers(QAbstractItemView::NoEditTriggers);
+    setWordWrap(false);
+}
+
+void MessageLogView::setModel(QAbstractItemModel* model)
+{
+    if(this->model())
+        this->model()->disconnect(this);
+
+    QListView::setModel(model);
+    if(!model)
+        return;
+
+    // 새 줄이 추가되기 직전에 맨 아래를 보고 있었는지 기록해 두었다가 추가 후 따라 내려감
+    connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this, [this]() {
+        m_followTail = verticalScrollBar()->value() == verticalScrollBar()->maximum();
+    });
+    connect(model, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if(m_followTail)
+            scrollToBottom();
+    });
+}
+
+MessageLogView* MessageLogView::replace(QWidget* widget, QAbstractItemModel* model)
+{
+    MessageLogView* view = new MessageLogView(widget->parentWidget());
+    view->setModel(model);
+
+    // layout 안의 같은 자리에 넣고 기존 위젯은 숨김
+    if(widget->parentWidget() && widget->parentWidget()->layout())
+        widget->parentWidget()->layout()->replaceWidget(widget, view);
+    else
+        view->setGeometry(widget->geometry());
+    widget->hide();
+    view->show();
+    return view;
+}
@@ -0,0 +1,23 @@
+#ifndef MESSAGELOGVIEW_H
+#define MESSAGELOGVIEW_H
+
+#include <QListView>
+
+// MessageLogModel을 표시하는 list view
+// 보이는 줄만 그리고(uniform item size), 맨 아래를 보고 있을 때만 새 줄을 따라 내려감
+class MessageLogView : public QListView
+{
+    Q_OBJECT
+public:
+    explicit MessageLogView(QWidget* parent = nullptr);
+
+    void setModel(QAbstractItemModel* model) override;
+
+    // 기존 위젯(.ui의 QTextBrowser 등) 자리에 log view를 넣음
+    static MessageLogView* replace(QWidget* widget, QAbstractItemModel* model);
+
+private:
+    bool m_followTail = true;
+};
+
+#endif // MESSAGELOGVIEW_H
@@ -0,0 +1,76 @@
+#include "metricsendpoint.h"
+#include "servermetrics.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+
+MetricsEndpoint::MetricsEndpoint(QObject* parent) : QTcpServer(parent)
+{
+}
+
+void MetricsEndpoint::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket* socket = new QTcpSocket(this);
+    if(!socket->setSocketDescriptor(socketDescriptor))
+    {
+        delete socket;
+        return;
+    }
+
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+        respond(socket);
+    });
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    // 요청을 끝내지 않는 연결이 남지 않도록 함
+    QTimer::singleShot(RequestTimeout, socket, &QTcpSocket::abort);
+}
+
+void MetricsEndpoint::respond(QTcpSocket* socket)
+{
+    // 빈 줄까지(요청 header 끝) 받은 뒤에 응답
+    const QByteArray request = socket->peek(MaxRequestSize);
+    if(!request.contains("\r\n\r\n"))
+    {
+        if(socket->bytesAvailable() >= MaxRequestSize)
+            socket->abort();
+        return;
+    }
+    socket->readAll();
+    socket->disconnect(this);
+
+    // 요청 행 : <method> <path> <version>
+    const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    const QByteArray method = requestLine.value(0);
+    const QByteArray path = requestLine.value(1);
+
+    QByteArray status = "200 OK";
+    QByteArray contentType;
+    QByteArray body;
+    if(method != "GET")
+    {
+        status = "405 Method Not Allowed";
+        contentType = "text/plain";
+    }
+    else if(path == "/metrics")
+    {
+        contentType = "text/plain; version=0.0.4";
+        body = ServerMetrics::toPrometheus();
+    }
+    else if(path == "/metrics.json")
+    {
+        contentType = "application/json";
+        body = ServerMetrics::toJson();
+    }
+    else
+    {
+        status = "404 Not Found";
+        contentType = "text/plain";
+    }
+
+    socket->write("HTTP/1.1 " + status + "\r\n"
+                  "Content-Type: " + contentType + "\r\n"
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  "Connection: close\r\n\r\n");
+    socket->write(body);
+    socket->disconnectFromHost();
+}
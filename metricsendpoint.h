@@ -0,0 +1,28 @@
+#ifndef METRICSENDPOINT_H
+#define METRICSENDPOINT_H
+
+#include <QTcpServer>
+
+// ServerMetrics를 HTTP로 내보내는 작은 서버(수집기가 주기적으로 가져감)
+//   GET /metrics       Prometheus text exposition format
+//   GET /metrics.json  JSON
+// 요청마다 응답 하나를 보내고 연결을 닫음, 요청 본문과 keep-alive는 지원하지 않음
+// 생성한 thread(보통 main thread)에서 처리하며 chat 연결의 worker thread와는 관계없음
+class MetricsEndpoint : public QTcpServer
+{
+    Q_OBJECT
+public:
+    // 요청 header 최대 크기, 이 시간 안에 요청이 끝나지 않으면 연결을 닫음
+    static constexpr qint64 MaxRequestSize = 8 * 1024;
+    static constexpr int RequestTimeout = 5000;
+
+    explicit MetricsEndpoint(QObject* parent = nullptr);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    void respond(QTcpSocket* socket);
+};
+
+#endif // METRICSENDPOINT_H
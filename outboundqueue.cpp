@@ -0,0 +1,253 @@
+#include "outboundqueue.h"
+#include "frameprotocol.h"
+#include "streamsocket.h"
+
+// 프로세스 전체 policy 발동 횟수
+static QAtomicInteger<quint64> s_congested;
+static QAtomicInteger<quint64> s_paused;
+static QAtomicInteger<quint64> s_droppedFrames;
+static QAtomicInteger<quint64> s_droppedBytes;
+static QAtomicInteger<quint64> s_disconnected;
+
+void BroadcastBudget::release(qint64 bytes)
+{
+    const qint64 before = m_bytes.fetchAndSubOrdered(bytes);
+    const qint64 after = before - bytes;
+
+    // limit의 절반을 넘었다가 내려오는 순간에만 알림(매 frame마다 signal이 쌓이지 않도록)
+    if(before >= m_limit / 2 && after < m_limit / 2)
+        emit signal_drained();
+}
+
+
+OutboundQueue::OutboundQueue(QIODevice* socket, const Limits& limits) : QObject(socket), m_socket(socket), m_limits(limits)
+{
+    // 소켓 송신 버퍼가 비워질 때마다 대기열의 frame을 이어서 넘김
+    connect(m_socket, &QIODevice::bytesWritten, this, &OutboundQueue::slot_flush);
+}
+
+OutboundQueue::~OutboundQueue()
+{
+    // 보내지 못한 broadcast frame의 몫은 반환하여 송신 측이 멈추지 않도록 함
+    releaseAll(m_interactive);
+    for(auto it = m_bulk.begin(); it != m_bulk.end(); ++it)
+        releaseAll(it.value());
+}
+
+void OutboundQueue::releaseAll(QQueue<Entry>& queue)
+{
+    while(!queue.isEmpty())
+    {
+        Entry entry = queue.dequeue();
+        if(entry.budget)
+            entry.budget->release(entry.frame.size());
+    }
+}
+
+OutboundQueue* OutboundQueue::of(QIODevice* socket)
+{
+    return socket->findChild<OutboundQueue*>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+bool OutboundQueue::acceptsCompression() const
+{
+    return (m_peerCapabilities & FrameProtocol::CapCompression) && FrameProtocol::isCompressionEnabled();
+}
+
+bool OutboundQueue::acceptsChecksums() const
+{
+    return (m_peerCapabilities & FrameProtocol::CapChecksum) != 0;
+}
+
+OutboundQueue::Statistics OutboundQueue::statistics()
+{
+    Statistics statistics;
+    statistics.congested = s_congested.loadRelaxed();
+    statistics.paused = s_paused.loadRelaxed();
+    statistics.droppedFrames = s_droppedFrames.loadRelaxed();
+    statistics.droppedBytes = s_droppedBytes.loadRelaxed();
+    statistics.disconnected = s_disconnected.loadRelaxed();
+    return statistics;
+}
+
+bool OutboundQueue::enqueue(const QByteArray& frame, Delivery delivery, const QSharedPointer<BroadcastBudget>& budget)
+{
+    quint32 streamId = 0;
+    const bool bulk = isBulk(frame, &streamId);
+    return push(frame, delivery, budget, bulk, streamId);
+}
+
+bool OutboundQueue::enqueueBulk(const QByteArray& frames, quint64 stream)
+{
+    return push(frames, Delivery::Reliable, QSharedPointer<BroadcastBudget>(), true, stream);
+}
+
+bool OutboundQueue::push(const QByteArray& frame, Delivery delivery, const QSharedPointer<BroadcastBudget>& budget, bool bulk, quint64 stream)
+{
+    bool accepted = false;
+
+    if(StreamSocket::isConnected(m_socket))
+    {
+        // 어떤 policy든 hardLimit를 넘기면 연결 종료
+        if(pendingBytes() + frame.size() > m_limits.hardLimit)
+            disconnectSlowConsumer();
+        else
+        {
+            updateCongestion();
+
+            // 혼잡한 동안 버려도 되는 frame은 버림
+            if(m_congested && m_limits.policy == SlowConsumerPolicy::DropNonCritical && delivery == Delivery::Droppable)
+            {
+                s_droppedFrames.fetchAndAddRelaxed(1);
+                s_droppedBytes.fetchAndAddRelaxed(frame.size());
+            }
+            else if(StreamSocket::isConnected(m_socket))
+            {
+                // QByteArray는 암시적 공유이므로 여기서는 참조 카운트만 증가
+                if(bulk)
+                {
+                    QQueue<Entry>& entries = m_bulk[stream];
+                    if(entries.isEmpty())
+                        m_bulkOrder.enqueue(stream);
+                    entries.enqueue(Entry{frame, budget});
+                }
+                else
+                    m_interactive.enqueue(Entry{frame, budget});
+                m_queuedBytes += frame.size();
+                accepted = true;
+                slot_flush();
+
+                if(m_metrics && ServerMetrics::isEnabled())
+                {
+                    m_metrics->add(ServerMetrics::FramesOut);
+                    m_metrics->add(ServerMetrics::BytesOut, static_cast<quint64>(frame.size()));
+                    m_metrics->queuedBytes.storeRelaxed(m_queuedBytes);
+                    ServerMetrics::record(ServerMetrics::QueueDepthBytes, static_cast<quint64>(pendingBytes()));
+                }
+            }
+        }
+    }
+
+    // 대기열에 넣지 못한 broadcast frame의 몫은 바로 반환
+    if(!accepted && budget)
+        budget->release(frame.size());
+    return accepted;
+}
+
+bool OutboundQueue::hold(const QObject* owner)
+{
+    if(m_holder && m_holder != owner)
+        return false;
+    m_holder = owner;
+    return true;
+}
+
+void OutboundQueue::release(const QObject* owner)
+{
+    if(m_holder != owner)
+        return;
+
+    m_holder = nullptr;
+    slot_flush();
+    emit signal_released();
+}
+
+void OutboundQueue::slot_flush()
+{
+    while(!m_holder && m_socket->bytesToWrite() < SocketBufferLimit)
+    {
+        // 대화형 frame을 먼저 넘기고, 첨부파일 frame은 소켓 버퍼가 충분히 비었을 때만 넘김
+        Entry entry;
+        if(!m_interactive.isEmpty())
+            entry = m_interactive.dequeue();
+        else if(!m_bulkOrder.isEmpty() && m_socket->bytesToWrite() < BulkSocketBufferLimit)
+            entry = takeBulk();
+        else
+            break;
+
+        m_queuedBytes -= entry.frame.size();
+
+        m_socket->write(entry.frame);
+
+        if(entry.budget)
+            entry.budget->release(entry.frame.size());
+    }
+
+    if(m_metrics && ServerMetrics::isEnabled())
+        m_metrics->queuedBytes.storeRelaxed(m_queuedBytes);
+
+    updateCongestion();
+}
+
+OutboundQueue::Entry OutboundQueue::takeBulk()
+{
+    const quint64 stream = m_bulkOrder.dequeue();
+
+    auto it = m_bulk.find(stream);
+    Entry entry = it->dequeue();
+
+    // 남은 frame이 있으면 다른 전송 뒤로 보냄
+    if(it->isEmpty())
+        m_bulk.erase(it);
+    else
+        m_bulkOrder.enqueue(stream);
+    return entry;
+}
+
+bool OutboundQueue::isBulk(const QByteArray& frame, quint32* streamId)
+{
+    FrameProtocol::FrameHeader header;
+    if(FrameProtocol::decodeHeader(frame.constData(), frame.size(), &header) != FrameProtocol::DecodeResult::Ok)
+        return false;
+
+    switch(header.type)
+    {
+    case FrameProtocol::FrameType::AttachmentStart:
+    case FrameProtocol::FrameType::AttachmentChunk:
+    case FrameProtocol::FrameType::AttachmentEnd:
+        *streamId = header.streamId;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// watermark에 따라 혼잡 상태를 바꾸고 policy 적용
+void OutboundQueue::updateCongestion()
+{
+    const qint64 pending = pendingBytes();
+
+    if(!m_congested && pending >= m_limits.highWatermark)
+    {
+        m_congested = true;
+        s_congested.fetchAndAddRelaxed(1);
+
+        switch(m_limits.policy)
+        {
+        case SlowConsumerPolicy::Pause:
+            s_paused.fetchAndAddRelaxed(1);
+            emit signal_paused();
+            break;
+        case SlowConsumerPolicy::DropNonCritical:
+            break;
+        case SlowConsumerPolicy::Disconnect:
+            disconnectSlowConsumer();
+            break;
+        }
+    }
+    else if(m_congested && pending <= m_limits.lowWatermark)
+    {
+        m_congested = false;
+        if(m_limits.policy == SlowConsumerPolicy::Pause)
+            emit signal_resumed();
+    }
+}
+
+void OutboundQueue::disconnectSlowConsumer()
+{
+    if(StreamSocket::isUnconnected(m_socket))
+        return;
+
+    s_disconnected.fetchAndAddRelaxed(1);
+    StreamSocket::abort(m_socket);
+}
@@ -0,0 +1,180 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include <QObject>
+#include <QAtomicInteger>
+#include <QHash>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QIODevice>
+
+#include "servermetrics.h"
+
+// 여러 소켓에 같은 frame을 보낼 때(broadcast) 아직 소켓에 넘기지 못한 바이트 수를 세는 객체
+// frame 데이터는 QByteArray 암시적 공유로 한 벌만 존재하고, 각 소켓의 OutboundQueue가
+// 소켓에 frame을 넘길 때마다 release하여 송신 측(BroadcastSender)이 읽기 속도를 맞춤
+class BroadcastBudget : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BroadcastBudget(qint64 limit) : m_limit(limit) {}
+
+    void acquire(qint64 bytes) { m_bytes.fetchAndAddOrdered(bytes); }
+    void release(qint64 bytes);
+
+    qint64 bytes() const { return m_bytes.loadAcquire(); }
+    qint64 limit() const { return m_limit; }
+    bool isFull() const { return bytes() >= m_limit; }
+
+signals:
+    // 대기 중인 바이트가 limit의 절반 아래로 내려가면 발생(어느 thread에서나 emit 될 수 있음)
+    void signal_drained();
+
+private:
+    QAtomicInteger<qint64> m_bytes;
+    const qint64 m_limit;
+};
+
+// 소켓별 송신 대기열
+// 인코딩이 끝난 frame(QByteArray)을 복사하지 않고 참조로 보관하다가
+// 소켓 송신 버퍼가 SocketBufferLimit 아래로 내려갈 때마다 소켓으로 넘김
+//
+// frame은 두 단계 우선순위로 나누어 보관함
+// 메시지/Ping/Pong 등 대화형 frame은 항상 먼저 소켓으로 넘기고,
+// 첨부파일 frame(start/chunk/end)과 메시지 기록 재생 덩어리는 전송(stream)별 대기열에 두었다가 한 덩어리씩 번갈아 넘김
+// 첨부파일 frame은 소켓 송신 버퍼가 BulkSocketBufferLimit 아래일 때만 넘기므로
+// 큰 파일을 보내는 중에도 메시지는 최대 BulkSocketBufferLimit 뒤에서 기다림
+//
+// 대기열(대기열 + 소켓 송신 버퍼)이 highWatermark를 넘으면 느린 수신자로 보고 policy를 적용하고,
+// lowWatermark 아래로 내려오면 정상 상태로 돌아감
+// 어떤 policy든 hardLimit를 넘으면 연결을 끊어 한 클라이언트가 서버 메모리를 다 쓰지 못하게 함
+// 소켓의 자식 객체로 생성되며, 소켓과 같은 thread에서만 사용
+class OutboundQueue : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 SocketBufferLimit = 256 * 1024;
+    // 첨부파일 frame을 넘길 수 있는 소켓 송신 버퍼 한도(chunk 하나 정도)
+    static constexpr qint64 BulkSocketBufferLimit = 64 * 1024;
+    // 메시지 기록 재생(HistoryReplayer)용 bulk 대기열 ID(첨부파일 streamId(quint32)와 겹치지 않음)
+    static constexpr quint64 ReplayStream = Q_UINT64_C(1) << 32;
+
+    // 느린 수신자 처리 방식
+    enum class SlowConsumerPolicy
+    {
+        Pause,              // 생산자(AttachmentSender 등)에 일시 정지를 알리고 대기
+        DropNonCritical,    // 버려도 되는 frame(broadcast 채팅 등)은 버림
+        Disconnect          // 연결 종료
+    };
+
+    // frame 전달 보장 수준
+    enum class Delivery
+    {
+        Reliable,           // 반드시 전송(첨부파일, 제어 frame 등)
+        Droppable           // 혼잡할 때 버릴 수 있음
+    };
+
+    struct Limits
+    {
+        qint64 lowWatermark = 1 * 1024 * 1024;
+        qint64 highWatermark = 4 * 1024 * 1024;
+        qint64 hardLimit = 16 * 1024 * 1024;
+        SlowConsumerPolicy policy = SlowConsumerPolicy::DropNonCritical;
+    };
+
+    // 모든 대기열의 policy 발동 횟수(프로세스 전체 누적)
+    struct Statistics
+    {
+        quint64 congested = 0;          // highWatermark를 넘은 횟수
+        quint64 paused = 0;             // Pause policy 발동 횟수
+        quint64 droppedFrames = 0;      // DropNonCritical로 버린 frame 수
+        quint64 droppedBytes = 0;
+        quint64 disconnected = 0;       // Disconnect policy 또는 hardLimit 초과로 끊은 연결 수
+    };
+
+    explicit OutboundQueue(QIODevice* socket, const Limits& limits = Limits());
+    ~OutboundQueue();
+
+    // 대기열에 frame을 넣음, 혼잡하여 버려졌거나 연결을 끊었으면 false
+    bool enqueue(const QByteArray& frame, Delivery delivery = Delivery::Reliable, const QSharedPointer<BroadcastBudget>& budget = QSharedPointer<BroadcastBudget>());
+    // frame 종류와 관계없이 첨부파일 frame처럼 stream별 bulk 대기열에 넣음
+    // 대화형 frame을 여러 개 이어 붙인 큰 덩어리(기록 재생 등)가 실시간 메시지를 막지 않도록 사용
+    bool enqueueBulk(const QByteArray& frames, quint64 stream);
+
+    // 대기열 + 소켓 송신 버퍼에 남은 바이트
+    qint64 pendingBytes() const { return m_queuedBytes + m_socket->bytesToWrite(); }
+    qint64 queuedBytes() const { return m_queuedBytes; }
+
+    bool isCongested() const { return m_congested; }
+    // Pause policy로 생산자가 멈춰야 하는 상태
+    bool isPaused() const { return m_congested && m_limits.policy == SlowConsumerPolicy::Pause; }
+
+    void setLimits(const Limits& limits) { m_limits = limits; }
+    const Limits& limits() const { return m_limits; }
+
+    // hold 중에는 소켓으로 frame을 넘기지 않음
+    // 다른 경로(sendfile 등)로 소켓에 frame을 직접 쓰는 동안 frame이 섞이지 않도록 사용
+    // hold를 건 owner만 풀 수 있으며, 다른 owner가 hold 중이면 hold는 false를 반환(signal_released 뒤에 다시 시도)
+    bool hold(const QObject* owner);
+    void release(const QObject* owner);
+    bool isHeld() const { return m_holder != nullptr; }
+    bool isHeldBy(const QObject* owner) const { return m_holder == owner; }
+
+    // 상대가 Hello로 알린 지원 기능(FrameProtocol::Capability), Hello를 받기 전에는 0
+    void setPeerCapabilities(quint32 capabilities) { m_peerCapabilities = capabilities; }
+    quint32 peerCapabilities() const { return m_peerCapabilities; }
+    // 이 소켓으로 압축한 frame을 보내도 되는지(상대가 지원하고 이쪽도 압축을 켰을 때)
+    bool acceptsCompression() const;
+    // 이 소켓으로 CRC32C를 붙인 frame(FlagChecksum)을 보내도 되는지
+    bool acceptsChecksums() const;
+
+    // 이 소켓의 송신 counter(ServerMetrics가 켜져 있을 때만 기록)
+    void setMetrics(const QSharedPointer<ServerMetrics::Connection>& metrics) { m_metrics = metrics; }
+    const QSharedPointer<ServerMetrics::Connection>& metrics() const { return m_metrics; }
+
+    static Statistics statistics();
+
+    // socket에 붙어있는 OutboundQueue를 찾음
+    static OutboundQueue* of(QIODevice* socket);
+
+signals:
+    // Pause policy에서 혼잡 상태가 시작/해제될 때 발생
+    void signal_paused();
+    void signal_resumed();
+    // hold가 풀려 다른 owner가 소켓에 직접 쓸 수 있게 됨
+    void signal_released();
+
+private slots:
+    void slot_flush();
+
+private:
+    struct Entry
+    {
+        QByteArray frame;
+        QSharedPointer<BroadcastBudget> budget;
+    };
+
+    // 첨부파일 frame인지 header의 frame type으로 판단
+    static bool isBulk(const QByteArray& frame, quint32* streamId);
+    // bulk이면 stream 대기열에, 아니면 대화형 대기열에 넣음
+    bool push(const QByteArray& frame, Delivery delivery, const QSharedPointer<BroadcastBudget>& budget, bool bulk, quint64 stream);
+    // 첨부파일 대기열에서 다음 전송 차례의 frame을 꺼냄(streamId round-robin)
+    Entry takeBulk();
+    void releaseAll(QQueue<Entry>& queue);
+
+    void updateCongestion();
+    void disconnectSlowConsumer();
+
+    QIODevice* m_socket;
+    Limits m_limits;
+    QQueue<Entry> m_interactive;
+    QHash<quint64, QQueue<Entry>> m_bulk;
+    QQueue<quint64> m_bulkOrder;        // frame이 남아있는 stream(보낼 차례 순서)
+    qint64 m_queuedBytes = 0;
+    bool m_congested = false;
+    const QObject* m_holder = nullptr;
+    quint32 m_peerCapabilities = 0;
+    QSharedPointer<ServerMetrics::Connection> m_metrics;
+};
+
+#endif // OUTBOUNDQUEUE_H
@@ -0,0 +1,62 @@
+#include "roomdirectory.h"
+#include "connectionworker.h"
+#include "frameprotocol.h"
+
+void RoomDirectory::join(const QByteArray& room, ConnectionWorker* worker)
+{
+    QWriteLocker locker(&m_lock);
+    ++m_rooms[room][worker];
+}
+
+void RoomDirectory::leave(const QByteArray& room, ConnectionWorker* worker)
+{
+    QWriteLocker locker(&m_lock);
+
+    auto it = m_rooms.find(room);
+    if(it == m_rooms.end())
+        return;
+
+    auto member = it->find(worker);
+    if(member == it->end())
+        return;
+
+    // 구독자가 없는 worker와 room은 색인에서 제거
+    if(--member.value() <= 0)
+        it->erase(member);
+    if(it->isEmpty())
+        m_rooms.erase(it);
+}
+
+void RoomDirectory::publish(const QByteArray& room, const QByteArray& frame, OutboundQueue::Delivery delivery)
+{
+    QList<ConnectionWorker*> workers;
+    {
+        QReadLocker locker(&m_lock);
+        workers = m_rooms.value(room).keys();
+    }
+    if(workers.isEmpty())
+        return;
+
+    const QByteArray compressedFrame = FrameProtocol::compressFrame(frame);
+    foreach (ConnectionWorker* worker, workers)
+    {
+        QMetaObject::invokeMethod(worker, [worker, room, frame, compressedFrame, delivery]() {
+            worker->slot_publishFrame(room, frame, compressedFrame, delivery);
+        }, Qt::QueuedConnection);
+    }
+}
+
+QHash<QByteArray, int> RoomDirectory::memberCounts() const
+{
+    QReadLocker locker(&m_lock);
+
+    QHash<QByteArray, int> counts;
+    for(auto it = m_rooms.begin(); it != m_rooms.end(); ++it)
+    {
+        int members = 0;
+        foreach (int count, it.value())
+            members += count;
+        counts.insert(it.key(), members);
+    }
+    return counts;
+}
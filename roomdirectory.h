@@ -0,0 +1,39 @@
+#ifndef ROOMDIRECTORY_H
+#define ROOMDIRECTORY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+
+#include "outboundqueue.h"
+
+class ConnectionWorker;
+
+// room -> 구독자가 있는 worker 색인
+// 소켓 단위 구독자 목록은 각 ConnectionWorker가 자신의 thread에서 관리하고,
+// 이 색인은 room마다 어느 worker에 구독자가 몇 명 있는지만 보관함
+// 따라서 publish는 구독자가 있는 worker에만 전달되고, 각 worker는 자신의 구독자에게만 넣으므로
+// 비용이 전체 연결 수가 아니라 room 크기에 비례함
+// 모든 함수는 어느 thread에서나 호출할 수 있음
+class RoomDirectory
+{
+public:
+    // worker의 소켓이 room에 들어가거나 나갈 때 호출(worker thread)
+    void join(const QByteArray& room, ConnectionWorker* worker);
+    void leave(const QByteArray& room, ConnectionWorker* worker);
+
+    // room 구독자에게 frame 전송
+    // frame은 한 번만 압축하여 구독자가 있는 worker마다 한 번씩만 전달
+    void publish(const QByteArray& room, const QByteArray& frame, OutboundQueue::Delivery delivery);
+
+    // room별 구독자 수
+    QHash<QByteArray, int> memberCounts() const;
+
+private:
+    mutable QReadWriteLock m_lock;
+    // room -> (worker -> 그 worker의 구독자 수)
+    QHash<QByteArray, QHash<ConnectionWorker*, int>> m_rooms;
+};
+
+#endif // ROOMDIRECTORY_H
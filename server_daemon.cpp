@@ -0,0 +1,387 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QTimer>
+
+#include "attachmentsender.h"
+#include "blobcache.h"
+#include "chatservercore.h"
+#include "crc32c.h"
+#include "epolleventdispatcher.h"
+#include "frameprotocol.h"
+#include "metricsendpoint.h"
+#include "servermetrics.h"
+
+// GUI 없이 실행되는 서버(daemon)
+// MainWindow 대신 ChatServerCore의 signal을 로그로 출력함
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qtcpserverd");
+
+    // 실행 옵션 : 포트, 바인드 주소, worker thread 수, 첨부파일 저장 디렉토리
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless QTCPServer relay");
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Port to listen on.", "port", "8080");
+    QCommandLineOption bindOption(QStringList() << "b" << "bind", "Address to bind to.", "address", "0.0.0.0");
+    QCommandLineOption localSocketOption("local-socket", "Also accept same-host clients on this local socket (name or path).", "name");
+    QCommandLineOption workersOption(QStringList() << "w" << "workers", "Number of connection worker threads (0 = one per core).", "count", "0");
+    QCommandLineOption spoolOption(QStringList() << "s" << "spool-dir", "Directory where incoming attachments are stored. Attachments are discarded if not set.", "directory");
+    // 연결별 송신 대기열 한도와 느린 수신자 policy
+    QCommandLineOption lowWatermarkOption("low-watermark", "Outbound bytes per connection below which a slow consumer is considered recovered.", "bytes", "1048576");
+    QCommandLineOption highWatermarkOption("high-watermark", "Outbound bytes per connection above which the slow-consumer policy applies.", "bytes", "4194304");
+    QCommandLineOption hardLimitOption("hard-limit", "Outbound bytes per connection above which the connection is always closed.", "bytes", "16777216");
+    QCommandLineOption policyOption("slow-consumer-policy", "What to do with slow consumers: pause, drop or disconnect.", "policy", "drop");
+    // 첨부파일 수신 정책(묻을 사람이 없으므로 자동 저장 조건에 맞지 않으면 거부)
+    QCommandLineOption maxAttachmentOption("max-attachment-size", "Reject attachments larger than this (0 = no limit).", "bytes", "0");
+    QCommandLineOption blockExtOption("block-ext", "Comma-separated file extensions that are always rejected.", "extensions");
+    QCommandLineOption acceptMaxSizeOption("accept-max-size", "Only auto-accept attachments up to this size (0 = no limit).", "bytes", "0");
+    QCommandLineOption acceptExtOption("accept-ext", "Comma-separated file extensions to auto-accept (default: any).", "extensions");
+    QCommandLineOption acceptFromOption("accept-from", "Comma-separated sender addresses or subnets (CIDR) to auto-accept from (default: any).", "subnets");
+    QCommandLineOption statsOption("stats-interval", "Log outbound queue counters every N seconds (0 = off).", "seconds", "60");
+    // 첨부파일 본문을 sendfile(2) 대신 읽어서 보냄(복사 경로와 비교할 때 사용)
+    QCommandLineOption epollOption("epoll", "Run connection worker threads on an epoll event loop instead of Qt's default one (Linux only).");
+    QCommandLineOption noSendfileOption("no-sendfile", "Copy attachment bodies through userspace instead of using sendfile(2).");
+    QCommandLineOption historyOption("history-dir", "Directory where chat messages are recorded for replay to new clients. History is off if not set.", "directory");
+    QCommandLineOption historySegmentsOption("history-segments", "Number of history segment files to keep (oldest are deleted).", "count", "16");
+    QCommandLineOption compressionOption("compression", "Offer and use payload compression with clients that support it: on or off.", "mode", "on");
+    QCommandLineOption compressionThresholdOption("compression-threshold", "Payloads smaller than this are sent uncompressed.", "bytes", "256");
+    // 받은 첨부파일을 내용 hash로 보관해 같은 파일이 다시 오면 전송을 건너뜀
+    QCommandLineOption cacheOption("cache-dir", "Directory where received attachments are cached by content hash. Repeated transfers of cached files are skipped. Caching is off if not set.", "directory");
+    QCommandLineOption cacheSizeOption("cache-size", "Maximum total size of the attachment cache (least recently used blobs are deleted).", "bytes", QString::number(BlobCache::DefaultMaxBytes));
+    // 응답 없는 연결 정리(disconnected가 오지 않는 반쯤 열린 연결 대비)
+    QCommandLineOption pingIntervalOption("ping-interval", "Send a ping to connections that have sent nothing for this many seconds (0 = off).", "seconds", "30");
+    QCommandLineOption idleTimeoutOption("idle-timeout", "Close connections that have sent nothing, not even a pong, for this many seconds (0 = off).", "seconds", "90");
+    // 연결별 수신 한도(한도를 넘은 연결은 읽기를 멈춰 TCP 흐름 제어로 송신 측을 늦춤)
+    QCommandLineOption maxFrameRateOption("max-frame-rate", "Limit each connection to this many inbound frames per second (0 = off).", "frames", "0");
+    QCommandLineOption maxByteRateOption("max-byte-rate", "Limit each connection to this many inbound bytes per second (0 = off).", "bytes", "0");
+    QCommandLineOption rateBurstOption("rate-burst", "Seconds of traffic a connection may send at once above its rate limit.", "seconds", "1");
+    // hot path 계측(둘 다 지정하지 않으면 계측하지 않음)
+    QCommandLineOption metricsPortOption("metrics-port", "Serve metrics on 127.0.0.1 at this port (/metrics for Prometheus, /metrics.json for JSON).", "port");
+    QCommandLineOption metricsJsonOption("metrics-json", "Periodically write metrics as JSON to this file.", "file");
+    QCommandLineOption metricsIntervalOption("metrics-interval", "Seconds between JSON metrics dumps.", "seconds", "10");
+    // benchmark용 broadcast(qtcp-loadgen --broadcast-bench와 함께 사용)
+    QCommandLineOption broadcastRateOption("broadcast-rate", "Broadcast a generated message to all clients this many times per second (0 = off, for benchmarks).", "rate", "0");
+    QCommandLineOption broadcastSizeOption("broadcast-size", "Size in bytes of the generated broadcast message.", "bytes", "64");
+    QCommandLineOption broadcastFileOption("broadcast-file", "Broadcast this file to all clients every --broadcast-file-interval seconds (for benchmarks).", "file");
+    QCommandLineOption broadcastFileIntervalOption("broadcast-file-interval", "Seconds between broadcasts of --broadcast-file.", "seconds", "10");
+    QCommandLineOption sendFileOption("send-file", "Send this file to every client as soon as it connects (for benchmarks, see qtcp-loadgen --attachment-bench).", "file");
+    parser.addOption(portOption);
+    parser.addOption(bindOption);
+    parser.addOption(localSocketOption);
+    parser.addOption(workersOption);
+    parser.addOption(spoolOption);
+    parser.addOption(lowWatermarkOption);
+    parser.addOption(highWatermarkOption);
+    parser.addOption(hardLimitOption);
+    parser.addOption(policyOption);
+    parser.addOption(maxAttachmentOption);
+    parser.addOption(blockExtOption);
+    parser.addOption(acceptMaxSizeOption);
+    parser.addOption(acceptExtOption);
+    parser.addOption(acceptFromOption);
+    parser.addOption(statsOption);
+    parser.addOption(noSendfileOption);
+    parser.addOption(epollOption);
+    parser.addOption(historyOption);
+    parser.addOption(historySegmentsOption);
+    parser.addOption(compressionOption);
+    parser.addOption(compressionThresholdOption);
+    parser.addOption(cacheOption);
+    parser.addOption(cacheSizeOption);
+    parser.addOption(pingIntervalOption);
+    parser.addOption(idleTimeoutOption);
+    parser.addOption(maxFrameRateOption);
+    parser.addOption(maxByteRateOption);
+    parser.addOption(rateBurstOption);
+    parser.addOption(metricsPortOption);
+    parser.addOption(metricsJsonOption);
+    parser.addOption(metricsIntervalOption);
+    parser.addOption(broadcastRateOption);
+    parser.addOption(broadcastSizeOption);
+    parser.addOption(broadcastFileOption);
+    parser.addOption(broadcastFileIntervalOption);
+    parser.addOption(sendFileOption);
+    parser.process(app);
+
+    bool ok = false;
+    const quint16 port = parser.value(portOption).toUShort(&ok);
+    if(!ok)
+    {
+        qCritical("Invalid port: %s", qPrintable(parser.value(portOption)));
+        return EXIT_FAILURE;
+    }
+
+    QHostAddress address;
+    if(!address.setAddress(parser.value(bindOption)))
+    {
+        qCritical("Invalid bind address: %s", qPrintable(parser.value(bindOption)));
+        return EXIT_FAILURE;
+    }
+
+    OutboundQueue::Limits limits;
+    limits.lowWatermark = parser.value(lowWatermarkOption).toLongLong();
+    limits.highWatermark = parser.value(highWatermarkOption).toLongLong();
+    limits.hardLimit = parser.value(hardLimitOption).toLongLong();
+    if(limits.lowWatermark <= 0 || limits.highWatermark <= limits.lowWatermark || limits.hardLimit < limits.highWatermark)
+    {
+        qCritical("Watermarks must satisfy 0 < low-watermark < high-watermark <= hard-limit");
+        return EXIT_FAILURE;
+    }
+
+    const QString policy = parser.value(policyOption);
+    if(policy == "pause")
+        limits.policy = OutboundQueue::SlowConsumerPolicy::Pause;
+    else if(policy == "drop")
+        limits.policy = OutboundQueue::SlowConsumerPolicy::DropNonCritical;
+    else if(policy == "disconnect")
+        limits.policy = OutboundQueue::SlowConsumerPolicy::Disconnect;
+    else
+    {
+        qCritical("Invalid slow-consumer policy: %s", qPrintable(policy));
+        return EXIT_FAILURE;
+    }
+
+    if(parser.isSet(noSendfileOption))
+        AttachmentSender::setZeroCopyEnabled(false);
+    if(parser.isSet(epollOption))
+        EpollEventDispatcher::setEnabled(true);
+
+    const QString compression = parser.value(compressionOption);
+    if(compression != "on" && compression != "off")
+    {
+        qCritical("Invalid compression mode: %s", qPrintable(compression));
+        return EXIT_FAILURE;
+    }
+    FrameProtocol::setCompressionEnabled(compression == "on");
+
+    const int compressionThreshold = parser.value(compressionThresholdOption).toInt(&ok);
+    if(!ok || compressionThreshold < 0)
+    {
+        qCritical("Invalid compression threshold: %s", qPrintable(parser.value(compressionThresholdOption)));
+        return EXIT_FAILURE;
+    }
+    FrameProtocol::setCompressionThreshold(compressionThreshold);
+
+    ConnectionWorker::Heartbeat heartbeat;
+    heartbeat.pingInterval = parser.value(pingIntervalOption).toInt(&ok);
+    if(ok)
+        heartbeat.idleTimeout = parser.value(idleTimeoutOption).toInt(&ok);
+    if(!ok || heartbeat.pingInterval < 0 || heartbeat.idleTimeout < 0
+       || (heartbeat.pingInterval > 0 && heartbeat.idleTimeout > 0 && heartbeat.idleTimeout <= heartbeat.pingInterval))
+    {
+        qCritical("Heartbeat settings must satisfy ping-interval < idle-timeout (0 = off)");
+        return EXIT_FAILURE;
+    }
+
+    ConnectionWorker::RateLimit rateLimit;
+    rateLimit.framesPerSecond = parser.value(maxFrameRateOption).toDouble(&ok);
+    if(ok)
+        rateLimit.bytesPerSecond = parser.value(maxByteRateOption).toDouble(&ok);
+    if(ok)
+        rateLimit.burstSeconds = parser.value(rateBurstOption).toDouble(&ok);
+    if(!ok || rateLimit.framesPerSecond < 0 || rateLimit.bytesPerSecond < 0 || rateLimit.burstSeconds <= 0)
+    {
+        qCritical("Rate limits must be non-negative numbers (0 = off) and the burst must be positive");
+        return EXIT_FAILURE;
+    }
+
+    ChatServerCore core(parser.value(workersOption).toInt());
+    core.setQueueLimits(limits);
+    core.setHeartbeat(heartbeat);
+    core.setRateLimit(rateLimit);
+
+    // 첨부파일은 저장 디렉토리가 지정되고 자동 저장 조건에 맞는 경우에만 받음
+    AttachmentPolicy attachmentPolicy;
+    attachmentPolicy.fallback = AttachmentPolicy::Decision::Reject;
+    attachmentPolicy.maxFileSize = parser.value(maxAttachmentOption).toLongLong();
+    attachmentPolicy.blockedExtensions = AttachmentPolicy::parseExtensions(parser.value(blockExtOption));
+    attachmentPolicy.autoAcceptMaxSize = parser.value(acceptMaxSizeOption).toLongLong();
+    attachmentPolicy.autoAcceptExtensions = AttachmentPolicy::parseExtensions(parser.value(acceptExtOption));
+    if(!AttachmentPolicy::parseSenders(parser.value(acceptFromOption), &attachmentPolicy.autoAcceptSenders))
+    {
+        qCritical("Invalid sender subnet list: %s", qPrintable(parser.value(acceptFromOption)));
+        return EXIT_FAILURE;
+    }
+    if(parser.isSet(spoolOption))
+    {
+        QString spoolDirectory = parser.value(spoolOption);
+        if(!QDir().mkpath(spoolDirectory))
+        {
+            qCritical("Unable to create spool directory: %s", qPrintable(spoolDirectory));
+            return EXIT_FAILURE;
+        }
+        attachmentPolicy.spoolDirectory = spoolDirectory;
+    }
+    if(parser.isSet(cacheOption))
+    {
+        const qint64 cacheSize = parser.value(cacheSizeOption).toLongLong(&ok);
+        if(!ok || cacheSize <= 0)
+        {
+            qCritical("Invalid cache size: %s", qPrintable(parser.value(cacheSizeOption)));
+            return EXIT_FAILURE;
+        }
+        if(!BlobCache::instance()->open(parser.value(cacheOption), cacheSize))
+        {
+            qCritical("Unable to create cache directory: %s", qPrintable(parser.value(cacheOption)));
+            return EXIT_FAILURE;
+        }
+    }
+    core.setAttachmentPolicy(attachmentPolicy);
+
+    // 화면 대신 로그로 출력
+    QObject::connect(&core, &ChatServerCore::signal_newMessage, [](const QString& message) {
+        qInfo("%s", qPrintable(message));
+    });
+    QObject::connect(&core, &ChatServerCore::signal_error, [](const QString& message) {
+        qWarning("%s", qPrintable(message));
+    });
+
+    // 메시지 기록은 클라이언트가 접속하기 전에 열어 둠
+    if(parser.isSet(historyOption))
+    {
+        const int historySegments = parser.value(historySegmentsOption).toInt(&ok);
+        if(!ok || historySegments <= 0)
+        {
+            qCritical("Invalid history segment count: %s", qPrintable(parser.value(historySegmentsOption)));
+            return EXIT_FAILURE;
+        }
+        if(!core.enableHistory(parser.value(historyOption), historySegments))
+            return EXIT_FAILURE;
+    }
+
+    // 계측은 내보낼 곳이 있을 때만 켬
+    ServerMetrics::setEnabled(parser.isSet(metricsPortOption) || parser.isSet(metricsJsonOption));
+
+    MetricsEndpoint metricsEndpoint;
+    if(parser.isSet(metricsPortOption))
+    {
+        const quint16 metricsPort = parser.value(metricsPortOption).toUShort(&ok);
+        if(!ok || !metricsEndpoint.listen(QHostAddress::LocalHost, metricsPort))
+        {
+            qCritical("Unable to serve metrics on port %s", qPrintable(parser.value(metricsPortOption)));
+            return EXIT_FAILURE;
+        }
+    }
+
+    QTimer metricsTimer;
+    if(parser.isSet(metricsJsonOption))
+    {
+        const int metricsInterval = parser.value(metricsIntervalOption).toInt(&ok);
+        if(!ok || metricsInterval <= 0)
+        {
+            qCritical("Invalid metrics interval: %s", qPrintable(parser.value(metricsIntervalOption)));
+            return EXIT_FAILURE;
+        }
+
+        // 읽는 쪽이 쓰다 만 파일을 보지 않도록 임시 파일에 쓴 뒤 바꿈
+        const QString metricsPath = parser.value(metricsJsonOption);
+        QObject::connect(&metricsTimer, &QTimer::timeout, [metricsPath]() {
+            QSaveFile file(metricsPath);
+            if(!file.open(QIODevice::WriteOnly) || file.write(ServerMetrics::toJson() + '\n') < 0 || !file.commit())
+                qWarning("Unable to write metrics to %s", qPrintable(metricsPath));
+        });
+        metricsTimer.start(metricsInterval * 1000);
+    }
+
+    if(!core.listen(address, port))
+    {
+        qCritical("Unable to start the server: %s.", qPrintable(core.errorString()));
+        return EXIT_FAILURE;
+    }
+    if(parser.isSet(localSocketOption) && !core.listenLocal(parser.value(localSocketOption)))
+    {
+        qCritical("Unable to listen on local socket %s: %s.", qPrintable(parser.value(localSocketOption)), qPrintable(core.localErrorString()));
+        return EXIT_FAILURE;
+    }
+
+    // 느린 수신자 policy 발동 횟수와 압축 효과(절약한 바이트, 쓴 CPU 시간), CRC32C 불일치, 첨부파일 캐시 적중, 끊은 연결 수를 주기적으로 출력
+    QTimer statsTimer;
+    const int statsInterval = parser.value(statsOption).toInt();
+    if(statsInterval > 0)
+    {
+        QObject::connect(&statsTimer, &QTimer::timeout, [&core]() {
+            OutboundQueue::Statistics statistics = core.queueStatistics();
+            qInfo("STATS :: congested=%llu paused=%llu dropped_frames=%llu dropped_bytes=%llu disconnected=%llu",
+                  statistics.congested, statistics.paused, statistics.droppedFrames, statistics.droppedBytes, statistics.disconnected);
+
+            ConnectionWorker::HeartbeatStatistics heartbeat = core.heartbeatStatistics();
+            qInfo("STATS :: pings_sent=%llu reaped=%llu", heartbeat.pingsSent, heartbeat.reaped);
+
+            ConnectionWorker::InboundStatistics inbound = core.inboundStatistics();
+            qInfo("STATS :: throttled=%llu deferred_reads=%llu", inbound.throttled, inbound.deferredReads);
+
+            FrameProtocol::CompressionStatistics compression = FrameProtocol::compressionStatistics();
+            qInfo("STATS :: compressed_frames=%llu incompressible_frames=%llu raw_bytes=%llu wire_bytes=%llu saved_bytes=%lld compress_ms=%llu decompressed_frames=%llu decompress_ms=%llu",
+                  compression.compressedFrames, compression.skippedFrames, compression.rawBytes, compression.wireBytes, compression.savedBytes(),
+                  compression.compressNsecs / 1000000, compression.decompressedFrames, compression.decompressNsecs / 1000000);
+            qInfo("STATS :: checksum_failures=%llu crc32c=%s", FrameProtocol::checksumFailures(), Crc32c::implementation());
+
+            if(BlobCache::instance()->isEnabled())
+            {
+                BlobCache::Statistics cache = BlobCache::instance()->statistics();
+                qInfo("STATS :: cache_hits=%llu cache_hit_bytes=%llu cache_misses=%llu cache_stored=%llu cache_evicted=%llu cache_bytes=%lld cache_blobs=%d",
+                      cache.hits, cache.hitBytes, cache.misses, cache.stored, cache.evicted, cache.bytes, cache.blobs);
+            }
+        });
+        statsTimer.start(statsInterval * 1000);
+    }
+
+    // 연결된 모든 클라이언트에게 일정한 속도로 broadcast하여 수신자 수에 따른 서버 비용을 잴 수 있게 함
+    const double broadcastRate = parser.value(broadcastRateOption).toDouble(&ok);
+    const int broadcastSize = ok ? parser.value(broadcastSizeOption).toInt(&ok) : 0;
+    if(!ok || broadcastRate < 0 || broadcastSize < 0)
+    {
+        qCritical("Broadcast rate and size must be non-negative numbers");
+        return EXIT_FAILURE;
+    }
+
+    QTimer broadcastTimer;
+    QElapsedTimer broadcastClock;
+    qint64 broadcastsSent = 0;
+    const QString broadcastText(broadcastSize, QChar('x'));
+    if(broadcastRate > 0)
+    {
+        // 10ms마다 지금까지 보냈어야 할 수만큼 보냄(timer 간격보다 높은 rate도 유지)
+        QObject::connect(&broadcastTimer, &QTimer::timeout, [&]() {
+            const qint64 due = static_cast<qint64>(broadcastClock.nsecsElapsed() / 1e9 * broadcastRate);
+            for(; broadcastsSent < due; ++broadcastsSent)
+                core.broadcastMessage(broadcastText);
+        });
+        broadcastClock.start();
+        broadcastTimer.start(10);
+    }
+
+    // 접속한 클라이언트마다 첨부파일을 보내 AttachmentSender의 sendfile 경로와 복사 경로(--no-sendfile) 비용을 잴 수 있게 함
+    if(parser.isSet(sendFileOption))
+    {
+        const QString sendFile = parser.value(sendFileOption);
+        QObject::connect(&core, &ChatServerCore::signal_clientConnected, [&core, sendFile](ConnectionId connectionId) {
+            if(!core.sendAttachment(connectionId, sendFile))
+                qWarning("Unable to send %s to id:%s", qPrintable(sendFile), qPrintable(QString::number(connectionId)));
+        });
+    }
+
+    QTimer broadcastFileTimer;
+    if(parser.isSet(broadcastFileOption))
+    {
+        const int broadcastFileInterval = parser.value(broadcastFileIntervalOption).toInt(&ok);
+        if(!ok || broadcastFileInterval <= 0)
+        {
+            qCritical("Invalid broadcast file interval: %s", qPrintable(parser.value(broadcastFileIntervalOption)));
+            return EXIT_FAILURE;
+        }
+
+        const QString broadcastFile = parser.value(broadcastFileOption);
+        QObject::connect(&broadcastFileTimer, &QTimer::timeout, [&core, broadcastFile]() {
+            if(!core.broadcastAttachment(broadcastFile))
+                qWarning("Unable to broadcast %s", qPrintable(broadcastFile));
+        });
+        broadcastFileTimer.start(broadcastFileInterval * 1000);
+    }
+
+    return app.exec();
+}
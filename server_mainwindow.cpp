@@ -1,5 +1,10 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "blobcache.h"
+#include "chatservercore.h"
+#include "connectionlistmodel.h"
+#include "messagelogmodel.h"
+#include "messagelogview.h"
 
 // [ex.02.1]
 // MainWindow 생성자 실행
@@ -7,18 +12,40 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 {
     ui->setupUi(this);
 
-    // TcpServer Socket 초기화
-    m_server = new QTcpServer();
+    // 서버 엔진 초기화
+    // 접속 대기, 라우팅, 파일 저장은 모두 ChatServerCore에서 처리하고 MainWindow는 화면 표시만 담당
+    m_core = new ChatServerCore(0, this);
 
-    // TcpServer Socket 생성 및 접속 요청 대기
-    if(m_server->listen(QHostAddress::Any, 8080))
-    {
-        // Server Socket으로 연결 요청이 들어오면 slot_newConnetction 함수 실행
-        connect(m_server, &QTcpServer::newConnection, this, &MainWindow::slot_newConnection);
+    // 수신 대상 목록은 연결/종료마다 해당 행만 갱신하는 model로 표시
+    m_connections = new ConnectionListModel(this);
+    ui->comboBox_receiver->setModel(m_connections);
+
+    // 로그는 ring buffer model에 모았다가 일정 주기로만 화면에 반영
+    m_log = new MessageLogModel(MessageLogModel::DefaultCapacity, this);
+    MessageLogView::replace(ui->textBrowser_receivedMessages, m_log);
+
+    // 받은 첨부파일을 내용 hash로 보관해 같은 파일은 다시 받지 않음
+    BlobCache::instance()->open(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/attachments");
+
+    // 연결이 준비되면 slot_newConnetction 함수 실행
+    connect(m_core, &ChatServerCore::signal_clientConnected, this, &MainWindow::slot_newConnection);
+
+    // 연결이 끊어지면 slot_discardSocket 함수 실행
+    connect(m_core, &ChatServerCore::signal_clientDisconnected, this, &MainWindow::slot_discardSocket);
+
+    // 첨부파일 수신 요청이 오면 slot_attachmentOffered 함수 실행
+    connect(m_core, &ChatServerCore::signal_attachmentOffered, this, &MainWindow::slot_attachmentOffered);
+
+    // 서버에서 오류가 발생하면 slot_displayError 함수 실행
+    connect(m_core, &ChatServerCore::signal_error, this, &MainWindow::slot_displayError);
 
-        // 메시지가 수신되면 slot_displayMessage 함수 실행
-        connect(this, &MainWindow::singal_newMessage, this, &MainWindow::slot_displayMessage);
+    // 메시지가 수신되면 slot_displayMessage 함수 실행
+    connect(m_core, &ChatServerCore::signal_newMessage, this, &MainWindow::slot_displayMessage);
+    connect(this, &MainWindow::singal_newMessage, this, &MainWindow::slot_displayMessage);
 
+    // TcpServer Socket 생성 및 접속 요청 대기
+    if(m_core->listen(QHostAddress::Any, 8080))
+    {
         // 서버 실행 메시지 출력
         ui->statusBar->showMessage("Server is listening...");
     }
@@ -27,7 +54,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     // 서버 소켓 생성 실패
     else
     {
-        QMessageBox::critical(this,"QTCPServer",QString("Unable to start the server: %1.").arg(m_server->errorString()));
+        QMessageBox::critical(this,"QTCPServer",QString("Unable to start the server: %1.").arg(m_core->errorString()));
         exit(EXIT_FAILURE);
     }
 }
@@ -35,181 +62,72 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 
 MainWindow::~MainWindow()
 {
-    // 서버에 연결된 모든 연결 소켓 해제
-    foreach (QTcpSocket* socket, qset_connectedSKT)
-    {
-        socket->close();
-        socket->deleteLater();
-    }
-
-    // 서버 소켓 해제
-    m_server->close();
-    m_server->deleteLater();
+    // 서버 엔진 해제
+    // worker thread가 담당하는 모든 연결 소켓도 함께 해제됨
+    delete m_core;
 
     delete ui;
 }
 
 
-void MainWindow::slot_newConnection()
+// worker thread에서 새 연결이 준비되면 동작
+void MainWindow::slot_newConnection(ConnectionId connectionId)
 {
-    // 서버 소켓 연결 대기
-    while (m_server->hasPendingConnections())
-        // 연결되는 소켓을 리스트에 append
-        appendToSocketList(m_server->nextPendingConnection());
-}
-
-// 소켓 연결시 리스트에 소켓 insert
-void MainWindow::appendToSocketList(QTcpSocket* socket)
-{
-
-    // 연결된 소켓을 qSet에 insert
-    // qSet과 qMap의 차이점
-    // qSet : 중복된 값 insert 불가(고유값)
-    // qMap : key와 value로 이루어진 Dictionary
-    qset_connectedSKT.insert(socket);
-
-
-    // 소켓에 읽을 메시지가 수신 시에 slot_readSocket 실행
-    connect(socket, &QTcpSocket::readyRead, this, &MainWindow::slot_readSocket);
-
-    // 소켓 연결이 끊기면 slot_discardSocket 실행
-    connect(socket, &QTcpSocket::disconnected, this, &MainWindow::slot_discardSocket);
-
-    // 연결된 소켓에 오류가 발생하면 slot_displayError 실행
-    connect(socket, &QAbstractSocket::errorOccurred, this, &MainWindow::slot_displayError);
-
-    // 소켓 디스크립터로 대상 선택 가능하도록 ui 표시
-    ui->comboBox_receiver->addItem(QString::number(socket->socketDescriptor()));
-
-    // 연결된 클라이언트 정보와, 소켓 디스크립터(정수 식별자) 출력
-    slot_displayMessage(QString("INFO :: Client with sockd:%1 has just entered the room").arg(socket->socketDescriptor()));
+    // 연결 ID로 대상 선택 가능하도록 목록에 추가
+    m_connections->addConnection(connectionId);
 }
 
 
 // 연결된 소켓에서 연결이 끊어지면 동작
-void MainWindow::slot_discardSocket()
+void MainWindow::slot_discardSocket(ConnectionId connectionId)
 {
-    // disconnected된 socket을 찾음
-    QTcpSocket* socket = reinterpret_cast<QTcpSocket*>(sender());
-
-    // 해당 소켓을 qset_connectedSKT에서 삭제
-    QSet<QTcpSocket*>::iterator it = qset_connectedSKT.find(socket);
-    if (it != qset_connectedSKT.end()){
-        slot_displayMessage(QString("INFO :: A client has just left the room").arg(socket->socketDescriptor()));
-        qset_connectedSKT.remove(*it);
-    }
-
-    // ui 콤보박스 재설정
-    refreshComboBox();
-
-    socket->deleteLater();
+    // 목록에서 해당 연결만 제거
+    m_connections->removeConnection(connectionId);
 }
 
 
-// 연결된 소켓에서 오류 종류에 따른 오류 관련 상태 출력
-void MainWindow::slot_displayError(QAbstractSocket::SocketError socketError)
+// worker thread에서 전달된 오류 상태 출력
+void MainWindow::slot_displayError(const QString& message)
 {
-    switch (socketError) {
-    case QAbstractSocket::RemoteHostClosedError:
-        break;
-    case QAbstractSocket::HostNotFoundError:
-        QMessageBox::information(this, "QTCPServer", "The host was not found. Please check the host name and port settings.");
-        break;
-    case QAbstractSocket::ConnectionRefusedError:
-        QMessageBox::information(this, "QTCPServer", "The connection was refused by the peer. Make sure QTCPServer is running, and check that the host name and port settings are correct.");
-        break;
-    default:
-        QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-        QMessageBox::information(this, "QTCPServer", QString("The following error occurred: %1.").arg(socket->errorString()));
-        break;
-    }
+    QMessageBox::information(this, "QTCPServer", message);
 }
 
 
-// 첨부파일 또는 메시지 수신 처리
-void MainWindow::slot_readSocket()
+// 첨부파일 수신 여부 확인(정책으로 결정되지 않은 첨부파일만 전달됨)
+// 대화상자는 modal event loop 없이 열고 결과는 signal로 받으므로 그동안에도 다른 이벤트가 처리됨
+// 확인하는 동안에도 worker thread는 chunk를 임시 파일에 계속 기록함
+void MainWindow::slot_attachmentOffered(ConnectionId connectionId, quint32 transferId, const QString& fileName, qint64 fileSize)
 {
-    // readReady 상태에서 signal이 발생한 socket을 찾음
-    QTcpSocket* socket = reinterpret_cast<QTcpSocket*>(sender());
-
-    // QByteArray 타입의 buffer
-    QByteArray buffer;
-
-    // 서버에 연결된 socket을 stream으로 연결
-    // stream을 사용하면 데이터 형식에 따라 자동으로 직렬화하여 데이터 형식 변환 및 형식 지원에 따른 복잡한 코드를 줄일 수 있음
-    QDataStream socketStream(socket);
-    // 스트림 버전을 Qt 5.15로 맞춤
-    socketStream.setVersion(QDataStream::Qt_5_15);
-
-    // stream 트랜잭션 시작
-    // 데이터 스트림이 일시 중단되면서 데이터 전송 작업은 트랜잭션 내에서 수행
-    socketStream.startTransaction();
-    socketStream >> buffer;
-
-    // stream startTransaction 실행 문제시 에러 표시 후 함수 종료
-    // 데이터를 다 보내지 못하면 return하여 함수 재실행, 다 보내면 아래 로직 진행
-    if(!socketStream.commitTransaction())
-    {
-        QString message = QString("%1 :: Waiting for more data to come..").arg(socket->socketDescriptor());
-        emit singal_newMessage(message);
-        return;
-    }
-
-    // 수신된 데이터 0부터 128byte까지만 header에 담기
-    QString header = buffer.mid(0,128);
-    // header에 담은 데이터를 ,로 split하고 나온 결과 중 0번째 인덱스의 값을
-    // :로 split하여 나온 결과 중 1번째 인덱스 값을 fileType에 담기
-    QString fileType = header.split(",")[0].split(":")[1];
-
-    // buffer의 128 byte 이후 부분을
-    buffer = buffer.mid(128);
-
-    // fileType이 attachment 라면
-    if(fileType=="attachment")
-    {
-        // 파일 이름 정보 저장
-        QString fileName = header.split(",")[1].split(":")[1];
-        // 파일 확장자 저장
-        QString ext = fileName.split(".")[1];
-        // 파일 크기 저장
-        QString size = header.split(",")[2].split(":")[1].split(";")[0];
-
-        // 파일 전송 메시지를 받으면, 메시지 박스에서 수신 여부 확인
-        // 메시지 박스에서 yes를 선택하면
-        if (QMessageBox::Yes == (QMessageBox::question(this, "QTCPServer", QString("You are receiving an attachment from sd:%1 of size: %2 bytes, called %3. Do you want to accept it?").arg(socket->socketDescriptor()).arg(size).arg(fileName))))
-        {
-            // 저장될 파일의 경로, 파일 이름, 확장자 설정
-            QString filePath = QFileDialog::getSaveFileName(this, tr("Save File"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)+"/"+fileName, QString("File (*.%1)").arg(ext));
-
-            // 해당 경로의 file을 객체로 설정
-            QFile file(filePath);
-
-            // 쓰기 전용(송신)으로 file 객체를 열음
-            if(file.open(QIODevice::WriteOnly))
-            {
-                // 담긴 데이터를 buffer로 송신
-                file.write(buffer);
-
-                // 파일이 저장되는 것에 대한 메시지를 ui에 출력한다.
-                QString message = QString("INFO :: Attachment from sd:%1 successfully stored on disk under the path %2").arg(socket->socketDescriptor()).arg(QString(filePath));
-                emit singal_newMessage(message);
-            }
-            else
-                QMessageBox::critical(this,"QTCPServer", "An error occurred while trying to write the attachment.");
-        }
-        else
+    // 파일 확장자 저장
+    QString ext = QFileInfo(fileName).suffix();
+
+    // 파일 전송 메시지를 받으면, 메시지 박스에서 수신 여부 확인
+    QMessageBox* question = new QMessageBox(QMessageBox::Question, "QTCPServer", QString("You are receiving an attachment from id:%1 of size: %2 bytes, called %3. Do you want to accept it?").arg(connectionId).arg(fileSize).arg(fileName), QMessageBox::Yes | QMessageBox::No, this);
+    question->setAttribute(Qt::WA_DeleteOnClose);
+    connect(question, &QMessageBox::finished, this, [this, connectionId, transferId, fileName, ext](int result) {
+        // 메시지 박스에서 No를 선택하면, 전송 거부
+        if(result != QMessageBox::Yes)
         {
-            // 메시지 박스에서 No를 선택하면, 전송 거부
-            QString message = QString("INFO :: Attachment from sd:%1 discarded").arg(socket->socketDescriptor());
-            emit singal_newMessage(message);
+            m_core->rejectAttachment(connectionId, transferId);
+            return;
         }
-    }
-    else if(fileType=="message")
-    {
-        // 전송된 메시지를 서버에서 출력
-        QString message = QString("%1 :: %2").arg(socket->socketDescriptor()).arg(QString::fromStdString(buffer.toStdString()));
-        emit singal_newMessage(message);
-    }
+
+        // 저장될 파일의 경로, 파일 이름, 확장자 설정
+        QString filter = ext.isEmpty() ? QString("File (*)") : QString("File (*.%1)").arg(ext);
+        QFileDialog* dialog = new QFileDialog(this, tr("Save File"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)+"/"+fileName, filter);
+        dialog->setAcceptMode(QFileDialog::AcceptSave);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+
+        // 저장 경로를 지정하면 수신 완료 시 해당 경로로 저장, 취소하면 전송 거부
+        connect(dialog, &QFileDialog::fileSelected, this, [this, connectionId, transferId](const QString& filePath) {
+            m_core->acceptAttachment(connectionId, transferId, filePath);
+        });
+        connect(dialog, &QFileDialog::rejected, this, [this, connectionId, transferId]() {
+            m_core->rejectAttachment(connectionId, transferId);
+        });
+        dialog->open();
+    });
+    question->open();
 }
 
 
@@ -217,29 +135,26 @@ void MainWindow::slot_readSocket()
 void MainWindow::on_pushButton_sendMessage_clicked()
 {
     // 수신할 대상을 comboBox에서 선택
-    QString receiver = ui->comboBox_receiver->currentText();
+    ConnectionId receiver = m_connections->connectionId(ui->comboBox_receiver->currentIndex());
 
+    // "#room 메시지" 형식이면 해당 room 구독자에게만 전송
+    QString message = ui->lineEdit_message->text();
+    if(receiver == 0 && message.startsWith('#') && message.contains(' '))
+    {
+        const int separator = message.indexOf(' ');
+        m_core->publishMessage(message.mid(1, separator - 1), message.mid(separator + 1));
+    }
     // Broadcast 선택 시,
-    if(receiver=="Broadcast")
+    else if(receiver == 0)
     {
-        // qset_connectedSKT에 저장된 모든 클라이언트의 소켓에 전송
-        foreach (QTcpSocket* socket,qset_connectedSKT)
-        {
-            sendMessage(socket);
-        }
+        // frame을 한 번만 인코딩하여 연결된 모든 클라이언트의 소켓에 전송
+        m_core->broadcastMessage(ui->lineEdit_message->text());
     }
     // 선택한 대상이 있을 때
     else
     {
-        // qset_connectedSKT에서 해당 클라이언트의 소켓을 찾아 메시지 전송
-        foreach (QTcpSocket* socket, qset_connectedSKT)
-        {
-            if(socket->socketDescriptor() == receiver.toLongLong())
-            {
-                sendMessage(socket);
-                break;
-            }
-        }
+        // 해당 클라이언트의 소켓에 메시지 전송
+        sendMessage(receiver);
     }
 
     // 메시지 입력창 리셋
@@ -251,7 +166,7 @@ void MainWindow::on_pushButton_sendMessage_clicked()
 void MainWindow::on_pushButton_sendAttachment_clicked()
 {
     // 보낼 대상 선택
-    QString receiver = ui->comboBox_receiver->currentText();
+    ConnectionId receiver = m_connections->connectionId(ui->comboBox_receiver->currentIndex());
 
     // 파일 경로 가져오고, 경로 문제시 경고 출력
     QString filePath = QFileDialog::getOpenFileName(this, ("Select an attachment"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation), ("File (*.json *.txt *.png *.jpg *.jpeg)"));
@@ -262,120 +177,39 @@ void MainWindow::on_pushButton_sendAttachment_clicked()
     }
 
     // 보낼 대상이 연결된 모든 socket일때 동작
-    if(receiver=="Broadcast")
+    if(receiver == 0)
     {
-        foreach (QTcpSocket* socket, qset_connectedSKT)
-        {
-            sendAttachment(socket, filePath);
-        }
+        // 파일을 한 번만 읽고 chunk마다 한 번만 인코딩하여 모든 socket에 전송
+        if(!m_core->broadcastAttachment(filePath))
+            QMessageBox::critical(this,"QTCPClient","Couldn't open the attachment!");
     }
     // 보낼 대상이 특정 socket일때 동작
     else
     {
-        foreach (QTcpSocket* socket, qset_connectedSKT)
-        {
-            // qset_connectedSKT에서 소켓을 찾아 메시지 전송
-            if(socket->socketDescriptor() == receiver.toLongLong())
-            {
-                sendAttachment(socket, filePath);
-                break;
-            }
-        }
+        sendAttachment(receiver, filePath);
     }
     ui->lineEdit_message->clear();
 }
 
 // 메시지를 전송하는 함수
-void MainWindow::sendMessage(QTcpSocket* socket)
+void MainWindow::sendMessage(ConnectionId connectionId)
 {
-    if(socket)
-    {
-        // 소켓이 열려있을 때
-        if(socket->isOpen())
-        {
-            // ui에서 입력한 text를 str에 저장
-            QString str = ui->lineEdit_message->text();
-
-            // socket을 stream에 연결
-            QDataStream socketStream(socket);
-            socketStream.setVersion(QDataStream::Qt_5_15);
-
-            //QByteArray 자료형의 변수 선언
-            QByteArray header;
-            // 변수에 fileType, fileName, fileSize를 header의 가장 앞에 붙임
-            header.prepend(QString("fileType:message,fileName:null,fileSize:%1;").arg(str.size()).toUtf8());
-            // 128byte로 사이즈 조정(클라이언트가 128바이트 전후로 나눠 읽기 때문에)
-            header.resize(128);
-
-            // QByteArray 자료형에 메시지 데이터를 담을 수 있도록 형변환
-            QByteArray byteArray = str.toUtf8();
-            // header를 메시지 데이터 가장 앞에 붙임
-            byteArray.prepend(header);
-
-            // stream으로 byteArray 정보 전송
-            socketStream << byteArray;
-        }
-        else
-            QMessageBox::critical(this,"QTCPServer","Socket doesn't seem to be opened");
-    }
-    else
+    // ui에서 입력한 text를 담당 worker thread에서 전송
+    if(!m_core->sendMessage(connectionId, ui->lineEdit_message->text()))
         QMessageBox::critical(this,"QTCPServer","Not connected");
 }
 
 // [ex.02.11]
-void MainWindow::sendAttachment(QTcpSocket* socket, QString filePath)
+void MainWindow::sendAttachment(ConnectionId connectionId, QString filePath)
 {
-    if(socket)
-    {
-        if(socket->isOpen())
-        {
-            // 전송할 file 객체를 경로 지정해서 열고
-            QFile m_file(filePath);
-            if(m_file.open(QIODevice::ReadOnly))
-            {
-                // 선택한 파일 이름 얻기
-                QFileInfo fileInfo(m_file.fileName());
-                QString fileName(fileInfo.fileName());
-
-                // stream에 socket 연결
-                QDataStream socketStream(socket);
-                socketStream.setVersion(QDataStream::Qt_5_15);
-
-                // 헤더 부분에 fileType을 attachment로 작성
-                QByteArray header;
-                header.prepend(QString("fileType:attachment,fileName:%1,fileSize:%2;").arg(fileName).arg(m_file.size()).toUtf8());
-                header.resize(128);
-
-                // QByteArray에 file을 byte로 할당하고
-                QByteArray byteArray = m_file.readAll();
-                // header 정보를 앞에 붙임
-                byteArray.prepend(header);
-
-                // stream으로 byteArray 정보 전송
-                socketStream << byteArray;
-
-            }
-            else
-                QMessageBox::critical(this,"QTCPClient","Couldn't open the attachment!");
-        }
-        else
-            QMessageBox::critical(this,"QTCPServer","Socket doesn't seem to be opened");
-    }
-    else
+    // 파일 전체를 메모리에 올리지 않고 담당 worker thread에서 chunk 단위로 전송
+    if(!m_core->sendAttachment(connectionId, filePath))
         QMessageBox::critical(this,"QTCPServer","Not connected");
 }
 
 
-// textBox에 메시지를 출력하는 함수
+// 로그에 메시지를 추가하는 함수(화면에는 다음 flush 때 반영)
 void MainWindow::slot_displayMessage(const QString& str)
 {
-    ui->textBrowser_receivedMessages->append(str);
-}
-
-// ComboBox를 새로고침하는 함수
-void MainWindow::refreshComboBox(){
-    ui->comboBox_receiver->clear();
-    ui->comboBox_receiver->addItem("Broadcast");
-    foreach(QTcpSocket* socket, qset_connectedSKT)
-        ui->comboBox_receiver->addItem(QString::number(socket->socketDescriptor()));
+    m_log->append(str);
 }
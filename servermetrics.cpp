@@ -0,0 +1,280 @@
+#include "servermetrics.h"
+#include "blobcache.h"
+#include "connectionworker.h"
+#include "frameprotocol.h"
+#include "outboundqueue.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QtAlgorithms>
+#include <QVector>
+
+#include <algorithm>
+
+QAtomicInt ServerMetrics::s_enabled(0);
+
+// 끊어진 연결에서 넘겨받은 counter 합계
+static QAtomicInteger<quint64> s_retired[ServerMetrics::CounterCount];
+// histogram별 bucket, 기록된 값의 수와 합
+static QAtomicInteger<quint64> s_buckets[ServerMetrics::HistogramCount][ServerMetrics::HistogramBuckets];
+static QAtomicInteger<quint64> s_histogramCounts[ServerMetrics::HistogramCount];
+static QAtomicInteger<quint64> s_histogramSums[ServerMetrics::HistogramCount];
+
+// 살아있는 연결의 counter(연결이 생기고 끊어질 때와 내보낼 때만 lock)
+static QMutex s_connectionsMutex;
+static QHash<ConnectionId, QSharedPointer<ServerMetrics::Connection>> s_connections;
+
+static const char* const s_counterNames[ServerMetrics::CounterCount] = {
+    "frames_in", "bytes_in", "frames_out", "bytes_out", "partial_reads"
+};
+static const char* const s_histogramNames[ServerMetrics::HistogramCount] = {
+    "decode_ns", "fan_out_ns", "queue_depth_bytes"
+};
+
+namespace
+{
+    // 내보내는 시점의 값(연결 counter는 증가 중에 읽으므로 항목 사이의 값은 조금씩 어긋날 수 있음)
+    struct Snapshot
+    {
+        quint64 counters[ServerMetrics::CounterCount] = {};
+        qint64 queuedBytes = 0;
+        int connections = 0;
+        QVector<QSharedPointer<ServerMetrics::Connection>> live;
+    };
+
+    Snapshot takeSnapshot()
+    {
+        Snapshot snapshot;
+        for(int i = 0; i < ServerMetrics::CounterCount; ++i)
+            snapshot.counters[i] = s_retired[i].loadRelaxed();
+
+        QMutexLocker locker(&s_connectionsMutex);
+        snapshot.connections = s_connections.size();
+        snapshot.live.reserve(s_connections.size());
+        foreach (const QSharedPointer<ServerMetrics::Connection>& connection, s_connections)
+        {
+            for(int i = 0; i < ServerMetrics::CounterCount; ++i)
+                snapshot.counters[i] += connection->counters[i].loadRelaxed();
+            snapshot.queuedBytes += connection->queuedBytes.loadRelaxed();
+            snapshot.live.append(connection);
+        }
+        return snapshot;
+    }
+
+    // bucket i의 상한(이 값 미만, 마지막 bucket 제외)
+    quint64 bucketBound(int bucket)
+    {
+        return Q_UINT64_C(1) << bucket;
+    }
+}
+
+void ServerMetrics::setEnabled(bool enabled)
+{
+    s_enabled.storeRelaxed(enabled ? 1 : 0);
+}
+
+void ServerMetrics::record(Histogram histogram, quint64 value)
+{
+    // 값의 bit 수가 bucket 번호(0은 bucket 0, 마지막 bucket은 그 이상 모두)
+    const int bucket = qMin(HistogramBuckets - 1, 64 - static_cast<int>(qCountLeadingZeroBits(value)));
+
+    s_buckets[histogram][bucket].fetchAndAddRelaxed(1);
+    s_histogramCounts[histogram].fetchAndAddRelaxed(1);
+    s_histogramSums[histogram].fetchAndAddRelaxed(value);
+}
+
+QSharedPointer<ServerMetrics::Connection> ServerMetrics::addConnection(ConnectionId connectionId)
+{
+    QSharedPointer<Connection> connection = QSharedPointer<Connection>::create(connectionId);
+
+    QMutexLocker locker(&s_connectionsMutex);
+    s_connections.insert(connectionId, connection);
+    return connection;
+}
+
+void ServerMetrics::removeConnection(ConnectionId connectionId)
+{
+    QMutexLocker locker(&s_connectionsMutex);
+    QSharedPointer<Connection> connection = s_connections.take(connectionId);
+    if(!connection)
+        return;
+
+    // 끊어진 뒤에도 전체 합계가 줄지 않도록 넘겨받음
+    for(int i = 0; i < CounterCount; ++i)
+        s_retired[i].fetchAndAddRelaxed(connection->counters[i].loadRelaxed());
+}
+
+QByteArray ServerMetrics::toJson()
+{
+    const Snapshot snapshot = takeSnapshot();
+
+    QJsonObject counters;
+    for(int i = 0; i < CounterCount; ++i)
+        counters[s_counterNames[i]] = static_cast<qint64>(snapshot.counters[i]);
+
+    // 비어 있지 않은 bucket만 상한과 함께 내보냄(마지막 bucket은 상한 없음)
+    QJsonObject histograms;
+    for(int h = 0; h < HistogramCount; ++h)
+    {
+        QJsonArray buckets;
+        for(int b = 0; b < HistogramBuckets; ++b)
+        {
+            const quint64 count = s_buckets[h][b].loadRelaxed();
+            if(count == 0)
+                continue;
+            QJsonObject bucket;
+            if(b < HistogramBuckets - 1)
+                bucket["lt"] = static_cast<qint64>(bucketBound(b));
+            bucket["count"] = static_cast<qint64>(count);
+            buckets.append(bucket);
+        }
+
+        QJsonObject histogram;
+        histogram["count"] = static_cast<qint64>(s_histogramCounts[h].loadRelaxed());
+        histogram["sum"] = static_cast<qint64>(s_histogramSums[h].loadRelaxed());
+        histogram["buckets"] = buckets;
+        histograms[s_histogramNames[h]] = histogram;
+    }
+
+    // 주고받은 바이트가 많은 연결부터 일부만
+    QVector<QSharedPointer<Connection>> live = snapshot.live;
+    auto traffic = [](const QSharedPointer<Connection>& connection) {
+        return connection->counters[BytesIn].loadRelaxed() + connection->counters[BytesOut].loadRelaxed();
+    };
+    const int reported = qMin(live.size(), MaxReportedConnections);
+    std::partial_sort(live.begin(), live.begin() + reported, live.end(), [&traffic](const QSharedPointer<Connection>& left, const QSharedPointer<Connection>& right) {
+        return traffic(left) > traffic(right);
+    });
+
+    QJsonArray connections;
+    for(int i = 0; i < reported; ++i)
+    {
+        QJsonObject connection;
+        connection["id"] = static_cast<qint64>(live[i]->connectionId);
+        for(int c = 0; c < CounterCount; ++c)
+            connection[s_counterNames[c]] = static_cast<qint64>(live[i]->counters[c].loadRelaxed());
+        connection["queued_bytes"] = live[i]->queuedBytes.loadRelaxed();
+        connections.append(connection);
+    }
+
+    // 다른 모듈이 따로 모으는 누적 값도 함께
+    const OutboundQueue::Statistics queue = OutboundQueue::statistics();
+    QJsonObject slowConsumers;
+    slowConsumers["congested"] = static_cast<qint64>(queue.congested);
+    slowConsumers["paused"] = static_cast<qint64>(queue.paused);
+    slowConsumers["dropped_frames"] = static_cast<qint64>(queue.droppedFrames);
+    slowConsumers["dropped_bytes"] = static_cast<qint64>(queue.droppedBytes);
+    slowConsumers["disconnected"] = static_cast<qint64>(queue.disconnected);
+
+    const FrameProtocol::CompressionStatistics compression = FrameProtocol::compressionStatistics();
+    QJsonObject compressionJson;
+    compressionJson["compressed_frames"] = static_cast<qint64>(compression.compressedFrames);
+    compressionJson["incompressible_frames"] = static_cast<qint64>(compression.skippedFrames);
+    compressionJson["saved_bytes"] = compression.savedBytes();
+    compressionJson["compress_ns"] = static_cast<qint64>(compression.compressNsecs);
+    compressionJson["decompressed_frames"] = static_cast<qint64>(compression.decompressedFrames);
+    compressionJson["decompress_ns"] = static_cast<qint64>(compression.decompressNsecs);
+
+    const ConnectionWorker::HeartbeatStatistics heartbeat = ConnectionWorker::heartbeatStatistics();
+    QJsonObject heartbeatJson;
+    heartbeatJson["pings_sent"] = static_cast<qint64>(heartbeat.pingsSent);
+    heartbeatJson["reaped"] = static_cast<qint64>(heartbeat.reaped);
+
+    QJsonObject json;
+    json["timestamp_ms"] = QDateTime::currentMSecsSinceEpoch();
+    json["enabled"] = isEnabled();
+    json["connections"] = snapshot.connections;
+    json["queued_bytes"] = snapshot.queuedBytes;
+    json["counters"] = counters;
+    json["histograms"] = histograms;
+    json["top_connections"] = connections;
+    json["slow_consumers"] = slowConsumers;
+    json["compression"] = compressionJson;
+    json["heartbeat"] = heartbeatJson;
+
+    if(BlobCache::instance()->isEnabled())
+    {
+        const BlobCache::Statistics cache = BlobCache::instance()->statistics();
+        QJsonObject cacheJson;
+        cacheJson["hits"] = static_cast<qint64>(cache.hits);
+        cacheJson["hit_bytes"] = static_cast<qint64>(cache.hitBytes);
+        cacheJson["misses"] = static_cast<qint64>(cache.misses);
+        cacheJson["bytes"] = cache.bytes;
+        cacheJson["blobs"] = cache.blobs;
+        json["attachment_cache"] = cacheJson;
+    }
+
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+// 한 metric의 HELP/TYPE 행과 값
+static void appendMetric(QByteArray& text, const char* name, const char* type, const char* help, qint64 value)
+{
+    text += QByteArray("# HELP ") + name + ' ' + help + '\n';
+    text += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+    text += QByteArray(name) + ' ' + QByteArray::number(value) + '\n';
+}
+
+// ns로 기록한 histogram은 Prometheus 관례에 따라 초 단위로 내보냄
+static void appendHistogram(QByteArray& text, ServerMetrics::Histogram histogram, const char* name, const char* help, double scale)
+{
+    text += QByteArray("# HELP ") + name + ' ' + help + '\n';
+    text += QByteArray("# TYPE ") + name + " histogram\n";
+
+    // Prometheus bucket은 누적 개수(le = 이하)이므로 "2^i 미만" bucket은 le = 2^i - 1로 씀
+    // 마지막 bucket은 상한이 없으므로 +Inf로만 내보냄
+    quint64 cumulative = 0;
+    for(int b = 0; b < ServerMetrics::HistogramBuckets - 1; ++b)
+    {
+        cumulative += s_buckets[histogram][b].loadRelaxed();
+        const double bound = static_cast<double>(bucketBound(b) - 1) * scale;
+        text += QByteArray(name) + "_bucket{le=\"" + QByteArray::number(bound, 'g', 6) + "\"} " + QByteArray::number(cumulative) + '\n';
+    }
+    cumulative += s_buckets[histogram][ServerMetrics::HistogramBuckets - 1].loadRelaxed();
+    text += QByteArray(name) + "_bucket{le=\"+Inf\"} " + QByteArray::number(cumulative) + '\n';
+    text += QByteArray(name) + "_sum " + QByteArray::number(static_cast<double>(s_histogramSums[histogram].loadRelaxed()) * scale, 'g', 12) + '\n';
+    text += QByteArray(name) + "_count " + QByteArray::number(cumulative) + '\n';
+}
+
+QByteArray ServerMetrics::toPrometheus()
+{
+    const Snapshot snapshot = takeSnapshot();
+
+    QByteArray text;
+    appendMetric(text, "qtcp_connections", "gauge", "Connected clients.", snapshot.connections);
+    appendMetric(text, "qtcp_queued_bytes", "gauge", "Bytes waiting in outbound queues.", snapshot.queuedBytes);
+    appendMetric(text, "qtcp_frames_in_total", "counter", "Frames received from clients.", static_cast<qint64>(snapshot.counters[FramesIn]));
+    appendMetric(text, "qtcp_bytes_in_total", "counter", "Bytes received from clients.", static_cast<qint64>(snapshot.counters[BytesIn]));
+    appendMetric(text, "qtcp_frames_out_total", "counter", "Frames queued for clients.", static_cast<qint64>(snapshot.counters[FramesOut]));
+    appendMetric(text, "qtcp_bytes_out_total", "counter", "Bytes queued for clients.", static_cast<qint64>(snapshot.counters[BytesOut]));
+    appendMetric(text, "qtcp_partial_reads_total", "counter", "Reads that ended with an incomplete frame.", static_cast<qint64>(snapshot.counters[PartialReads]));
+
+    appendHistogram(text, DecodeNsecs, "qtcp_decode_duration_seconds", "Time to read and decode one frame.", 1e-9);
+    appendHistogram(text, FanOutNsecs, "qtcp_fan_out_duration_seconds", "Time for one worker to queue a broadcast or room frame.", 1e-9);
+    appendHistogram(text, QueueDepthBytes, "qtcp_queue_depth_bytes", "Outbound queue size after queueing a frame.", 1.0);
+
+    const OutboundQueue::Statistics queue = OutboundQueue::statistics();
+    appendMetric(text, "qtcp_congested_total", "counter", "Times an outbound queue crossed the high watermark.", static_cast<qint64>(queue.congested));
+    appendMetric(text, "qtcp_dropped_frames_total", "counter", "Frames dropped for slow consumers.", static_cast<qint64>(queue.droppedFrames));
+    appendMetric(text, "qtcp_slow_consumer_disconnects_total", "counter", "Connections closed for exceeding outbound limits.", static_cast<qint64>(queue.disconnected));
+
+    const FrameProtocol::CompressionStatistics compression = FrameProtocol::compressionStatistics();
+    appendMetric(text, "qtcp_compressed_frames_total", "counter", "Frames sent compressed.", static_cast<qint64>(compression.compressedFrames));
+    appendMetric(text, "qtcp_compression_saved_bytes_total", "counter", "Bytes saved by compression.", compression.savedBytes());
+
+    const ConnectionWorker::HeartbeatStatistics heartbeat = ConnectionWorker::heartbeatStatistics();
+    appendMetric(text, "qtcp_pings_sent_total", "counter", "Heartbeat pings sent to idle connections.", static_cast<qint64>(heartbeat.pingsSent));
+    appendMetric(text, "qtcp_reaped_connections_total", "counter", "Connections closed for not answering heartbeats.", static_cast<qint64>(heartbeat.reaped));
+
+    if(BlobCache::instance()->isEnabled())
+    {
+        const BlobCache::Statistics cache = BlobCache::instance()->statistics();
+        appendMetric(text, "qtcp_attachment_cache_hits_total", "counter", "Attachments served from the content cache.", static_cast<qint64>(cache.hits));
+        appendMetric(text, "qtcp_attachment_cache_bytes", "gauge", "Size of the attachment content cache.", cache.bytes);
+    }
+    return text;
+}
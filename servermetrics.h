@@ -0,0 +1,71 @@
+#ifndef SERVERMETRICS_H
+#define SERVERMETRICS_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QSharedPointer>
+
+#include "connectionid.h"
+
+// 서버 hot path의 counter/histogram 모음(프로세스 전체에서 하나)
+// 연결별 counter는 그 연결을 담당하는 worker thread만 증가시키므로 서로 경합하지 않고,
+// 전체 합계는 내보낼 때 살아있는 연결의 counter와 끊어진 연결에서 넘겨받은 합계를 더해 구함
+// histogram은 2의 거듭제곱 경계 bucket마다 atomic counter 하나로 lock 없이 기록함
+// 꺼져 있으면(기본값) 각 지점은 isEnabled 확인 한 번만 하고 시간 측정도 하지 않음
+class ServerMetrics
+{
+public:
+    enum Counter
+    {
+        FramesIn,
+        BytesIn,
+        FramesOut,          // 송신 대기열에 넣은 frame(sendfile로 직접 보낸 첨부파일 본문은 제외)
+        BytesOut,
+        PartialReads,       // frame이 다 도착하지 않아 다음 readyRead를 기다린 횟수
+        CounterCount
+    };
+
+    enum Histogram
+    {
+        DecodeNsecs,        // frame 하나를 읽어 해석하는 데 걸린 시간
+        FanOutNsecs,        // worker 하나가 broadcast/publish frame을 담당 소켓 대기열에 넣는 데 걸린 시간
+        QueueDepthBytes,    // frame을 넣은 직후의 송신 대기열 크기
+        HistogramCount
+    };
+
+    // bucket i에는 2^(i-1) 이상 2^i 미만의 값(bucket 0은 0)
+    static constexpr int HistogramBuckets = 48;
+    // JSON에 연결별로 내보내는 최대 연결 수(주고받은 바이트가 많은 순)
+    static constexpr int MaxReportedConnections = 100;
+
+    // 연결 하나의 counter(담당 worker thread에서 증가, 어느 thread에서나 읽음)
+    struct Connection
+    {
+        explicit Connection(ConnectionId connectionId) : connectionId(connectionId) {}
+
+        void add(Counter counter, quint64 value = 1) { counters[counter].fetchAndAddRelaxed(value); }
+
+        const ConnectionId connectionId;
+        QAtomicInteger<quint64> counters[CounterCount];
+        QAtomicInteger<qint64> queuedBytes;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return s_enabled.loadRelaxed() != 0; }
+
+    static void record(Histogram histogram, quint64 value);
+
+    // 연결이 생길 때 counter를 만들고, 끊어지면 그 합계를 전체 합계로 넘김
+    static QSharedPointer<Connection> addConnection(ConnectionId connectionId);
+    static void removeConnection(ConnectionId connectionId);
+
+    // 현재 값 내보내기
+    static QByteArray toJson();
+    // Prometheus text exposition format(연결별 값은 label 수가 너무 많아지므로 제외)
+    static QByteArray toPrometheus();
+
+private:
+    static QAtomicInt s_enabled;
+};
+
+#endif // SERVERMETRICS_H
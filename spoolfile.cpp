@@ -0,0 +1,313 @@
+#include "spoolfile.h"
+#include "blobcache.h"
+#include "crc32c.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+
+// 첨부파일 기록 전용 thread pool(디스크 I/O가 network worker나 전역 pool을 막지 않도록 분리)
+Q_GLOBAL_STATIC(QThreadPool, s_writerPool)
+
+QThreadPool* SpoolFile::writerPool()
+{
+    static const bool initialized = []() {
+        s_writerPool()->setMaxThreadCount(qBound(2, QThread::idealThreadCount() / 2, 8));
+        return true;
+    }();
+    Q_UNUSED(initialized);
+    return s_writerPool();
+}
+
+// filePath에 이미 파일이 있을 때 대신 사용할 n번째 이름 : "이름 (n).확장자"
+static QString numberedPath(const QString& filePath, int n)
+{
+    if(n == 0)
+        return filePath;
+
+    const QFileInfo fileInfo(filePath);
+    const QString baseName = fileInfo.baseName();
+    const QString name = baseName.isEmpty() || fileInfo.completeSuffix().isEmpty()
+            ? QString("%1 (%2)").arg(fileInfo.fileName()).arg(n)
+            : QString("%1 (%2).%3").arg(baseName).arg(n).arg(fileInfo.completeSuffix());
+    return fileInfo.dir().filePath(name);
+}
+
+static QString checksumMismatch(qint64 expected, quint32 actual)
+{
+    return QString("Checksum mismatch (expected %1, got %2), the attachment was discarded")
+            .arg(static_cast<quint32>(expected), 8, 16, QChar('0')).arg(actual, 8, 16, QChar('0'));
+}
+
+SpoolFile::SpoolFile(QFile* file, QLockFile* lock, QObject* context)
+    : m_file(file), m_lock(lock), m_context(context)
+{
+}
+
+SpoolFile::~SpoolFile()
+{
+    delete m_file;
+    // lock 파일 삭제
+    delete m_lock;
+    delete m_hash;
+}
+
+void SpoolFile::write(const QByteArray& chunk, std::function<void(const QString&)> onError)
+{
+    m_pendingBytes.fetchAndAddOrdered(chunk.size());
+
+    enqueue([this, chunk, onError]() {
+        // 앞선 기록이 실패하여 닫힌 파일에는 더 기록하지 않음
+        if(m_file && m_file->isOpen())
+        {
+            if(!m_prefixRead)
+                readPrefix();
+
+            if(m_file->write(chunk) != chunk.size())
+            {
+                const QString reason = m_file->errorString();
+                m_writeError = reason;
+                m_file->close();
+                post([onError, reason]() { onError(reason); });
+            }
+            else
+            {
+                m_checksum = Crc32c::extend(m_checksum, chunk);
+                if(m_hash)
+                    m_hash->addData(chunk);
+            }
+        }
+        m_pendingBytes.fetchAndSubOrdered(chunk.size());
+    });
+}
+
+void SpoolFile::cacheAs(const QByteArray& contentHash)
+{
+    enqueue([this, contentHash]() {
+        if(!m_file || !m_file->isOpen() || !BlobCache::instance()->isEnabled())
+            return;
+
+        // 이어받는 경우 이전 연결에서 받은 앞부분부터 hash에 넣음
+        m_hash = new QCryptographicHash(QCryptographicHash::Sha256);
+        m_contentHash = contentHash;
+        if(!m_prefixRead)
+            readPrefix();
+    });
+}
+
+void SpoolFile::readPrefix()
+{
+    m_prefixRead = true;
+    if(!m_file)
+        return;
+
+    const qint64 received = m_file->pos();
+    if(received <= 0)
+        return;
+
+    m_file->seek(0);
+    while(m_file->pos() < received)
+    {
+        const QByteArray block = m_file->read(qMin<qint64>(1024 * 1024, received - m_file->pos()));
+        if(block.isEmpty())
+        {
+            // 앞부분을 다 읽지 못하면 CRC32C로 확인할 수 없으므로 저장하지 않음
+            m_checksumValid = false;
+            break;
+        }
+        m_checksum = Crc32c::extend(m_checksum, block);
+        if(m_hash)
+            m_hash->addData(block);
+    }
+    m_file->seek(received);
+}
+
+void SpoolFile::copyFromCache(const QByteArray& contentHash)
+{
+    enqueue([this, contentHash]() {
+        m_cachedHash = contentHash;
+    });
+}
+
+void SpoolFile::commitFromCache(const QString& filePath, qint64 expectedChecksum, const std::function<void(bool, const QString&)>& onDone)
+{
+    QFile* blob = BlobCache::instance()->openBlob(m_cachedHash);
+    if(!blob)
+    {
+        post([onDone]() { onDone(false, "The cached attachment is no longer available"); });
+        return;
+    }
+
+    // 저장 경로에 새 파일을 만들어 바로 복사(같은 이름의 파일이 있으면 번호를 붙인 이름으로 만듦)
+    QFile output;
+    QString storedPath;
+    for(int n = 0; n < MaxNumberedNames; ++n)
+    {
+        storedPath = numberedPath(filePath, n);
+        output.setFileName(storedPath);
+        if(output.open(QIODevice::WriteOnly | QIODevice::NewOnly) || !output.exists())
+            break;
+    }
+
+    bool copied = output.isOpen();
+    quint32 checksum = 0;
+    while(copied && !blob->atEnd())
+    {
+        const QByteArray block = blob->read(1024 * 1024);
+        copied = !block.isEmpty() && output.write(block) == block.size();
+        if(copied)
+            checksum = Crc32c::extend(checksum, block);
+    }
+    delete blob;
+
+    QString reason;
+    if(!copied)
+        reason = output.errorString();
+    else if(expectedChecksum >= 0 && checksum != static_cast<quint32>(expectedChecksum))
+        reason = checksumMismatch(expectedChecksum, checksum);
+
+    if(!reason.isEmpty())
+    {
+        if(output.isOpen())
+        {
+            output.close();
+            output.remove();
+        }
+        post([onDone, reason]() { onDone(false, reason); });
+        return;
+    }
+
+    output.close();
+    post([onDone, storedPath]() { onDone(true, storedPath); });
+}
+
+void SpoolFile::commit(const QString& filePath, qint64 expectedChecksum, std::function<void(bool, const QString&)> onDone)
+{
+    enqueue([this, filePath, expectedChecksum, onDone]() {
+        if(!m_cachedHash.isEmpty())
+        {
+            commitFromCache(filePath, expectedChecksum, onDone);
+            return;
+        }
+
+        // chunk 하나라도 기록하지 못했으면 파일이 잘렸으므로 checksum과 관계없이 저장하지 않음
+        // (이어받기 임시 파일도 지워 다음에는 처음부터 받음)
+        if(!m_writeError.isEmpty())
+        {
+            m_file->close();
+            m_file->remove();
+            const QString reason = m_writeError;
+            post([onDone, reason]() { onDone(false, reason); });
+            return;
+        }
+
+        if(!m_prefixRead)
+            readPrefix();
+
+        // 송신 측이 읽은 내용과 다르면 저장하지 않음(이어받기 임시 파일도 지워 다음에는 처음부터 받음)
+        if(expectedChecksum >= 0 && (!m_checksumValid || m_checksum != static_cast<quint32>(expectedChecksum)))
+        {
+            m_file->close();
+            m_file->remove();
+            const QString reason = checksumMismatch(expectedChecksum, m_checksum);
+            post([onDone, reason]() { onDone(false, reason); });
+            return;
+        }
+
+        // 기록이 모두 성공하고 내용이 알려진 hash와 같을 때만 캐시에 넣음
+        const bool cacheable = m_hash && m_file->isOpen() && m_hash->result() == m_contentHash;
+        m_file->close();
+
+        // 저장 경로에 같은 이름의 파일이 있으면 지우지 않고 번호를 붙인 이름으로 저장
+        // (같은 이름의 첨부파일을 자동 저장해도 앞서 받은 파일이 남음, QFile::rename은 있는 파일을 덮어쓰지 않음)
+        QString storedPath;
+        bool renamed = false;
+        for(int n = 0; !renamed && n < MaxNumberedNames; ++n)
+        {
+            storedPath = numberedPath(filePath, n);
+            if(QFile::exists(storedPath))
+                continue;
+            renamed = m_file->rename(storedPath);
+            if(!renamed && !QFile::exists(storedPath))
+                break;
+        }
+
+        if(renamed)
+        {
+            if(cacheable)
+                BlobCache::instance()->store(m_contentHash, storedPath);
+            post([onDone, storedPath]() { onDone(true, storedPath); });
+        }
+        else
+        {
+            const QString reason = m_file->errorString();
+            m_file->remove();
+            post([onDone, reason]() { onDone(false, reason); });
+        }
+    });
+}
+
+void SpoolFile::discard(bool keep)
+{
+    enqueue([this, keep]() {
+        if(!m_file)
+            return;
+        m_file->close();
+        if(!keep)
+            m_file->remove();
+    });
+}
+
+void SpoolFile::notify(std::function<void()> onDrained)
+{
+    enqueue([this, onDrained]() {
+        post(onDrained);
+    });
+}
+
+void SpoolFile::detach()
+{
+    QMutexLocker locker(&m_mutex);
+    m_context = nullptr;
+}
+
+void SpoolFile::enqueue(std::function<void()> operation)
+{
+    QMutexLocker locker(&m_mutex);
+    m_operations.enqueue(operation);
+
+    // 이 파일의 작업을 실행 중인 thread가 없을 때만 새로 시작(파일마다 순서 보장)
+    if(!m_running)
+    {
+        m_running = true;
+        QSharedPointer<SpoolFile> self = sharedFromThis();
+        writerPool()->start([self]() { self->run(); });
+    }
+}
+
+void SpoolFile::run()
+{
+    forever
+    {
+        std::function<void()> operation;
+        {
+            QMutexLocker locker(&m_mutex);
+            if(m_operations.isEmpty())
+            {
+                m_running = false;
+                return;
+            }
+            operation = m_operations.dequeue();
+        }
+        operation();
+    }
+}
+
+void SpoolFile::post(std::function<void()> callback)
+{
+    // detach와 경쟁하지 않도록 lock을 잡은 채로 전달
+    QMutexLocker locker(&m_mutex);
+    if(m_context)
+        QMetaObject::invokeMethod(m_context, callback, Qt::QueuedConnection);
+}
@@ -0,0 +1,91 @@
+#ifndef SPOOLFILE_H
+#define SPOOLFILE_H
+
+#include <QAtomicInteger>
+#include <QCryptographicHash>
+#include <QEnableSharedFromThis>
+#include <QFile>
+#include <QLockFile>
+#include <QMutex>
+#include <QPointer>
+#include <QQueue>
+#include <QSharedPointer>
+
+#include <functional>
+
+class QThreadPool;
+
+// 수신 중인 첨부파일 임시 파일에 대한 디스크 작업을 background writer thread pool에서 실행하는 클래스
+// 작업(write/close/rename/remove)은 파일마다 요청한 순서대로 한 번에 하나씩 실행되므로
+// 네트워크 thread는 디스크를 기다리지 않고 다음 frame을 처리할 수 있음
+// 결과는 context 객체의 thread로 queued 호출되며, detach 이후에는 전달하지 않음
+// 마지막 작업이 끝나면 파일과 lock은 작업 thread에서 해제됨
+// 기록하는 동안 파일 전체(이어받은 앞부분 포함)의 CRC32C를 함께 구해 commit 때 송신 측 값과 비교함
+class SpoolFile : public QEnableSharedFromThis<SpoolFile>
+{
+public:
+    // 저장 경로에 같은 이름의 파일이 있을 때 시도할 번호 붙인 이름의 수
+    static constexpr int MaxNumberedNames = 1000;
+
+    // file, lock의 소유권을 넘겨받음(lock은 nullptr 가능)
+    // 내용을 BlobCache에서 가져오는 전송(copyFromCache)은 임시 파일 없이 file을 nullptr로 생성
+    SpoolFile(QFile* file, QLockFile* lock, QObject* context);
+    ~SpoolFile();
+
+    // 아직 디스크에 기록되지 않은 바이트
+    qint64 pendingBytes() const { return m_pendingBytes.loadAcquire(); }
+
+    // chunk를 파일 끝에 이어서 기록, 실패하면 onError를 context thread에서 호출
+    void write(const QByteArray& chunk, std::function<void(const QString&)> onError);
+    // 이후 기록하는 내용의 hash를 계산(이미 기록된 앞부분도 포함)하고,
+    // commit 때 contentHash와 같으면 저장한 파일을 BlobCache에 넣음
+    void cacheAs(const QByteArray& contentHash);
+    // 같은 내용을 이미 받은 적이 있어 본문 전송을 건너뛴 경우 : commit 때 BlobCache의 blob을 저장 경로로 바로 복사
+    void copyFromCache(const QByteArray& contentHash);
+    // 앞선 기록이 모두 끝나면 파일을 닫고 filePath로 옮김
+    // filePath에 이미 파일이 있으면 덮어쓰지 않고 "이름 (n).확장자"로 옮기며, 실제 경로를 onDone으로 알림
+    // chunk 기록에 실패했거나 expectedChecksum(0 이상일 때)이 기록한 내용의 CRC32C와 다르면
+    // 옮기지 않고 삭제한 뒤 실패로 알림
+    void commit(const QString& filePath, qint64 expectedChecksum, std::function<void(bool, const QString&)> onDone);
+    // 앞선 기록이 모두 끝나면 파일을 닫음, keep이 아니면 삭제
+    void discard(bool keep);
+    // 작업 후 onDrained를 context thread에서 호출(기록 대기량이 줄었을 때 알림용)
+    void notify(std::function<void()> onDrained);
+
+    // 이후 결과를 context에 전달하지 않음(context 소멸 전에 호출)
+    void detach();
+
+    static QThreadPool* writerPool();
+
+private:
+    void enqueue(std::function<void()> operation);
+    void run();
+    void post(std::function<void()> callback);
+    // 이어받는 경우 이전 연결에서 받은 앞부분을 CRC32C(와 캐시용 hash)에 넣음, 첫 작업에서 한 번만 실행
+    void readPrefix();
+    // copyFromCache 전송의 commit
+    void commitFromCache(const QString& filePath, qint64 expectedChecksum, const std::function<void(bool, const QString&)>& onDone);
+
+    QFile* m_file;
+    QLockFile* m_lock;
+
+    QMutex m_mutex;
+    QObject* m_context;
+    QQueue<std::function<void()>> m_operations;
+    bool m_running = false;
+    QAtomicInteger<qint64> m_pendingBytes;
+
+    // 캐시에 넣을 내용의 hash(writer thread에서만 접근)
+    QCryptographicHash* m_hash = nullptr;
+    QByteArray m_contentHash;
+    // copyFromCache로 지정한 blob(writer thread에서만 접근)
+    QByteArray m_cachedHash;
+    // 기록한 내용의 CRC32C(writer thread에서만 접근), 앞부분을 읽지 못했으면 m_checksumValid가 false
+    quint32 m_checksum = 0;
+    bool m_checksumValid = true;
+    bool m_prefixRead = false;
+    // chunk 기록에 실패한 이유(writer thread에서만 접근), 비어 있지 않으면 commit하지 않음
+    QString m_writeError;
+};
+
+#endif // SPOOLFILE_H
@@ -0,0 +1,67 @@
+#include "streamsocket.h"
+
+namespace StreamSocket
+{
+
+bool isConnected(const QIODevice* device)
+{
+    if(const QAbstractSocket* socket = qobject_cast<const QAbstractSocket*>(device))
+        return socket->state() == QAbstractSocket::ConnectedState;
+    if(const QLocalSocket* socket = qobject_cast<const QLocalSocket*>(device))
+        return socket->state() == QLocalSocket::ConnectedState;
+    return false;
+}
+
+bool isUnconnected(const QIODevice* device)
+{
+    if(const QAbstractSocket* socket = qobject_cast<const QAbstractSocket*>(device))
+        return socket->state() == QAbstractSocket::UnconnectedState;
+    if(const QLocalSocket* socket = qobject_cast<const QLocalSocket*>(device))
+        return socket->state() == QLocalSocket::UnconnectedState;
+    return true;
+}
+
+void abort(QIODevice* device)
+{
+    if(QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(device))
+        socket->abort();
+    else if(QLocalSocket* socket = qobject_cast<QLocalSocket*>(device))
+        socket->abort();
+    else
+        device->close();
+}
+
+qintptr descriptor(const QIODevice* device)
+{
+    if(const QAbstractSocket* socket = qobject_cast<const QAbstractSocket*>(device))
+        return socket->socketDescriptor();
+    if(const QLocalSocket* socket = qobject_cast<const QLocalSocket*>(device))
+        return socket->socketDescriptor();
+    return -1;
+}
+
+void setReadBufferSize(QIODevice* device, qint64 size)
+{
+    if(QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(device))
+        socket->setReadBufferSize(size);
+    else if(QLocalSocket* socket = qobject_cast<QLocalSocket*>(device))
+        socket->setReadBufferSize(size);
+}
+
+QHostAddress peerAddress(const QIODevice* device)
+{
+    if(const QAbstractSocket* socket = qobject_cast<const QAbstractSocket*>(device))
+        return socket->peerAddress();
+    return QHostAddress(QHostAddress::LocalHost);
+}
+
+bool isPeerClosedError(const QIODevice* device)
+{
+    if(const QAbstractSocket* socket = qobject_cast<const QAbstractSocket*>(device))
+        return socket->error() == QAbstractSocket::RemoteHostClosedError;
+    if(const QLocalSocket* socket = qobject_cast<const QLocalSocket*>(device))
+        return socket->error() == QLocalSocket::PeerClosedError;
+    return false;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef STREAMSOCKET_H
+#define STREAMSOCKET_H
+
+#include <QAbstractSocket>
+#include <QHostAddress>
+#include <QIODevice>
+#include <QLocalSocket>
+
+// TCP 소켓(QTcpSocket)과 local 소켓(QLocalSocket, AF_UNIX)을 QIODevice 하나로 다루기 위한 함수
+// frame 송수신(readFrame, OutboundQueue, AttachmentSender 등)은 QIODevice의 read/write/bytesWritten만 쓰고,
+// 두 클래스에 따로 있는 연결 상태/종료/descriptor 관련 기능만 여기서 종류에 맞게 호출함
+namespace StreamSocket
+{
+    bool isConnected(const QIODevice* device);
+    bool isUnconnected(const QIODevice* device);
+    void abort(QIODevice* device);
+    // 소켓 descriptor(없으면 -1), sendfile 등 직접 쓰기에 사용
+    qintptr descriptor(const QIODevice* device);
+    void setReadBufferSize(QIODevice* device, qint64 size);
+    // 상대 주소(local 소켓은 같은 host이므로 LocalHost)
+    QHostAddress peerAddress(const QIODevice* device);
+    // 마지막 오류가 상대가 연결을 닫은 것인지
+    bool isPeerClosedError(const QIODevice* device);
+
+    // 연결 종료/오류 signal 연결
+    template<typename Receiver, typename Slot>
+    QMetaObject::Connection connectDisconnected(QIODevice* device, const Receiver* receiver, Slot slot)
+    {
+        if(QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(device))
+            return QObject::connect(socket, &QAbstractSocket::disconnected, receiver, slot);
+        if(QLocalSocket* socket = qobject_cast<QLocalSocket*>(device))
+            return QObject::connect(socket, &QLocalSocket::disconnected, receiver, slot);
+        return QMetaObject::Connection();
+    }
+
+    template<typename Receiver, typename Slot>
+    QMetaObject::Connection connectErrorOccurred(QIODevice* device, const Receiver* receiver, Slot slot)
+    {
+        if(QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(device))
+            return QObject::connect(socket, &QAbstractSocket::errorOccurred, receiver, slot);
+        if(QLocalSocket* socket = qobject_cast<QLocalSocket*>(device))
+            return QObject::connect(socket, &QLocalSocket::errorOccurred, receiver, slot);
+        return QMetaObject::Connection();
+    }
+}
+
+#endif // STREAMSOCKET_H
@@ -0,0 +1,79 @@
+#include "timerwheel.h"
+
+TimerWheel::TimerWheel() : m_slots(LevelCount * SlotCount)
+{
+}
+
+void TimerWheel::schedule(ConnectionId key, quint64 delay)
+{
+    cancel(key);
+
+    // 이번 tick의 slot은 이미 지나갔으므로 가장 빨라도 다음 tick에 만료
+    Timer timer;
+    timer.key = key;
+    timer.expiry = m_now + qBound<quint64>(1, delay, MaxDelay);
+    insert(timer);
+}
+
+void TimerWheel::cancel(ConnectionId key)
+{
+    auto it = m_positions.find(key);
+    if(it == m_positions.end())
+        return;
+
+    m_slots[it->level * SlotCount + it->slot].erase(it->timer);
+    m_positions.erase(it);
+}
+
+void TimerWheel::insert(const Timer& timer)
+{
+    // 남은 tick이 아래 단계 한 바퀴를 넘을 때마다 한 단계 위로
+    const quint64 delay = timer.expiry > m_now ? timer.expiry - m_now : 0;
+    int level = 0;
+    while(level < LevelCount - 1 && (delay >> (SlotBits * (level + 1))) != 0)
+        level++;
+
+    const int slot = static_cast<int>((timer.expiry >> (SlotBits * level)) & (SlotCount - 1));
+    Slot& timers = m_slots[level * SlotCount + slot];
+
+    Position position;
+    position.level = level;
+    position.slot = slot;
+    position.timer = timers.insert(timers.end(), timer);
+    m_positions.insert(timer.key, position);
+}
+
+void TimerWheel::cascade(int level)
+{
+    const int slot = static_cast<int>((m_now >> (SlotBits * level)) & (SlotCount - 1));
+
+    Slot timers;
+    timers.swap(m_slots[level * SlotCount + slot]);
+    for(const Timer& timer : timers)
+        insert(timer);
+}
+
+QVector<ConnectionId> TimerWheel::advance()
+{
+    m_now++;
+
+    // 아래 단계가 한 바퀴를 돌았으면 위 단계의 현재 slot을 내려보냄(위 단계부터 차례로)
+    for(int level = LevelCount - 1; level > 0; --level)
+    {
+        if((m_now & ((Q_UINT64_C(1) << (SlotBits * level)) - 1)) == 0)
+            cascade(level);
+    }
+
+    QVector<ConnectionId> expired;
+    Slot timers;
+    timers.swap(m_slots[m_now & (SlotCount - 1)]);
+    for(const Timer& timer : timers)
+    {
+        m_positions.remove(timer.key);
+        if(timer.expiry <= m_now)
+            expired.append(timer.key);
+        else
+            insert(timer);
+    }
+    return expired;
+}
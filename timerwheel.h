@@ -0,0 +1,64 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QHash>
+#include <QVector>
+
+#include <list>
+
+#include "connectionid.h"
+
+// 연결마다 QTimer를 만들지 않고 만료 시각을 관리하는 계층형 timer wheel
+// 단계(level)마다 SlotCount개의 slot이 있고, 만료까지 남은 tick이 클수록 위 단계에 들어감
+// 위 단계 slot은 아래 단계가 한 바퀴 돌 때마다 한 칸씩 아래 단계로 내려오므로
+// 등록/취소는 O(1), tick마다 드는 비용은 그 tick에 만료되거나 내려오는 timer 수에만 비례함
+// tick의 실제 길이는 호출 측이 advance를 부르는 주기로 정함
+// thread-safe하지 않음(한 worker thread에서만 사용)
+class TimerWheel
+{
+public:
+    static constexpr int SlotBits = 6;
+    static constexpr int SlotCount = 1 << SlotBits;
+    static constexpr int LevelCount = 4;
+    // 등록할 수 있는 가장 먼 만료 시각(이보다 멀면 이 값으로 줄임)
+    static constexpr quint64 MaxDelay = (Q_UINT64_C(1) << (SlotBits * LevelCount)) - 1;
+
+    TimerWheel();
+
+    // 현재 tick
+    quint64 now() const { return m_now; }
+
+    // key의 timer를 지금부터 delay tick 뒤로 등록(이미 있으면 옮김)
+    void schedule(ConnectionId key, quint64 delay);
+    void cancel(ConnectionId key);
+    bool contains(ConnectionId key) const { return m_positions.contains(key); }
+    int size() const { return m_positions.size(); }
+
+    // 한 tick 진행하고 그 tick에 만료된 key를 반환(반환된 key는 wheel에서 빠짐)
+    QVector<ConnectionId> advance();
+
+private:
+    struct Timer
+    {
+        ConnectionId key;
+        quint64 expiry;
+    };
+    typedef std::list<Timer> Slot;
+
+    struct Position
+    {
+        int level;
+        int slot;
+        Slot::iterator timer;
+    };
+
+    void insert(const Timer& timer);
+    // level의 현재 slot에 있는 timer를 남은 tick에 맞는 아래 단계로 옮김
+    void cascade(int level);
+
+    quint64 m_now = 0;
+    QVector<Slot> m_slots;                      // level * SlotCount + slot
+    QHash<ConnectionId, Position> m_positions;
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,32 @@
+#include "tokenbucket.h"
+
+#include <cmath>
+
+void TokenBucket::configure(double rate, double capacity, qint64 nowNsecs)
+{
+    m_rate = rate;
+    // 한 번에 하나는 처리할 수 있어야 함
+    m_capacity = qMax(capacity, 1.0);
+    m_tokens = m_capacity;
+    m_updated = nowNsecs;
+}
+
+void TokenBucket::refill(qint64 nowNsecs)
+{
+    if(!isLimited())
+        return;
+
+    const qint64 elapsed = nowNsecs - m_updated;
+    m_updated = nowNsecs;
+    if(elapsed > 0)
+        m_tokens = qMin(m_capacity, m_tokens + m_rate * elapsed / 1e9);
+}
+
+qint64 TokenBucket::nsecsUntilAvailable() const
+{
+    if(isAvailable())
+        return 0;
+
+    // 0이 아니라 0을 넘어야 하므로 1ns 더 기다림
+    return static_cast<qint64>(std::ceil(-m_tokens / m_rate * 1e9)) + 1;
+}
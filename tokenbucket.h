@@ -0,0 +1,32 @@
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <QtGlobal>
+
+// 초당 rate개씩 token이 차고 capacity까지 쌓이는 token bucket
+// 처리한 뒤에 실제 사용량을 빼므로 token이 음수(빚)가 될 수 있고, 다시 0을 넘을 때까지 기다리게 함
+// 따라서 크기를 미리 알 수 없는 frame도 읽기 전에 크기를 확인하지 않고 평균 rate를 지킬 수 있음
+// 시각은 호출 측의 단조 증가 시계(ns)로 받음, thread-safe하지 않음
+class TokenBucket
+{
+public:
+    // rate가 0 이하이면 제한하지 않음, 설정 직후에는 가득 찬 상태
+    void configure(double rate, double capacity, qint64 nowNsecs);
+    bool isLimited() const { return m_rate > 0; }
+
+    // nowNsecs까지 찬 token 반영
+    void refill(qint64 nowNsecs);
+    // 쓸 수 있는 token이 있는지(제한이 없으면 항상 true)
+    bool isAvailable() const { return !isLimited() || m_tokens > 0; }
+    void consume(double amount) { if(isLimited()) m_tokens -= amount; }
+    // token이 0을 넘을 때까지 남은 시간(ns), 이미 있으면 0
+    qint64 nsecsUntilAvailable() const;
+
+private:
+    double m_rate = 0;
+    double m_capacity = 0;
+    double m_tokens = 0;
+    qint64 m_updated = 0;
+};
+
+#endif // TOKENBUCKET_H